@@ -0,0 +1,86 @@
+#include "adaptiverate.h"
+#include <math.h>
+
+// 估计值的平滑系数
+static const double kAlpha = 0.3;
+// 活动度低于此值视为平稳
+static const double kCalmActivity = 0.25;
+
+AdaptiveRate::AdaptiveRate()
+{
+    reset();
+}
+
+void AdaptiveRate::configure(const AdaptiveRateConfig &config)
+{
+    m_config = config;
+    m_config.minIntervalMs = qMax(10, m_config.minIntervalMs);
+    m_config.maxIntervalMs = qMax(m_config.minIntervalMs, m_config.maxIntervalMs);
+    m_config.settleSamples = qMax(1, m_config.settleSamples);
+    reset();
+}
+
+void AdaptiveRate::reset()
+{
+    m_hasLast = false;
+    m_lastTimestamp = 0;
+    m_calmSamples = 0;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        m_channels[c].valid = false;
+        m_channels[c].rate = 0;
+        m_channels[c].mean = 0;
+        m_channels[c].variance = 0;
+    }
+}
+
+int AdaptiveRate::update(const SensorData &data, int currentIntervalMs)
+{
+    if (!m_config.enabled)
+        return currentIntervalMs;
+
+    qint64 timestampMs = data.timestamp.toMSecsSinceEpoch();
+    if (m_hasLast && timestampMs <= m_lastTimestamp)
+        return qBound(m_config.minIntervalMs, currentIntervalMs, m_config.maxIntervalMs);
+
+    double dt = (timestampMs - m_lastTimestamp) / 1000.0;
+    m_hasLast = true;
+    m_lastTimestamp = timestampMs;
+
+    double activity = 0;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!data.has(c))
+            continue;
+        ChannelState &s = m_channels[c];
+        if (!s.valid) {
+            s.valid = true;
+            s.mean = data.value(c);
+            continue;
+        }
+
+        // 变化率按平滑后的均值计算，量化噪声（±1 个最低位的跳动）不会触发加速
+        double diff = data.value(c) - s.mean;
+        double previousMean = s.mean;
+        s.mean += kAlpha * diff;
+        s.variance = (1.0 - kAlpha) * (s.variance + kAlpha * diff * diff);
+        s.rate += kAlpha * (fabs(s.mean - previousMean) / dt - s.rate);
+
+        if (m_config.rateThreshold[c] > 0)
+            activity = qMax(activity, s.rate / m_config.rateThreshold[c]);
+        if (m_config.stdDevThreshold[c] > 0)
+            activity = qMax(activity, sqrt(s.variance) / m_config.stdDevThreshold[c]);
+    }
+
+    int interval = currentIntervalMs;
+    if (activity >= 1.0) {
+        interval = currentIntervalMs / 2;
+        m_calmSamples = 0;
+    } else if (activity < kCalmActivity) {
+        if (++m_calmSamples >= m_config.settleSamples) {
+            interval = currentIntervalMs * 2;
+            m_calmSamples = 0;
+        }
+    } else {
+        m_calmSamples = 0;
+    }
+    return qBound(m_config.minIntervalMs, interval, m_config.maxIntervalMs);
+}
@@ -0,0 +1,64 @@
+#ifndef ADAPTIVERATE_H
+#define ADAPTIVERATE_H
+
+#include <QtGlobal>
+#include "sensordata.h"
+
+// 自适应采样周期
+//
+// 每个通道维护均值、变化率 |dv/dt| 和标准差的指数滑动估计，活动度取各通道
+// max(变化率 / 变化率阈值, 标准差 / 标准差阈值)，阈值为 0 的通道不参与：
+//   活动度 >= 1          周期减半（不低于 minIntervalMs）
+//   连续 settleSamples 个采样活动度 < 0.25   周期加倍（不超过 maxIntervalMs）
+// 加快立即生效，放慢需要持续平稳，瞬变不会被漏掉。
+
+struct AdaptiveRateConfig {
+    bool enabled;
+    int minIntervalMs;
+    int maxIntervalMs;
+    int settleSamples;
+    double rateThreshold[SensorData::MAX_CHANNELS];     // 单位/秒
+    double stdDevThreshold[SensorData::MAX_CHANNELS];
+
+    AdaptiveRateConfig()
+        : enabled(false), minIntervalMs(500), maxIntervalMs(10000), settleSamples(10)
+    {
+        for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+            rateThreshold[c] = 0;
+            stdDevThreshold[c] = 0;
+        }
+        rateThreshold[CHANNEL_TEMPERATURE] = 0.02;
+        rateThreshold[CHANNEL_HUMIDITY] = 0.1;
+        stdDevThreshold[CHANNEL_TEMPERATURE] = 0.2;
+        stdDevThreshold[CHANNEL_HUMIDITY] = 1.0;
+    }
+};
+
+class AdaptiveRate
+{
+public:
+    AdaptiveRate();
+
+    void configure(const AdaptiveRateConfig &config);
+    bool isEnabled() const { return m_config.enabled; }
+    void reset();
+
+    // 输入一个采样，返回下一次采样应使用的周期
+    int update(const SensorData &data, int currentIntervalMs);
+
+private:
+    struct ChannelState {
+        bool valid;
+        double rate;
+        double mean;
+        double variance;
+    };
+
+    AdaptiveRateConfig m_config;
+    ChannelState m_channels[SensorData::MAX_CHANNELS];
+    bool m_hasLast;
+    qint64 m_lastTimestamp;
+    int m_calmSamples;
+};
+
+#endif // ADAPTIVERATE_H
@@ -0,0 +1,14 @@
+#ifndef APPSETTINGS_H
+#define APPSETTINGS_H
+
+#include <QSettings>
+
+// 运行配置（工作目录下的 smarthome.ini，与 sensor_data.db 放在一起）
+// QSettings 不是线程安全的，只在主线程读取，工作线程通过参数拿到配置值。
+inline QSettings &appSettings()
+{
+    static QSettings settings("smarthome.ini", QSettings::IniFormat);
+    return settings;
+}
+
+#endif // APPSETTINGS_H
@@ -0,0 +1,141 @@
+#include "channelregistry.h"
+#include "derivedchannels.h"
+#include <QSettings>
+#include <QStringList>
+#include <QCoreApplication>
+#include <QDebug>
+
+ChannelRegistry *ChannelRegistry::instance()
+{
+    static ChannelRegistry registry;
+    return &registry;
+}
+
+ChannelRegistry::ChannelRegistry()
+    : m_derivedMask(0)
+{
+    ChannelInfo temperature;
+    temperature.key = "temperature";
+    temperature.name = QCoreApplication::translate("ChannelRegistry", "温度");
+    temperature.unit = "°C";
+    temperature.minValue = -40;
+    temperature.maxValue = 125;
+    temperature.alarmMin = 10;
+    temperature.alarmMax = 35;
+    temperature.alarmEnabled = true;
+    temperature.color = Qt::red;
+    add(temperature);
+
+    ChannelInfo humidity;
+    humidity.key = "humidity";
+    humidity.name = QCoreApplication::translate("ChannelRegistry", "湿度");
+    humidity.unit = "%";
+    humidity.minValue = 0;
+    humidity.maxValue = 100;
+    humidity.alarmMin = 20;
+    humidity.alarmMax = 80;
+    humidity.alarmEnabled = true;
+    humidity.color = Qt::blue;
+    add(humidity);
+}
+
+int ChannelRegistry::add(const ChannelInfo &info)
+{
+    if (m_channels.size() >= SensorData::MAX_CHANNELS) {
+        qWarning() << "通道数超过上限，忽略" << info.key;
+        return -1;
+    }
+    m_channels.append(info);
+    return m_channels.size() - 1;
+}
+
+void ChannelRegistry::addDerived(const QString &key)
+{
+    int index = DerivedChannels::findFormula(key);
+    if (index < 0) {
+        qWarning() << "未知的派生通道，忽略" << key;
+        return;
+    }
+    if (indexOf(key) >= 0) {
+        qWarning() << "派生通道与已有通道重名，忽略" << key;
+        return;
+    }
+
+    const DerivedChannels::Formula &formula = DerivedChannels::formula(index);
+    ChannelInfo info;
+    info.key = key;
+    info.name = QCoreApplication::translate("ChannelRegistry", formula.name);
+    info.unit = formula.unit;
+    info.minValue = formula.minValue;
+    info.maxValue = formula.maxValue;
+    info.color = QColor(formula.color);
+    info.formula = index;
+    for (int i = 0; i < formula.inputCount; ++i) {
+        int input = indexOf(formula.inputs[i]);
+        if (input < 0 || m_channels[input].isDerived()) {
+            qWarning() << "派生通道" << key << "的输入" << formula.inputs[i] << "不存在，忽略";
+            return;
+        }
+        info.inputs.append(input);
+    }
+
+    int c = add(info);
+    if (c >= 0)
+        m_derivedMask |= 1u << c;
+}
+
+int ChannelRegistry::indexOf(const QString &key) const
+{
+    for (int i = 0; i < m_channels.size(); ++i) {
+        if (m_channels[i].key == key)
+            return i;
+    }
+    return -1;
+}
+
+void ChannelRegistry::load(QSettings &settings)
+{
+    QStringList keys = settings.value("channels/list").toStringList();
+    for (int i = 0; i < keys.size(); ++i) {
+        if (indexOf(keys[i]) < 0) {
+            ChannelInfo info;
+            info.key = keys[i];
+            info.name = keys[i];
+            add(info);
+        }
+    }
+
+    // 派生通道排在所有基础通道之后，默认不启用
+    QStringList derived = settings.value("channels/derived").toStringList();
+    for (int i = 0; i < derived.size(); ++i) {
+        if (!derived[i].trimmed().isEmpty())
+            addDerived(derived[i].trimmed());
+    }
+
+    // 旧版报警阈值配置
+    ChannelInfo &temperature = m_channels[CHANNEL_TEMPERATURE];
+    temperature.alarmMax = settings.value("alarm/maxTemperature", temperature.alarmMax).toDouble();
+    temperature.alarmMin = settings.value("alarm/minTemperature", temperature.alarmMin).toDouble();
+    ChannelInfo &humidity = m_channels[CHANNEL_HUMIDITY];
+    humidity.alarmMax = settings.value("alarm/maxHumidity", humidity.alarmMax).toDouble();
+    humidity.alarmMin = settings.value("alarm/minHumidity", humidity.alarmMin).toDouble();
+
+    for (int i = 0; i < m_channels.size(); ++i) {
+        ChannelInfo &c = m_channels[i];
+        settings.beginGroup("channels/" + c.key);
+        c.name = settings.value("name", c.name).toString();
+        c.unit = settings.value("unit", c.unit).toString();
+        c.decimals = qBound(0, settings.value("decimals", c.decimals).toInt(), 6);
+        c.storageDecimals = qBound(0, settings.value("storageDecimals", c.storageDecimals).toInt(), 6);
+        c.minValue = settings.value("min", c.minValue).toDouble();
+        c.maxValue = settings.value("max", c.maxValue).toDouble();
+        c.alarmEnabled = c.alarmEnabled || settings.contains("alarmMin") || settings.contains("alarmMax");
+        c.alarmMin = settings.value("alarmMin", c.alarmEnabled ? c.alarmMin : c.minValue).toDouble();
+        c.alarmMax = settings.value("alarmMax", c.alarmEnabled ? c.alarmMax : c.maxValue).toDouble();
+        QColor color(settings.value("color").toString());
+        if (color.isValid())
+            c.color = color;
+        c.persist = c.isDerived() && settings.value("persist", false).toBool();
+        settings.endGroup();
+    }
+}
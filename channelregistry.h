@@ -0,0 +1,72 @@
+#ifndef CHANNELREGISTRY_H
+#define CHANNELREGISTRY_H
+
+#include <QString>
+#include <QColor>
+#include <QVector>
+#include "sensordata.h"
+
+class QSettings;
+
+// 通道描述
+struct ChannelInfo {
+    QString key;            // 配置和数据库中的标识，例如 "temperature"，不能改
+    QString name;           // 显示名称
+    QString unit;
+    int decimals;           // 显示的小数位数
+    int storageDecimals;    // 存储精度，分块存储按 10^storageDecimals 定点化
+    double minValue;        // 量程，图表 Y 轴不超出这个范围
+    double maxValue;
+    double alarmMin;        // 报警阈值，超出即报警
+    double alarmMax;
+    bool alarmEnabled;
+    QColor color;
+
+    // 派生通道（见 derivedchannels.h）：公式编号和输入通道的下标；基础通道的 formula 为 -1
+    int formula;
+    QVector<int> inputs;
+    bool persist;           // 派生通道是否写入数据库
+
+    ChannelInfo()
+        : decimals(1), storageDecimals(2), minValue(-1e9), maxValue(1e9)
+        , alarmMin(0), alarmMax(0), alarmEnabled(false), color(Qt::darkGray)
+        , formula(-1), persist(false) {}
+
+    bool isDerived() const { return formula >= 0; }
+
+    QString format(double value) const { return QString::number(value, 'f', decimals); }
+};
+
+// 通道注册表
+//
+// 通道下标就是 SensorData 中的下标。温度、湿度固定为前两个，
+// 其他通道（CO2、气压、光照等）从配置 channels/list 按顺序追加，
+// 每个通道的描述在 [channels/<key>] 下（name、unit、decimals、storageDecimals、
+// min、max、alarmMin、alarmMax、color），内置通道也可以在这里覆盖默认值。
+// 派生通道按 channels/derived 的顺序排在最后，默认不启用；可选 dewpoint（露点）、
+// heatindex（体感温度）、absolutehumidity（绝对湿度），[channels/<key>] 下另有 persist。
+// 启动时在主线程调用一次 load()，之后只读，各线程可以直接访问。
+class ChannelRegistry
+{
+public:
+    static ChannelRegistry *instance();
+
+    void load(QSettings &settings);
+
+    int count() const { return m_channels.size(); }
+    const ChannelInfo &at(int index) const { return m_channels.at(index); }
+    int indexOf(const QString &key) const;
+
+    // 派生通道的下标集合
+    quint32 derivedMask() const { return m_derivedMask; }
+
+private:
+    ChannelRegistry();
+    int add(const ChannelInfo &info);
+    void addDerived(const QString &key);
+
+    QVector<ChannelInfo> m_channels;
+    quint32 m_derivedMask;
+};
+
+#endif // CHANNELREGISTRY_H
@@ -1,15 +1,23 @@
 #include "chartwidget.h"
 #include <QPaintEvent>
+#include <QShowEvent>
 #include <QDebug>
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QGridLayout>
 #include <cmath>
+#include <string.h>
+#include "metrics.h"
+#include "channelregistry.h"
+#include "derivedchannels.h"
+#include "memorybudget.h"
+#include "appsettings.h"
 
 // ============== SingleChartWidget 实现 ==============
 
-SingleChartWidget::SingleChartWidget(ChartType type, QWidget *parent)
+SingleChartWidget::SingleChartWidget(int channel, QWidget *parent)
     : QWidget(parent)
-    , m_chartType(type)
+    , m_channel(channel)
     , m_realTimeMode(true)
     , m_maxDataPoints(50)
     , m_marginLeft(60)  // 直接初始化为新值
@@ -18,12 +26,15 @@ SingleChartWidget::SingleChartWidget(ChartType type, QWidget *parent)
     , m_marginBottom(60)
     , m_minValue(0)
     , m_maxValue(100)
+    , m_plotDirty(true)
+    , m_plotScrolling(false)
+    , m_plotMin(0)
+    , m_plotMax(0)
     , m_gridColor(QColor(220, 220, 220))
     , m_axisColor(Qt::black)
     , m_textColor(Qt::black)
 {
-    // 根据类型设置颜色
-    m_chartColor = (type == TEMPERATURE) ? Qt::red : Qt::blue;
+    m_chartColor = ChannelRegistry::instance()->at(channel).color;
 
     setupUI();
     setMinimumSize(300, 200);
@@ -35,16 +46,22 @@ void SingleChartWidget::setupUI()
     mainLayout->setSpacing(0);
 
     // 标题和当前值显示
+    // 字体由全局样式表按 objectName 设置，这里只改颜色（调色板），避免每个采样都重新解析样式表
     m_titleLabel = new QLabel(getTypeString());  // 初始化标题标签
-    m_titleLabel->setStyleSheet("font-weight: bold; font-size: 24px;");
+    m_titleLabel->setObjectName("chartTitle");
 
     m_currentValueLabel = new QLabel("-- " + getUnitString());
-    m_currentValueLabel->setStyleSheet("font-size: 24px; color: gray;");
+    m_currentValueLabel->setObjectName("chartValue");
     m_currentValueLabel->setAlignment(Qt::AlignRight);
+    setValueColor(Qt::gray);
+
+    m_infoLabel = new QLabel(tr("数据点: 0"));
 
     QHBoxLayout *headerLayout = new QHBoxLayout();
     headerLayout->setContentsMargins(0, 0, 0, 0);
     headerLayout->addWidget(m_titleLabel);
+    headerLayout->addSpacing(20);
+    headerLayout->addWidget(m_infoLabel);
     headerLayout->addStretch();
     headerLayout->addWidget(m_currentValueLabel);
 
@@ -54,54 +71,114 @@ void SingleChartWidget::setupUI()
 
 void SingleChartWidget::addDataPoint(const SensorData &data)
 {
-    m_dataPoints.append(data);
+    if (!appendPoint(data))
+        return;
+
+    updateCurrentValue(m_dataPoints.last());
+
+    // 更新数据范围
+    updateScales();
+
+    // 量程和尺寸不变时只平移曲线层，否则下次绘制时整体重画
+    if (canScrollPlot())
+        scrollPlot();
+    else
+        m_plotDirty = true;
+
+    // 触发重绘
+    update();
+}
+
+void SingleChartWidget::addDataPoints(const QList<SensorData> &samples, int from)
+{
+    int last = -1;
+    for (int i = qMax(0, from); i < samples.size(); ++i) {
+        if (appendPoint(samples.at(i)))
+            last = i;
+    }
+    if (last < 0)
+        return;
+
+    updateCurrentValue(m_dataPoints.last());
+    updateScales();
+    m_plotDirty = true;
+    update();
+}
+
+bool SingleChartWidget::appendPoint(const SensorData &data)
+{
+    if (data.has(m_channel)) {
+        m_dataPoints.append(data);
+    } else {
+        // 派生通道在这里才算出，看不见的图表不会走到这里
+        SensorData derived = data;
+        if (!DerivedChannels::evaluate(&derived, 1u << m_channel))
+            return false;
+        m_dataPoints.append(derived);
+    }
 
     // 实时模式下限制数据点数量
     if (m_realTimeMode && m_dataPoints.size() > m_maxDataPoints) {
         m_dataPoints.removeFirst();
     }
+    return true;
+}
 
-    // 更新当前值显示
+void SingleChartWidget::updateCurrentValue(const SensorData &data)
+{
+    // 更新当前值显示，超出报警范围时显示为红色
+    const ChannelInfo &info = ChannelRegistry::instance()->at(m_channel);
     double currentValue = getValueFromData(data);
-    m_currentValueLabel->setText(QString::number(currentValue, 'f', 1) + " " + getUnitString());
-
-    // 根据值的范围设置颜色
-    QColor valueColor = m_chartColor;
-    if (m_chartType == HUMIDITY) {
-        if (currentValue > 70) valueColor = Qt::blue;
-        else if (currentValue < 30) valueColor = Qt::red;
-    }
+    m_currentValueLabel->setText(info.format(currentValue) + " " + getUnitString());
 
-    m_currentValueLabel->setStyleSheet(QString("font-size: 24px; color: %1; font-weight: bold;")
-                                      .arg(valueColor.name()));
+    bool outOfRange = info.alarmEnabled
+                   && (currentValue > info.alarmMax || currentValue < info.alarmMin);
+    setValueColor(outOfRange ? QColor(Qt::red) : m_chartColor);
 
     // 更新显示信息
     m_infoLabel->setText(tr("数据点: %1").arg(m_dataPoints.size()));
-
-    // 更新数据范围
-    updateScales();
-
-    // 触发重绘
-    update();
 }
 
 void SingleChartWidget::clearData()
 {
     m_dataPoints.clear();
     m_currentValueLabel->setText("-- " + getUnitString());
-    m_currentValueLabel->setStyleSheet("font-size: 12px; color: gray;");
+    setValueColor(Qt::gray);
     m_infoLabel->setText(tr("数据点: 0"));
+    m_plotDirty = true;
     update();
 }
 
+int SingleChartWidget::memoryBytes() const
+{
+    return m_dataPoints.size() * MemoryBudget::sampleBytes() + m_plotImage.byteCount();
+}
+
+void SingleChartWidget::releasePlot()
+{
+    m_plotImage = QImage();
+    m_plotDirty = true;
+}
+
+void SingleChartWidget::setValueColor(const QColor &color)
+{
+    QPalette palette = m_currentValueLabel->palette();
+    palette.setColor(QPalette::WindowText, color);
+    m_currentValueLabel->setPalette(palette);
+}
+
 void SingleChartWidget::setRealTimeMode(bool enabled)
 {
     m_realTimeMode = enabled;
+    m_plotDirty = true;
 }
 
 void SingleChartWidget::paintEvent(QPaintEvent *event)
 {
     Q_UNUSED(event);
+    Metrics::chartRepaints()->inc();
+    QElapsedTimer frame;
+    frame.start();
 
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
@@ -113,11 +190,13 @@ void SingleChartWidget::paintEvent(QPaintEvent *event)
 
     // 绘制图表
     drawChart(painter);
+    Metrics::chartFrameTime()->observe(int(frame.nsecsElapsed() / 1000));
 }
 
 void SingleChartWidget::resizeEvent(QResizeEvent *event)
 {
     Q_UNUSED(event);
+    m_plotDirty = true;
     update();
 }
 
@@ -135,14 +214,17 @@ void SingleChartWidget::drawChart(QPainter &painter)
         return;
     }
 
-    // 绘制网格
+    // 绘制网格（固定不动，不放在曲线层里）
     drawGrid(painter);
 
+    // 绘制数据
+    if (m_plotDirty || m_plotImage.size() != m_chartRect.size())
+        rebuildPlot();
+    painter.drawImage(m_chartRect.topLeft(), m_plotImage);
+    drawLatestPoint(painter);
+
     // 绘制坐标轴
     drawAxes(painter);
-
-    // 绘制数据
-    drawData(painter);
 }
 
 void SingleChartWidget::drawGrid(QPainter &painter)
@@ -220,42 +302,107 @@ void SingleChartWidget::drawAxes(QPainter &painter)
     }
 }
 
-void SingleChartWidget::drawData(QPainter &painter)
+// 实时模式窗口已满时按固定整数步长从右向左排列，平移一步正好是一个采样；
+// 步长向上取整，最旧的点落在左边界上或略微超出
+double SingleChartWidget::pointX(int index, int count, int width) const
 {
-    if (m_dataPoints.size() < 2) return;
+    if (m_plotScrolling) {
+        int step = (width + m_maxDataPoints - 2) / (m_maxDataPoints - 1);
+        return width - double(step) * (count - 1 - index);
+    }
+    return (double)(width * index) / (count - 1);
+}
 
-    painter.setRenderHint(QPainter::Antialiasing);
+double SingleChartWidget::pointY(double value, int height) const
+{
+    return height - (value - m_plotMin) * height / (m_plotMax - m_plotMin);
+}
+
+void SingleChartWidget::drawPoint(QPainter &painter, const QPointF &point)
+{
     painter.setPen(QPen(m_chartColor, 2));
+    painter.setBrush(m_chartColor);
+    painter.drawEllipse(point, 3, 3);
+}
 
-    QList<QPointF> points;
+bool SingleChartWidget::canScrollPlot() const
+{
+    return m_plotScrolling && !m_plotDirty
+        && m_realTimeMode && m_dataPoints.size() == m_maxDataPoints
+        && m_plotMin == m_minValue && m_plotMax == m_maxValue
+        && m_plotImage.size() == m_chartRect.size();
+}
 
-    for (int i = 0; i < m_dataPoints.size(); ++i) {
-        double value = getValueFromData(m_dataPoints[i]);
+// 整体重画曲线层，只在量程、尺寸或排列方式变化时调用
+void SingleChartWidget::rebuildPlot()
+{
+    if (m_plotImage.size() != m_chartRect.size())
+        m_plotImage = QImage(m_chartRect.size(), QImage::Format_ARGB32_Premultiplied);
+    m_plotImage.fill(0);
 
-        // 转换为屏幕坐标
-        double x = m_chartRect.left() + (double)(m_chartRect.width() * i) / (m_dataPoints.size() - 1);
-        double y = m_chartRect.bottom() - (value - m_minValue) * m_chartRect.height() / (m_maxValue - m_minValue);
+    m_plotMin = m_minValue;
+    m_plotMax = m_maxValue;
+    m_plotScrolling = m_realTimeMode && m_dataPoints.size() >= m_maxDataPoints;
+    m_plotDirty = false;
 
-        points.append(QPointF(x, y));
-    }
+    int n = m_dataPoints.size();
+    if (n < 2 || m_plotImage.isNull())
+        return;
 
-    // 绘制曲线
-    for (int i = 1; i < points.size(); ++i) {
-        painter.drawLine(points[i-1], points[i]);
-    }
+    QPainter painter(&m_plotImage);
+    painter.setRenderHint(QPainter::Antialiasing);
 
-    // 绘制数据点
-    painter.setBrush(m_chartColor);
-    for (int i = 0; i < points.size(); ++i) {
-        painter.drawEllipse(points[i], 3, 3);
+    int w = m_plotImage.width();
+    int h = m_plotImage.height();
+    QPointF previous;
+    for (int i = 0; i < n; ++i) {
+        QPointF point(pointX(i, n, w), pointY(getValueFromData(m_dataPoints[i]), h));
+        if (i > 0) {
+            painter.setPen(QPen(m_chartColor, 2));
+            painter.drawLine(previous, point);
+        }
+        previous = point;
     }
+    for (int i = 0; i < n; ++i)
+        drawPoint(painter, QPointF(pointX(i, n, w), pointY(getValueFromData(m_dataPoints[i]), h)));
+}
 
-    // 高亮最新数据点
-    if (!points.isEmpty()) {
-        painter.setPen(QPen(m_chartColor, 3));
-        painter.setBrush(Qt::white);
-        painter.drawEllipse(points.last(), 5, 5);
+// 已有像素左移一个步长，清空右侧露出的部分，只画最后一段线和两端的点
+void SingleChartWidget::scrollPlot()
+{
+    int w = m_plotImage.width();
+    int h = m_plotImage.height();
+    int n = m_dataPoints.size();
+    int step = qMin(w, (w + m_maxDataPoints - 2) / (m_maxDataPoints - 1));
+
+    for (int y = 0; y < h; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(m_plotImage.scanLine(y));
+        memmove(line, line + step, (w - step) * sizeof(QRgb));
+        memset(line + w - step, 0, step * sizeof(QRgb));
     }
+
+    QPainter painter(&m_plotImage);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QPointF previous(pointX(n - 2, n, w), pointY(getValueFromData(m_dataPoints[n - 2]), h));
+    QPointF latest(pointX(n - 1, n, w), pointY(getValueFromData(m_dataPoints[n - 1]), h));
+    painter.setPen(QPen(m_chartColor, 2));
+    painter.drawLine(previous, latest);
+    drawPoint(painter, previous);
+    drawPoint(painter, latest);
+}
+
+// 最新数据点的高亮直接画在控件上，不进入曲线层，平移后不留残影
+void SingleChartWidget::drawLatestPoint(QPainter &painter)
+{
+    int n = m_dataPoints.size();
+    if (n < 2) return;
+
+    QPointF point(m_chartRect.left() + pointX(n - 1, n, m_chartRect.width()),
+                  m_chartRect.top() + pointY(getValueFromData(m_dataPoints.last()), m_chartRect.height()));
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(m_chartColor, 3));
+    painter.setBrush(Qt::white);
+    painter.drawEllipse(point, 5, 5);
 }
 
 void SingleChartWidget::updateScales()
@@ -271,6 +418,17 @@ void SingleChartWidget::updateScales()
         if (value > m_maxValue) m_maxValue = value;
     }
 
+    // 实时模式下数据仍在当前量程内且占满一半以上时不改量程，避免曲线层频繁整体重画
+    double dataMin = m_minValue;
+    double dataMax = m_maxValue;
+    if (m_realTimeMode && !m_plotDirty && m_plotMax > m_plotMin
+        && dataMin >= m_plotMin && dataMax <= m_plotMax
+        && qMax(dataMax - dataMin, 1.0) * 1.2 >= (m_plotMax - m_plotMin) * 0.5) {
+        m_minValue = m_plotMin;
+        m_maxValue = m_plotMax;
+        return;
+    }
+
     // 添加一些边距
     double range = m_maxValue - m_minValue;
     if (range < 1) range = 1; // 避免除零
@@ -278,38 +436,25 @@ void SingleChartWidget::updateScales()
     m_minValue -= range * 0.1;
     m_maxValue += range * 0.1;
 
-    // 根据类型设置合理的范围
-    if (m_chartType == HUMIDITY) {
-        if (m_minValue < 0) m_minValue = 0;
-        if (m_maxValue > 100) m_maxValue = 100;
-    }
+    // 不超出通道的量程（例如湿度 0~100）
+    const ChannelInfo &info = ChannelRegistry::instance()->at(m_channel);
+    if (m_minValue < info.minValue) m_minValue = info.minValue;
+    if (m_maxValue > info.maxValue) m_maxValue = info.maxValue;
 }
 
 double SingleChartWidget::getValueFromData(const SensorData &data) const
 {
-    switch (m_chartType) {
-        case TEMPERATURE: return data.temperature;
-        case HUMIDITY: return data.humidity;
-        default: return 0;
-    }
+    return data.value(m_channel);
 }
 
 QString SingleChartWidget::getUnitString() const
 {
-    switch (m_chartType) {
-        case TEMPERATURE: return "°C";
-        case HUMIDITY: return "%";
-        default: return "";
-    }
+    return ChannelRegistry::instance()->at(m_channel).unit;
 }
 
 QString SingleChartWidget::getTypeString() const
 {
-    switch (m_chartType) {
-        case TEMPERATURE: return tr("温度");
-        case HUMIDITY: return tr("湿度");
-        default: return "";
-    }
+    return ChannelRegistry::instance()->at(m_channel).name;
 }
 
 QColor SingleChartWidget::getChartColor() const
@@ -322,7 +467,12 @@ QColor SingleChartWidget::getChartColor() const
 ChartWidget::ChartWidget(QWidget *parent)
     : QWidget(parent)
     , m_displayMode(0)
+    , m_recentCapacity(50)
+    , m_sequence(0)
+    , m_watchingWindow(false)
 {
+    m_account = MemoryBudget::instance()->account(
+        "chart", MemoryAccount::Buffer, appSettings().value("memory/chartKB", 8192).toInt() * 1024);
     setupUI();
     setMinimumSize(400, 300);
 }
@@ -337,11 +487,11 @@ void ChartWidget::setupUI()
     QHBoxLayout *controlLayout = new QHBoxLayout();
     controlLayout->addWidget(new QLabel(tr("显示模式:")));
 
+    const ChannelRegistry *channels = ChannelRegistry::instance();
     m_displayModeCombo = new QComboBox();
     m_displayModeCombo->addItem(tr("分离显示（推荐）"));
-    m_displayModeCombo->addItem(tr("仅温度"));
-    m_displayModeCombo->addItem(tr("仅湿度"));
-    m_displayModeCombo->setStyleSheet("...");  // 保留原有样式
+    for (int c = 0; c < channels->count(); ++c)
+        m_displayModeCombo->addItem(tr("仅%1").arg(channels->at(c).name));
 
     connect(m_displayModeCombo, SIGNAL(currentIndexChanged(int)),
             this, SLOT(onChartTypeChanged()));
@@ -350,38 +500,121 @@ void ChartWidget::setupUI()
     controlLayout->addStretch();
     mainLayout->addLayout(controlLayout);
 
-    // 创建图表区域
+    // 创建图表区域，每行两个
     QWidget *chartsContainer = new QWidget();
-    QHBoxLayout *chartsLayout = new QHBoxLayout(chartsContainer);
+    QGridLayout *chartsLayout = new QGridLayout(chartsContainer);
     chartsLayout->setContentsMargins(0, 0, 0, 0);
     chartsLayout->setSpacing(10);
 
-    // 创建两个图表
-    m_temperatureChart = new SingleChartWidget(SingleChartWidget::TEMPERATURE);
-    m_humidityChart = new SingleChartWidget(SingleChartWidget::HUMIDITY);
-
     // 设置16:9比例 (15.5cm x 9cm)
     const int width = static_cast<int>(15.5 * 96 / 2.54);  // 厘米转像素
     const int height = static_cast<int>(9 * 96 / 2.54);
 
-    m_temperatureChart->setFixedSize(width, height);
-    m_humidityChart->setFixedSize(width, height);
-
-    chartsLayout->addWidget(m_temperatureChart);
-    chartsLayout->addWidget(m_humidityChart);
+    for (int c = 0; c < channels->count(); ++c) {
+        SingleChartWidget *chart = new SingleChartWidget(c);
+        chart->setFixedSize(width, height);
+        chartsLayout->addWidget(chart, c / 2, c % 2);
+        chart->installEventFilter(this);
+        m_charts.append(chart);
+        m_cursors.append(0);
+    }
     mainLayout->addWidget(chartsContainer);
 }
 
 void ChartWidget::addDataPoint(const SensorData &data)
 {
-    m_temperatureChart->addDataPoint(data);
-    m_humidityChart->addDataPoint(data);
+    m_recent.append(data);
+    if (m_recent.size() > m_recentCapacity)
+        m_recent.removeFirst();
+    ++m_sequence;
+
+    // 看不见的图表不做任何处理，显示时再补
+    for (int i = 0; i < m_charts.size(); ++i) {
+        if (!isViewable(m_charts[i]))
+            continue;
+        if (m_cursors[i] != m_sequence - 1)
+            catchUp(i);
+        else
+            m_charts[i]->addDataPoint(data);
+        m_cursors[i] = m_sequence;
+    }
+    updateMemoryUsage();
+}
+
+void ChartWidget::updateMemoryUsage()
+{
+    int bytes = m_recent.size() * MemoryBudget::sampleBytes();
+    for (int i = 0; i < m_charts.size(); ++i)
+        bytes += m_charts[i]->memoryBytes();
+    m_account->setUsage(bytes);
+    if (bytes > m_account->limit())
+        applyMemoryLimit();
+}
+
+void ChartWidget::applyMemoryLimit()
+{
+    // 看不见的图表的曲线层重新显示时再画；数据点本来就有上限，不截断
+    int bytes = m_recent.size() * MemoryBudget::sampleBytes();
+    for (int i = 0; i < m_charts.size(); ++i) {
+        if (!isViewable(m_charts[i]))
+            m_charts[i]->releasePlot();
+        bytes += m_charts[i]->memoryBytes();
+    }
+    m_account->setUsage(bytes);
+}
+
+bool ChartWidget::isViewable(SingleChartWidget *chart) const
+{
+    return chart->isVisible() && !window()->isMinimized();
+}
+
+// 从共享缓冲区补上第 index 个图表错过的采样
+void ChartWidget::catchUp(int index)
+{
+    qint64 missed = m_sequence - m_cursors[index];
+    if (missed <= 0)
+        return;
+
+    SingleChartWidget *chart = m_charts[index];
+    if (missed >= m_recent.size()) {
+        // 缓冲区里已经没有衔接点，用缓冲区的内容重建
+        chart->clearData();
+        chart->addDataPoints(m_recent, 0);
+    } else {
+        chart->addDataPoints(m_recent, m_recent.size() - int(missed));
+    }
+    m_cursors[index] = m_sequence;
+}
+
+bool ChartWidget::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Show) {
+        int index = m_charts.indexOf(static_cast<SingleChartWidget *>(watched));
+        if (index >= 0 && !window()->isMinimized())
+            catchUp(index);
+    } else if (event->type() == QEvent::WindowStateChange && watched == window()) {
+        // 从最小化恢复时子控件收不到 Show 事件
+        for (int i = 0; i < m_charts.size(); ++i) {
+            if (isViewable(m_charts[i]))
+                catchUp(i);
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void ChartWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    if (!m_watchingWindow && window() != this) {
+        window()->installEventFilter(this);
+        m_watchingWindow = true;
+    }
 }
 
 void ChartWidget::setChartType(int type)
 {
     m_displayMode = type;
-    if (m_displayMode > 2) m_displayMode = 0;
+    if (m_displayMode > m_charts.size()) m_displayMode = 0;
 
     m_displayModeCombo->setCurrentIndex(m_displayMode);
     onChartTypeChanged();
@@ -389,33 +622,24 @@ void ChartWidget::setChartType(int type)
 
 void ChartWidget::clearData()
 {
-    m_temperatureChart->clearData();
-    m_humidityChart->clearData();
+    m_recent.clear();
+    for (int i = 0; i < m_charts.size(); ++i) {
+        m_charts[i]->clearData();
+        m_cursors[i] = m_sequence;
+    }
 }
 
 void ChartWidget::setRealTimeMode(bool enabled)
 {
-    m_temperatureChart->setRealTimeMode(enabled);
-    m_humidityChart->setRealTimeMode(enabled);
+    for (int i = 0; i < m_charts.size(); ++i)
+        m_charts[i]->setRealTimeMode(enabled);
 }
 
 void ChartWidget::onChartTypeChanged()
 {
     m_displayMode = m_displayModeCombo->currentIndex();
 
-    // 根据显示模式控制图表可见性
-    switch (m_displayMode) {
-        case 0: // 分离显示所有
-            m_temperatureChart->setVisible(true);
-            m_humidityChart->setVisible(true);
-            break;
-        case 1: // 仅温度
-            m_temperatureChart->setVisible(true);
-            m_humidityChart->setVisible(false);
-            break;
-        case 2: // 仅湿度
-            m_temperatureChart->setVisible(false);
-            m_humidityChart->setVisible(true);
-            break;
-    }
+    // 0 显示全部，其他只显示对应的通道
+    for (int i = 0; i < m_charts.size(); ++i)
+        m_charts[i]->setVisible(m_displayMode == 0 || m_displayMode == i + 1);
 }
@@ -13,31 +13,38 @@
 #include <QList>
 #include <QPointF>
 #include <QDateTime>
+#include <QImage>
 #include "sensordata.h"
 
+class MemoryAccount;
+
+// 单个通道的曲线，名称、单位、颜色和量程取自 ChannelRegistry
 class SingleChartWidget : public QWidget
 {
     Q_OBJECT
 
 public:
-    enum ChartType {
-        TEMPERATURE = 0,
-        HUMIDITY = 1
-    };
-
-    explicit SingleChartWidget(ChartType type, QWidget *parent = 0);
+    explicit SingleChartWidget(int channel, QWidget *parent = 0);
 
     // 添加数据点
     void addDataPoint(const SensorData &data);
 
+    // 一次补上 samples[from..] 中的数据点，标签、量程和曲线层只更新一次
+    void addDataPoints(const QList<SensorData> &samples, int from);
+
     // 清空数据
     void clearData();
 
     // 设置是否实时模式
     void setRealTimeMode(bool enabled);
 
-    // 获取图表类型
-    ChartType getChartType() const { return m_chartType; }
+    // 通道下标（ChannelRegistry 中的位置）
+    int channel() const { return m_channel; }
+
+    // 数据点和曲线层的大致占用
+    int memoryBytes() const;
+    // 丢弃曲线层，下次绘制时重建
+    void releasePlot();
 
 protected:
     void paintEvent(QPaintEvent *event);
@@ -48,23 +55,34 @@ private:
     void drawChart(QPainter &painter);
     void drawGrid(QPainter &painter);
     void drawAxes(QPainter &painter);
-    void drawData(QPainter &painter);
+    void drawLatestPoint(QPainter &painter);
     void updateScales();
+
+    // 曲线层：离屏 QImage，实时模式窗口满后新采样只平移已有像素并画新的一段
+    bool canScrollPlot() const;
+    void scrollPlot();
+    void rebuildPlot();
+    double pointX(int index, int count, int width) const;
+    double pointY(double value, int height) const;
+    void drawPoint(QPainter &painter, const QPointF &point);
+    bool appendPoint(const SensorData &data);
+    void updateCurrentValue(const SensorData &data);
     double getValueFromData(const SensorData &data) const;
     QString getUnitString() const;
     QString getTypeString() const;
     QColor getChartColor() const;
+    void setValueColor(const QColor &color);
 
     // UI组件
     QLabel *m_titleLabel;
     QLabel *m_currentValueLabel;
     QLabel *m_infoLabel;
 
-    // 数据存储
+    // 数据存储，只保存带有本通道读数的采样
     QList<SensorData> m_dataPoints;
 
     // 图表设置
-    ChartType m_chartType;
+    int m_channel;
     bool m_realTimeMode;
     int m_maxDataPoints;
 
@@ -79,6 +97,13 @@ private:
     double m_minValue;
     double m_maxValue;
 
+    // 曲线层及其绘制时的坐标参数，参数变化（量程、尺寸）时整体重画
+    QImage m_plotImage;
+    bool m_plotDirty;
+    bool m_plotScrolling;   // 按固定步长排列（实时模式窗口已满）
+    double m_plotMin;
+    double m_plotMax;
+
     // 颜色配置
     QColor m_chartColor;
     QColor m_gridColor;
@@ -86,6 +111,13 @@ private:
     QColor m_textColor;
 };
 
+// 多通道图表
+//
+// 最近的采样放在共享缓冲区中，只有可见的图表（所在页签是当前页、显示模式包含它、
+// 窗口没有最小化）才逐个接收采样；隐藏的图表只留一个游标，
+// 重新显示时从缓冲区一次补齐，落后超过缓冲区长度时直接用缓冲区重建。
+// 数据点和各图表的曲线层记在内存账户 chart 上（memory/chartKB，默认 8192），
+// 超出账户的上限时先丢弃看不见的图表的曲线层。
 class ChartWidget : public QWidget
 {
     Q_OBJECT
@@ -105,21 +137,39 @@ public:
     // 设置是否实时模式
     void setRealTimeMode(bool enabled);
 
+    // 内存压力变化时调用
+    void applyMemoryLimit();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event);
+    void showEvent(QShowEvent *event);
+
 private slots:
     void onChartTypeChanged();
 
 private:
     void setupUI();
+    bool isViewable(SingleChartWidget *chart) const;
+    void catchUp(int index);
+    void updateMemoryUsage();
 
     // UI组件
     QComboBox *m_displayModeCombo;
 
-    // 两个独立的图表
-    SingleChartWidget *m_temperatureChart;
-    SingleChartWidget *m_humidityChart;
+    // 每个通道一个图表，顺序与 ChannelRegistry 相同
+    QList<SingleChartWidget *> m_charts;
 
-    // 当前显示模式：0=分离显示, 1=只显示温度, 2=只显示湿度
+    // 当前显示模式：0=全部显示, i+1=只显示第 i 个通道
     int m_displayMode;
+
+    // 共享缓冲区：最近 m_recentCapacity 个采样，m_sequence 为累计收到的采样数；
+    // m_cursors[i] 是第 i 个图表已经收到的采样数
+    QList<SensorData> m_recent;
+    int m_recentCapacity;
+    qint64 m_sequence;
+    QList<qint64> m_cursors;
+    bool m_watchingWindow;
+    MemoryAccount *m_account;
 };
 
 #endif // CHARTWIDGET_H
@@ -0,0 +1,246 @@
+#include "chunkcodec.h"
+
+static const int kHeaderSize = 14;
+static const int kHeaderSizeV1 = 13;
+static const uchar kChunkVersion = 2;
+static const int kDefaultDecimals = 2;
+
+// 变长前缀码各档的位宽，最后一档直接写补码
+static const int kTimestampWidths[4] = { 7, 9, 12, 64 };
+static const int kValueWidths[4] = { 4, 7, 12, 32 };
+
+static double decimalScale(int decimals)
+{
+    double scale = 1.0;
+    for (int i = 0; i < decimals; ++i)
+        scale *= 10.0;
+    return scale;
+}
+
+static inline qint32 toFixed(double v, double scale)
+{
+    return qint32(qRound(v * scale));
+}
+
+static inline double fromFixed(qint64 v, double scale)
+{
+    return double(v) / scale;
+}
+
+// ============== 编码 ==============
+
+ChunkEncoder::ChunkEncoder()
+    : m_decimals(kDefaultDecimals)
+    , m_scale(decimalScale(kDefaultDecimals))
+{
+    clear();
+}
+
+void ChunkEncoder::setDecimals(int decimals)
+{
+    m_decimals = qBound(0, decimals, 9);
+    m_scale = decimalScale(m_decimals);
+}
+
+void ChunkEncoder::clear()
+{
+    m_bits.clear();
+    m_bitCount = 0;
+    m_count = 0;
+    m_firstTimestamp = 0;
+    m_lastTimestamp = 0;
+    m_lastDelta = 0;
+    m_lastValue = 0;
+}
+
+void ChunkEncoder::append(qint64 timestampMs, double value, double raw)
+{
+    qint32 v = toFixed(value, m_scale);
+
+    if (m_count == 0) {
+        m_firstTimestamp = timestampMs;
+    } else {
+        qint64 delta = timestampMs - m_lastTimestamp;
+        writeTiered(delta - m_lastDelta, kTimestampWidths);
+        m_lastDelta = delta;
+    }
+    writeTiered(qint64(v) - m_lastValue, kValueWidths);
+    writeTiered(qint64(toFixed(raw, m_scale)) - v, kValueWidths);
+
+    m_lastTimestamp = timestampMs;
+    m_lastValue = v;
+    ++m_count;
+}
+
+QByteArray ChunkEncoder::data() const
+{
+    QByteArray out;
+    out.reserve(kHeaderSize + m_bits.size());
+    out.append(char(kChunkVersion));
+    out.append(char(m_decimals));
+    for (int i = 0; i < 4; ++i)
+        out.append(char((quint32(m_count) >> (8 * i)) & 0xff));
+    for (int i = 0; i < 8; ++i)
+        out.append(char((quint64(m_firstTimestamp) >> (8 * i)) & 0xff));
+    out.append(m_bits);
+    return out;
+}
+
+int ChunkEncoder::sizeBytes() const
+{
+    return kHeaderSize + m_bits.size();
+}
+
+// 高位在前追加 bits 位（bits <= 64）
+void ChunkEncoder::writeBits(quint64 value, int bits)
+{
+    while (bits > 0) {
+        int used = m_bitCount & 7;
+        if (used == 0)
+            m_bits.append(char(0));
+        int take = qMin(8 - used, bits);
+        uchar chunk = uchar((value >> (bits - take)) & ((1u << take) - 1));
+        m_bits.data()[m_bits.size() - 1] |= char(chunk << (8 - used - take));
+        bits -= take;
+        m_bitCount += take;
+    }
+}
+
+// 0 写 1 位；第 k 档写 k+1 个 1 和一个 0（最后一档没有 0），再写偏移后的值
+void ChunkEncoder::writeTiered(qint64 value, const int *widths)
+{
+    if (value == 0) {
+        writeBits(0, 1);
+        return;
+    }
+    for (int tier = 0; tier < 3; ++tier) {
+        qint64 bias = (qint64(1) << (widths[tier] - 1)) - 1;
+        if (value >= -bias && value <= bias + 1) {
+            writeBits(((quint64(1) << (tier + 1)) - 1) << 1, tier + 2);
+            writeBits(quint64(value + bias), widths[tier]);
+            return;
+        }
+    }
+    writeBits(0xf, 4);
+    writeBits(quint64(value), widths[3]);
+}
+
+// ============== 解码 ==============
+
+ChunkDecoder::ChunkDecoder(const QByteArray &chunk)
+    : m_chunk(chunk)
+    , m_scale(decimalScale(kDefaultDecimals))
+    , m_data(reinterpret_cast<const uchar *>(m_chunk.constData()))
+    , m_sizeBits(0)
+    , m_bitPos(0)
+    , m_valid(false)
+    , m_count(0)
+    , m_index(0)
+    , m_firstTimestamp(0)
+    , m_lastTimestamp(0)
+    , m_lastDelta(0)
+    , m_lastValue(0)
+{
+    if (m_chunk.size() < kHeaderSizeV1)
+        return;
+
+    int headerSize;
+    const uchar *p = m_data + 1;
+    if (m_data[0] == kChunkVersion && m_chunk.size() >= kHeaderSize) {
+        headerSize = kHeaderSize;
+        m_scale = decimalScale(qMin(int(*p++), 9));
+    } else if (m_data[0] == 1) {
+        headerSize = kHeaderSizeV1;
+    } else {
+        return;
+    }
+
+    quint32 count = 0;
+    for (int i = 0; i < 4; ++i)
+        count |= quint32(p[i]) << (8 * i);
+    quint64 first = 0;
+    for (int i = 0; i < 8; ++i)
+        first |= quint64(p[4 + i]) << (8 * i);
+
+    m_count = int(count);
+    m_firstTimestamp = qint64(first);
+    m_data += headerSize;
+    m_sizeBits = (m_chunk.size() - headerSize) * 8;
+    m_valid = true;
+}
+
+bool ChunkDecoder::next(qint64 *timestampMs, double *value, double *raw)
+{
+    if (!m_valid || m_index >= m_count)
+        return false;
+
+    qint64 dod = 0, dv, dr;
+    if (m_index > 0 && !readTiered(kTimestampWidths, &dod))
+        return false;
+    if (!readTiered(kValueWidths, &dv) || !readTiered(kValueWidths, &dr))
+        return false;
+
+    if (m_index == 0) {
+        m_lastTimestamp = m_firstTimestamp;
+    } else {
+        m_lastDelta += dod;
+        m_lastTimestamp += m_lastDelta;
+    }
+    m_lastValue = qint32(m_lastValue + dv);
+    ++m_index;
+
+    *timestampMs = m_lastTimestamp;
+    *value = fromFixed(m_lastValue, m_scale);
+    *raw = fromFixed(m_lastValue + dr, m_scale);
+    return true;
+}
+
+bool ChunkDecoder::readBits(int bits, quint64 *value)
+{
+    if (m_bitPos + bits > m_sizeBits)
+        return false;
+
+    quint64 v = 0;
+    while (bits > 0) {
+        int offset = m_bitPos & 7;
+        int take = qMin(8 - offset, bits);
+        uint chunk = (m_data[m_bitPos >> 3] >> (8 - offset - take)) & ((1u << take) - 1);
+        v = (v << take) | chunk;
+        bits -= take;
+        m_bitPos += take;
+    }
+    *value = v;
+    return true;
+}
+
+bool ChunkDecoder::readTiered(const int *widths, qint64 *value)
+{
+    // 前缀最多 4 个 1
+    int ones = 0;
+    quint64 bits;
+    while (ones < 4) {
+        if (!readBits(1, &bits))
+            return false;
+        if (bits == 0)
+            break;
+        ++ones;
+    }
+
+    if (ones == 0) {
+        *value = 0;
+        return true;
+    }
+    int tier = ones - 1;
+    if (!readBits(widths[tier], &bits))
+        return false;
+
+    if (tier == 3) {
+        // 补码，按位宽做符号扩展
+        if (widths[3] < 64 && (bits >> (widths[3] - 1)) & 1)
+            bits |= ~quint64(0) << widths[3];
+        *value = qint64(bits);
+    } else {
+        *value = qint64(bits) - ((qint64(1) << (widths[tier] - 1)) - 1);
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef CHUNKCODEC_H
+#define CHUNKCODEC_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+// 采样块压缩编码
+//
+// 一个块保存一个通道在一段时间内的全部采样，顺序写入、顺序解码：
+//   时间戳：delta-of-delta，固定节拍采样时每个采样约 1~9 位
+//     0                    dod == 0
+//     10   + 7 位          dod 在 [-63, 64]
+//     110  + 9 位          dod 在 [-255, 256]
+//     1110 + 12 位         dod 在 [-2047, 2048]
+//     1111 + 64 位         其他
+//   数值：按通道的存储精度（默认 0.01）定点化后与上一个值做差，同样的变长前缀码
+//     0                    相同
+//     10   + 4 位          差在 [-7, 8]
+//     110  + 7 位          差在 [-63, 64]
+//     1110 + 12 位         差在 [-2047, 2048]
+//     1111 + 32 位         其他（首个值与 0 做差）
+//   原始值：与同一采样的滤波值做差，未启用滤波时每个采样 1 位
+//
+// 没有用 Gorilla 的浮点 XOR：SHT11 的读数落在 0.01 的十进制网格上，
+// 相邻两个单精度值 XOR 后通常仍有 15~20 位有效位，而定点差值多数只要 1~7 位。
+// 存储精度低于传感器分辨率时，定点化不损失有意义的精度。
+//
+// 块格式（小端）：版本(1) 小数位数(1) 采样数(4) 首个时间戳(8) 位流（高位在前）
+// 版本 1 没有小数位数字段，固定为 2 位。
+// 采样数在块头中，块可以在写入过程中随时取出保存，之后再恢复继续追加。
+
+class ChunkEncoder
+{
+public:
+    ChunkEncoder();
+
+    // 存储精度（小数位数），clear() 之后、第一次 append() 之前设置
+    void setDecimals(int decimals);
+
+    void clear();
+    void append(qint64 timestampMs, double value, double raw);
+
+    int count() const { return m_count; }
+    qint64 firstTimestamp() const { return m_firstTimestamp; }
+    qint64 lastTimestamp() const { return m_lastTimestamp; }
+
+    // 块头 + 位流
+    QByteArray data() const;
+    int sizeBytes() const;
+
+private:
+    void writeBits(quint64 value, int bits);
+    void writeTiered(qint64 value, const int *widths);
+
+    QByteArray m_bits;
+    int m_decimals;
+    double m_scale;
+    int m_bitCount;
+    int m_count;
+    qint64 m_firstTimestamp;
+    qint64 m_lastTimestamp;
+    qint64 m_lastDelta;
+    qint32 m_lastValue;
+};
+
+class ChunkDecoder
+{
+public:
+    explicit ChunkDecoder(const QByteArray &chunk);
+
+    // 块头损坏或版本不符时为 false
+    bool isValid() const { return m_valid; }
+    int count() const { return m_count; }
+    qint64 firstTimestamp() const { return m_firstTimestamp; }
+
+    // 按写入顺序取下一个采样，结束或位流截断时返回 false
+    bool next(qint64 *timestampMs, double *value, double *raw);
+
+private:
+    bool readBits(int bits, quint64 *value);
+    bool readTiered(const int *widths, qint64 *value);
+
+    QByteArray m_chunk;
+    double m_scale;
+    const uchar *m_data;
+    int m_sizeBits;
+    int m_bitPos;
+    bool m_valid;
+    int m_count;
+    int m_index;
+    qint64 m_firstTimestamp;
+    qint64 m_lastTimestamp;
+    qint64 m_lastDelta;
+    qint32 m_lastValue;
+};
+
+#endif // CHUNKCODEC_H
@@ -0,0 +1,447 @@
+#include "csvimport.h"
+#include "sensorstorage.h"
+#include "channelregistry.h"
+#include <QFile>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cstring>
+
+static const int kBlockSize = 1024 * 1024;
+static const qint64 kMsPerDay = Q_INT64_C(86400000);
+
+static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// 去掉首尾空白和引号
+static void trim(const char **begin, const char **end)
+{
+    while (*begin < *end && (**begin == ' ' || **begin == '\t' || **begin == '"'))
+        ++*begin;
+    while (*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '"'))
+        --*end;
+}
+
+// 读 1~maxDigits 位十进制数，返回读到的位数
+static int readInt(const char **p, const char *end, int maxDigits, int *value)
+{
+    int digits = 0;
+    *value = 0;
+    while (*p < end && digits < maxDigits && isDigit(**p)) {
+        *value = *value * 10 + (**p - '0');
+        ++*p;
+        ++digits;
+    }
+    return digits;
+}
+
+// 定点小数，小数点可以是 . 或 ,（分号分隔的文件），不支持指数形式；
+// 比 strtod 快，也不受 locale 影响
+static bool parseNumber(const char *p, const char *end, double *out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    qint64 mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+    bool dot = false;
+    for (; p < end; ++p) {
+        if (isDigit(*p)) {
+            if (digits < 18) {
+                mantissa = mantissa * 10 + (*p - '0');
+                ++digits;
+                if (dot)
+                    ++scale;
+            } else if (!dot) {
+                return false;
+            }
+        } else if ((*p == '.' || *p == ',') && !dot) {
+            dot = true;
+        } else {
+            return false;
+        }
+    }
+    if (digits == 0)
+        return false;
+
+    double value = double(mantissa) / kPow10[scale];
+    *out = negative ? -value : value;
+    return true;
+}
+
+// 公历日期到 1970-01-01 的天数
+static qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return qint64(era) * 146097 + doe - 719468;
+}
+
+static int daysInMonth(int year, int month)
+{
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month == 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+        return 29;
+    return days[month - 1];
+}
+
+CsvImporter::CsvImporter(SensorStorage *storage)
+    : m_storage(storage)
+    , m_commitEvery(50000)
+    , m_maxRejectLog(20)
+    , m_delimiter(',')
+    , m_offsetKey(-1)
+    , m_offsetMs(0)
+    , m_previousMs(0)
+{
+}
+
+bool CsvImporter::run(const QString &path)
+{
+    m_report = Report();
+    m_columns.clear();
+    m_spacing.clear();
+    m_previousMs = 0;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_lastError = file.errorString();
+        return false;
+    }
+    if (!m_storage->beginImport(m_commitEvery)) {
+        m_lastError = m_storage->lastError();
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 按块读入，在缓冲区中原地切分行；块尾不完整的行移到缓冲区开头，和下一块拼接
+    QByteArray buffer;
+    buffer.resize(kBlockSize);
+    int kept = 0;
+    qint64 lineNumber = 0;
+    bool headerChecked = false;
+    bool ok = true;
+
+    while (ok) {
+        if (kept == buffer.size())
+            buffer.resize(buffer.size() * 2);   // 一行比缓冲区还长
+        qint64 n = file.read(buffer.data() + kept, buffer.size() - kept);
+        if (n < 0) {
+            m_lastError = file.errorString();
+            ok = false;
+            break;
+        }
+        m_report.bytes += n;
+        bool atEnd = n == 0;
+
+        const char *p = buffer.constData();
+        const char *end = p + kept + int(n);
+        while (p < end) {
+            const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!nl) {
+                if (!atEnd)
+                    break;
+                nl = end;
+            }
+            const char *lineEnd = nl;
+            if (lineEnd > p && lineEnd[-1] == '\r')
+                --lineEnd;
+            ++lineNumber;
+
+            if (lineNumber == 1 && lineEnd - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+                p += 3;     // UTF-8 BOM
+
+            const char *first = p;
+            while (first < lineEnd && (*first == ' ' || *first == '\t'))
+                ++first;
+            if (first < lineEnd && *first != '#') {
+                if (headerChecked) {
+                    ok = importLine(p, lineEnd, lineNumber);
+                } else {
+                    // 第一行：识别分隔符和各列对应的通道，没有表头时这一行照常导入
+                    headerChecked = true;
+                    bool isHeader = parseHeader(p, lineEnd);
+                    if (m_columns.isEmpty()) {
+                        m_lastError = QObject::tr("表头中没有已配置的通道");
+                        ok = false;
+                    } else if (!isHeader) {
+                        ok = importLine(p, lineEnd, lineNumber);
+                    }
+                }
+            }
+            p = nl < end ? nl + 1 : end;
+        }
+
+        kept = int(end - p);
+        if (kept > 0)
+            memmove(buffer.data(), p, kept);
+        if (atEnd)
+            break;
+    }
+
+    if (ok)
+        storeInterval();
+    m_report.duplicates = m_storage->importDuplicates();
+    if (!m_storage->endImport() && ok) {
+        m_lastError = m_storage->lastError();
+        ok = false;
+    }
+    // 全部写完后再重新生成导入范围内已有的小时汇总，更新的时段由写入端之后生成
+    if (ok && m_report.samples > 0
+        && !m_storage->rebuildRollups(m_report.firstMs, m_report.lastMs + 1)) {
+        m_lastError = m_storage->lastError();
+        ok = false;
+    }
+    m_report.elapsedMs = timer.elapsed();
+    return ok;
+}
+
+bool CsvImporter::parseHeader(const char *begin, const char *end)
+{
+    // 分隔符：制表符优先，其次分号（这时逗号只可能是小数点），最后逗号
+    const char *tab = static_cast<const char *>(memchr(begin, '\t', end - begin));
+    const char *semicolon = static_cast<const char *>(memchr(begin, ';', end - begin));
+    m_delimiter = tab ? '\t' : (semicolon ? ';' : ',');
+
+    const char *fieldEnd = static_cast<const char *>(memchr(begin, m_delimiter, end - begin));
+    if (!fieldEnd)
+        fieldEnd = end;
+    const char *b = begin;
+    const char *e = fieldEnd;
+    trim(&b, &e);
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    qint64 ms;
+    if (parseTimestamp(b, e, &ms)) {
+        // 没有表头，按配置顺序
+        for (int c = 0; c < channels->count(); ++c)
+            m_columns.append(c);
+        return false;
+    }
+
+    const char *p = fieldEnd;
+    while (p < end) {
+        ++p;
+        const char *next = static_cast<const char *>(memchr(p, m_delimiter, end - p));
+        if (!next)
+            next = end;
+        b = p;
+        e = next;
+        trim(&b, &e);
+        QString key = QString::fromUtf8(b, int(e - b)).trimmed().toLower();
+        int c = channels->indexOf(key);
+        if (c < 0)
+            qWarning() << "CSV 导入: 忽略未配置的列" << key;
+        m_columns.append(c);
+        p = next;
+    }
+
+    bool any = false;
+    for (int i = 0; i < m_columns.size(); ++i)
+        any = any || m_columns.at(i) >= 0;
+    if (!any)
+        m_columns.clear();
+    return true;
+}
+
+bool CsvImporter::importLine(const char *begin, const char *end, qint64 lineNumber)
+{
+    ++m_report.lines;
+
+    const char *fieldEnd = static_cast<const char *>(memchr(begin, m_delimiter, end - begin));
+    if (!fieldEnd)
+        fieldEnd = end;
+    const char *b = begin;
+    const char *e = fieldEnd;
+    trim(&b, &e);
+
+    qint64 ms;
+    if (!parseTimestamp(b, e, &ms)) {
+        reject(lineNumber, "时间戳无法解析");
+        return true;
+    }
+
+    // 整行解析成功后才写入，被拒绝的行不留下半个采样
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    double values[SensorData::MAX_CHANNELS];
+    quint32 mask = 0;
+    const char *p = fieldEnd;
+    int column = 0;
+    while (p < end) {
+        ++p;
+        const char *next = static_cast<const char *>(memchr(p, m_delimiter, end - p));
+        if (!next)
+            next = end;
+        int c = column < m_columns.size() ? m_columns.at(column) : -1;
+        ++column;
+        if (c >= 0) {
+            b = p;
+            e = next;
+            trim(&b, &e);
+            if (b < e) {
+                double v;
+                if (!parseNumber(b, e, &v)) {
+                    reject(lineNumber, "读数无法解析");
+                    return true;
+                }
+                const ChannelInfo &info = channels->at(c);
+                if (v < info.minValue || v > info.maxValue) {
+                    reject(lineNumber, "读数超出通道范围");
+                    return true;
+                }
+                values[c] = v;
+                mask |= 1u << c;
+            }
+        }
+        p = next;
+    }
+    if (mask == 0) {
+        reject(lineNumber, "没有读数");
+        return true;
+    }
+
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!(mask & (1u << c)))
+            continue;
+        if (!m_storage->importValue(ms, c, values[c])) {
+            m_lastError = m_storage->lastError();
+            return false;
+        }
+        ++m_report.values;
+    }
+    ++m_report.samples;
+
+    if (m_report.samples == 1) {
+        m_report.firstMs = m_report.lastMs = ms;
+    } else {
+        m_report.firstMs = qMin(m_report.firstMs, ms);
+        m_report.lastMs = qMax(m_report.lastMs, ms);
+    }
+    qint64 delta = ms - m_previousMs;
+    if (m_previousMs > 0 && delta > 0 && delta <= kMsPerDay)
+        ++m_spacing[delta];
+    m_previousMs = ms;
+    return true;
+}
+
+bool CsvImporter::parseTimestamp(const char *begin, const char *end, qint64 *ms)
+{
+    if (begin >= end)
+        return false;
+
+    // 纯数字：Unix 时间
+    const char *p = begin;
+    while (p < end && isDigit(*p))
+        ++p;
+    if (p == end) {
+        if (end - begin > 15)
+            return false;
+        qint64 value = 0;
+        for (p = begin; p < end; ++p)
+            value = value * 10 + (*p - '0');
+        *ms = value > Q_INT64_C(100000000000) ? value : value * 1000;
+        return true;
+    }
+
+    p = begin;
+    int year, month, day, hour, minute, second = 0, millis = 0;
+    if (readInt(&p, end, 4, &year) != 4 || p >= end || (*p != '-' && *p != '/'))
+        return false;
+    char separator = *p++;
+    if (readInt(&p, end, 2, &month) == 0 || p >= end || *p++ != separator)
+        return false;
+    if (readInt(&p, end, 2, &day) == 0 || p >= end || (*p != ' ' && *p != 'T'))
+        return false;
+    ++p;
+    if (readInt(&p, end, 2, &hour) == 0 || p >= end || *p++ != ':')
+        return false;
+    if (readInt(&p, end, 2, &minute) != 2)
+        return false;
+    if (p < end && *p == ':') {
+        ++p;
+        if (readInt(&p, end, 2, &second) != 2)
+            return false;
+        if (p < end && (*p == '.' || *p == ',')) {
+            ++p;
+            int digits = readInt(&p, end, 3, &millis);
+            if (digits == 0)
+                return false;
+            for (; digits < 3; ++digits)
+                millis *= 10;
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+    }
+    if (p != end)
+        return false;
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)
+        || hour > 23 || minute > 59 || second > 59)
+        return false;
+
+    qint64 naive = daysFromCivil(year, month, day) * kMsPerDay
+                 + qint64(hour) * 3600000 + minute * 60000 + second * 1000 + millis;
+    *ms = naive + localOffsetMs(year, month, day, hour, naive);
+    return true;
+}
+
+// 本地时间与 UTC 的偏移按小时缓存；夏令时切换发生在整点，同一小时内偏移不变
+qint64 CsvImporter::localOffsetMs(int year, int month, int day, int hour, qint64 naiveMs)
+{
+    qint64 key = naiveMs / 3600000;
+    if (key != m_offsetKey) {
+        QDateTime local(QDate(year, month, day), QTime(hour, 0));
+        m_offsetMs = local.toMSecsSinceEpoch() - key * 3600000;
+        m_offsetKey = key;
+    }
+    return m_offsetMs;
+}
+
+void CsvImporter::reject(qint64 lineNumber, const char *reason)
+{
+    ++m_report.rejected;
+    if (m_report.rejected <= m_maxRejectLog)
+        qWarning() << "CSV 导入: 第" << lineNumber << "行被拒绝:" << reason;
+    else if (m_report.rejected == m_maxRejectLog + 1)
+        qWarning() << "CSV 导入: 后续被拒绝的行不再逐条列出";
+}
+
+// 取出现最多的采样间隔作为这段数据的采样周期；导入范围内已有周期记录时保持原样
+void CsvImporter::storeInterval()
+{
+    qint64 spacing = 0;
+    int best = 0;
+    for (QHash<qint64, int>::const_iterator it = m_spacing.constBegin();
+         it != m_spacing.constEnd(); ++it) {
+        if (it.value() > best) {
+            best = it.value();
+            spacing = it.key();
+        }
+    }
+    if (spacing <= 0)
+        return;
+
+    QDateTime first = QDateTime::fromMSecsSinceEpoch(m_report.firstMs);
+    QDateTime last = QDateTime::fromMSecsSinceEpoch(m_report.lastMs);
+    int before = m_storage->intervalAt(first.addMSecs(-1));
+    if (m_storage->intervalAt(last) != before || before == int(spacing))
+        return;
+    m_storage->storeIntervalChange(first, int(spacing));
+    if (before > 0)
+        m_storage->storeIntervalChange(last.addMSecs(1), before);
+}
@@ -0,0 +1,79 @@
+#ifndef CSVIMPORT_H
+#define CSVIMPORT_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include "sensordata.h"
+
+class SensorStorage;
+
+// 从旧记录仪导出的 CSV 批量导入历史数据
+//
+// 格式：每行一个采样，第一列时间戳，其余列为各通道的读数，空字段表示没有该通道的读数。
+// 第一行不是时间戳时作为表头，列名为通道 key（如 temperature,humidity），
+// 不在通道配置中的列忽略；没有表头时按配置中通道的顺序对应。
+// 分隔符按第一行自动识别：制表符、分号或逗号；分号分隔时读数可以用逗号作小数点。
+// 时间戳：yyyy-MM-dd hh:mm[:ss[.zzz]]（日期可用 / 分隔，日期时间之间可用 T），本地时间；
+// 或者纯数字的 Unix 时间（大于 1e11 时按毫秒，否则按秒）。
+//
+// 按大块读文件，在缓冲区中原地切分和解析，不为每行构造 QString 或 QDateTime：
+// 本地时间到 UTC 的偏移按小时缓存，只在跨小时时计算一次。
+// 写入走 SensorStorage::beginImport()，分批提交，每批持有写锁约 250 ms 以内；
+// 全部行写完后再推断采样周期，写入 sample_intervals，并重新生成导入范围内的小时汇总（见 SensorStorage::summarize()）。
+class CsvImporter
+{
+public:
+    struct Report {
+        qint64 lines;           // 数据行（不含表头和空行）
+        qint64 samples;         // 导入的采样
+        qint64 values;          // 写入的通道读数
+        qint64 duplicates;      // 数据库中已有而跳过的读数
+        qint64 rejected;        // 无法解析的行
+        qint64 elapsedMs;
+        qint64 bytes;
+        qint64 firstMs;
+        qint64 lastMs;
+
+        Report() : lines(0), samples(0), values(0), duplicates(0), rejected(0),
+                   elapsedMs(0), bytes(0), firstMs(0), lastMs(0) {}
+    };
+
+    explicit CsvImporter(SensorStorage *storage);
+
+    // 每多少个读数提交一次
+    void setCommitEvery(int values) { m_commitEvery = values; }
+    // 最多打印多少条被拒绝的行
+    void setMaxRejectLog(int lines) { m_maxRejectLog = lines; }
+
+    bool run(const QString &path);
+
+    const Report &report() const { return m_report; }
+    QString lastError() const { return m_lastError; }
+
+private:
+    // 识别分隔符和列，第一行是表头时返回 true
+    bool parseHeader(const char *begin, const char *end);
+    bool importLine(const char *begin, const char *end, qint64 lineNumber);
+    bool parseTimestamp(const char *begin, const char *end, qint64 *ms);
+    qint64 localOffsetMs(int year, int month, int day, int hour, qint64 naiveMs);
+    void reject(qint64 lineNumber, const char *reason);
+    void storeInterval();
+
+    SensorStorage *m_storage;
+    int m_commitEvery;
+    int m_maxRejectLog;
+    Report m_report;
+    QString m_lastError;
+
+    char m_delimiter;
+    QVector<int> m_columns;     // 第 i 个读数列对应的通道，-1 表示忽略
+
+    qint64 m_offsetKey;         // 本地时间偏移缓存：(日 * 24 + 时)
+    qint64 m_offsetMs;
+
+    qint64 m_previousMs;
+    QHash<qint64, int> m_spacing;  // 相邻采样间隔的出现次数，用于推断采样周期
+};
+
+#endif // CSVIMPORT_H
@@ -0,0 +1,163 @@
+#include "derivedchannels.h"
+#include "channelregistry.h"
+#include "metrics.h"
+#include <cmath>
+
+namespace DerivedChannels {
+
+// Magnus 公式（Sonntag 1990 的水面系数），-45~60°C 内误差约 0.35°C
+static const double kMagnusA = 17.62;
+static const double kMagnusB = 243.12;
+
+static double magnusGamma(double t, double rh)
+{
+    return std::log(rh / 100.0) + kMagnusA * t / (kMagnusB + t);
+}
+
+// 饱和水汽压，单位 hPa
+static double saturationPressure(double t)
+{
+    return 6.112 * std::exp(kMagnusA * t / (kMagnusB + t));
+}
+
+// 露点（°C）：输入温度（°C）、相对湿度（%）
+static bool dewPoint(const double *in, double *out)
+{
+    double t = in[0];
+    double rh = in[1];
+    if (rh <= 0.0 || rh > 100.0 || t <= -kMagnusB)
+        return false;
+    double gamma = magnusGamma(t, rh);
+    *out = kMagnusB * gamma / (kMagnusA - gamma);
+    return true;
+}
+
+// 体感温度（°C），美国国家气象局的算法：先用 Steadman 的简化式，
+// 结果在 80°F 以上时改用 Rothfusz 回归式并做低湿、高湿修正
+static bool heatIndex(const double *in, double *out)
+{
+    double t = in[0] * 9.0 / 5.0 + 32.0;
+    double rh = in[1];
+    if (rh < 0.0 || rh > 100.0)
+        return false;
+
+    double hi = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + rh * 0.094);
+    if ((hi + t) / 2.0 >= 80.0) {
+        hi = -42.379 + 2.04901523 * t + 10.14333127 * rh
+           - 0.22475541 * t * rh - 0.00683783 * t * t - 0.05481717 * rh * rh
+           + 0.00122874 * t * t * rh + 0.00085282 * t * rh * rh
+           - 0.00000199 * t * t * rh * rh;
+        if (rh < 13.0 && t >= 80.0 && t <= 112.0)
+            hi -= (13.0 - rh) / 4.0 * std::sqrt((17.0 - std::fabs(t - 95.0)) / 17.0);
+        else if (rh > 85.0 && t >= 80.0 && t <= 87.0)
+            hi += (rh - 85.0) / 10.0 * ((87.0 - t) / 5.0);
+    }
+    *out = (hi - 32.0) * 5.0 / 9.0;
+    return true;
+}
+
+// 绝对湿度（g/m³）：水汽分压 e（hPa）下 216.7 * e / T(K)
+static bool absoluteHumidity(const double *in, double *out)
+{
+    double t = in[0];
+    double rh = in[1];
+    if (rh < 0.0 || rh > 100.0 || t <= -kMagnusB)
+        return false;
+    *out = 216.7 * (rh / 100.0 * saturationPressure(t)) / (273.15 + t);
+    return true;
+}
+
+static const Formula kFormulas[] = {
+    { "dewpoint", "露点", "°C", "#2e8b57",
+      { "temperature", "humidity" }, 2, -60, 60, dewPoint },
+    { "heatindex", "体感温度", "°C", "#d2691e",
+      { "temperature", "humidity" }, 2, -40, 80, heatIndex },
+    { "absolutehumidity", "绝对湿度", "g/m³", "#4682b4",
+      { "temperature", "humidity" }, 2, 0, 200, absoluteHumidity }
+};
+
+int formulaCount()
+{
+    return int(sizeof(kFormulas) / sizeof(kFormulas[0]));
+}
+
+const Formula &formula(int index)
+{
+    return kFormulas[index];
+}
+
+int findFormula(const QString &key)
+{
+    for (int i = 0; i < formulaCount(); ++i) {
+        if (key == QLatin1String(kFormulas[i].key))
+            return i;
+    }
+    return -1;
+}
+
+static MetricCounter *computedCounter()
+{
+    static MetricCounter *m = MetricsRegistry::instance()->counter(
+        "smarthome_derived_values_total", "Derived channel values computed on demand.");
+    return m;
+}
+
+static int bitCount(quint32 mask)
+{
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        ++n;
+    return n;
+}
+
+static quint32 evaluateOne(SensorData *data, quint32 wanted)
+{
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 done = 0;
+    for (int c = 0; c < channels->count(); ++c) {
+        if (!(wanted & (1u << c)))
+            continue;
+        const ChannelInfo &info = channels->at(c);
+        double in[MAX_INPUTS];
+        bool complete = true;
+        for (int i = 0; i < info.inputs.size() && complete; ++i) {
+            int input = info.inputs.at(i);
+            complete = data->has(input);
+            if (complete)
+                in[i] = data->value(input);
+        }
+        double value;
+        if (complete && kFormulas[info.formula].compute(in, &value)) {
+            data->setValue(c, value);
+            done |= 1u << c;
+        }
+    }
+    return done;
+}
+
+quint32 evaluate(SensorData *data, quint32 wanted)
+{
+    wanted &= ChannelRegistry::instance()->derivedMask() & ~data->channelMask;
+    if (!wanted)
+        return 0;
+    quint32 done = evaluateOne(data, wanted);
+    computedCounter()->add(bitCount(done));
+    return done;
+}
+
+void evaluate(QList<SensorData> *samples, quint32 wanted)
+{
+    wanted &= ChannelRegistry::instance()->derivedMask();
+    if (!wanted)
+        return;
+    int computed = 0;
+    for (int i = 0; i < samples->size(); ++i) {
+        SensorData &data = (*samples)[i];
+        quint32 missing = wanted & ~data.channelMask;
+        if (missing)
+            computed += bitCount(evaluateOne(&data, missing));
+    }
+    computedCounter()->add(computed);
+}
+
+} // namespace DerivedChannels
@@ -0,0 +1,43 @@
+#ifndef DERIVEDCHANNELS_H
+#define DERIVEDCHANNELS_H
+
+#include <QString>
+#include <QList>
+#include "sensordata.h"
+
+// 派生通道：由基础通道按公式算出的量（露点、体感温度、绝对湿度）
+//
+// 公式是输入通道值的纯函数，登记在 derivedchannels.cpp 的公式表中。启用的派生通道
+// 排在 ChannelRegistry 的基础通道之后（ChannelInfo::formula >= 0），但采集线程不产生它们，
+// 默认也不写入数据库：图表、历史表格、统计和报警真正用到时才计算。
+// 算过的值随查询缓存的日块（HistoryBlock）和热层的封闭段保存，同一时段不重复计算；
+// 写入端生成小时汇总时一起算出它们的统计（derived_rollups，见 SensorStorage::summarize()）。channels/<key>/persist=true 时写入端在写库前算出并保存，
+// 之后和普通通道一样从数据库读出。
+namespace DerivedChannels {
+    enum { MAX_INPUTS = 2 };
+
+    struct Formula {
+        const char *key;
+        const char *name;               // 显示名称，在 ChannelRegistry 上下文中翻译
+        const char *unit;
+        const char *color;
+        const char *inputs[MAX_INPUTS]; // 输入通道的 key，必须是基础通道
+        int inputCount;
+        double minValue;
+        double maxValue;
+        // 输入超出公式的适用范围时返回 false
+        bool (*compute)(const double *inputs, double *out);
+    };
+
+    int formulaCount();
+    const Formula &formula(int index);
+    // 没有时返回 -1
+    int findFormula(const QString &key);
+
+    // 计算 wanted 中 data 还没有值的派生通道；已有的值（例如从数据库读出的）不覆盖，
+    // 输入不全或超出适用范围的跳过。返回算出的通道
+    quint32 evaluate(SensorData *data, quint32 wanted);
+    void evaluate(QList<SensorData> *samples, quint32 wanted);
+}
+
+#endif // DERIVEDCHANNELS_H
@@ -0,0 +1,206 @@
+#include "historycache.h"
+#include "metrics.h"
+#include "derivedchannels.h"
+#include "memorybudget.h"
+#include <cmath>
+
+// ============== ChannelAggregate ==============
+
+void ChannelAggregate::add(double value)
+{
+    if (count == 0) {
+        min = max = value;
+    } else {
+        min = qMin(min, value);
+        max = qMax(max, value);
+    }
+    ++count;
+    sum += value;
+    sumSquares += value * value;
+}
+
+void ChannelAggregate::merge(const ChannelAggregate &other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    count += other.count;
+    min = qMin(min, other.min);
+    max = qMax(max, other.max);
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+}
+
+double ChannelAggregate::stdDev() const
+{
+    if (count < 2)
+        return 0.0;
+    double m = sum / count;
+    double variance = sumSquares / count - m * m;
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+// ============== HistoryBlock ==============
+
+HistoryBlock::HistoryBlock()
+    : cursor(0)
+    , closed(false)
+    , m_derived(0)
+{
+}
+
+void HistoryBlock::append(const SensorData &data)
+{
+    if (m_derived & ~data.channelMask) {
+        SensorData derived = data;
+        DerivedChannels::evaluate(&derived, m_derived);
+        appendValues(derived);
+    } else {
+        appendValues(data);
+    }
+}
+
+void HistoryBlock::appendValues(const SensorData &data)
+{
+    m_timestamps.append(data.timestamp.toMSecsSinceEpoch());
+    m_masks.append(data.channelMask);
+    m_offsets.append(m_values.size());
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!data.has(c))
+            continue;
+        m_values.append(data.value(c));
+        m_raw.append(data.rawValue(c));
+        m_aggregates[c].add(data.value(c));
+    }
+}
+
+SensorData HistoryBlock::at(int index) const
+{
+    SensorData data;
+    data.timestamp = QDateTime::fromMSecsSinceEpoch(m_timestamps.at(index));
+    quint32 mask = m_masks.at(index);
+    int offset = m_offsets.at(index);
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (mask & (1u << c)) {
+            data.setValue(c, m_values.at(offset), m_raw.at(offset));
+            ++offset;
+        }
+    }
+    return data;
+}
+
+void HistoryBlock::appendTo(QList<SensorData> *out, bool newestFirst) const
+{
+    int n = m_timestamps.size();
+    out->reserve(out->size() + n);
+    for (int i = 0; i < n; ++i)
+        out->append(at(newestFirst ? n - 1 - i : i));
+}
+
+bool HistoryBlock::derive(quint32 derived)
+{
+    derived &= ~m_derived;
+    if (!derived)
+        return false;
+
+    // 逐个采样展开、计算后重新排列，块的紧凑布局不变
+    HistoryBlock rebuilt;
+    int n = m_timestamps.size();
+    rebuilt.m_timestamps.reserve(n);
+    rebuilt.m_masks.reserve(n);
+    rebuilt.m_offsets.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        SensorData data = at(i);
+        DerivedChannels::evaluate(&data, derived);
+        rebuilt.appendValues(data);
+    }
+    m_timestamps = rebuilt.m_timestamps;
+    m_masks = rebuilt.m_masks;
+    m_offsets = rebuilt.m_offsets;
+    m_values = rebuilt.m_values;
+    m_raw = rebuilt.m_raw;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_aggregates[c] = rebuilt.m_aggregates[c];
+    m_derived |= derived;
+    return true;
+}
+
+int HistoryBlock::costBytes() const
+{
+    return int(sizeof(HistoryBlock))
+         + m_timestamps.size() * int(sizeof(qint64) + sizeof(quint32) + sizeof(int))
+         + m_values.size() * int(2 * sizeof(double));
+}
+
+// ============== HistoryCache ==============
+
+HistoryCache::HistoryCache(int budgetBytes)
+    : m_blocks(qMax(0, budgetBytes))
+    , m_hits(0)
+    , m_misses(0)
+{
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_hitCounter = registry->counter("smarthome_history_cache_hits_total",
+                                     "History day blocks served from memory.");
+    m_missCounter = registry->counter("smarthome_history_cache_misses_total",
+                                      "History day blocks loaded from the database.");
+    m_bytesGauge = registry->gauge("smarthome_history_cache_bytes",
+                                   "Memory used by cached history blocks.");
+    m_account = MemoryBudget::instance()->account("history_cache", MemoryAccount::Cache,
+                                                  qMax(0, budgetBytes));
+    applyMemoryLimit();
+}
+
+HistoryBlock *HistoryCache::find(const QDate &day)
+{
+    HistoryBlock *block = m_blocks.object(day.toJulianDay());
+    if (block) {
+        ++m_hits;
+        m_hitCounter->inc();
+    } else {
+        ++m_misses;
+        m_missCounter->inc();
+    }
+    return block;
+}
+
+bool HistoryCache::insert(const QDate &day, HistoryBlock *block)
+{
+    bool ok = m_blocks.insert(day.toJulianDay(), block, block->costBytes());
+    updateGauge();
+    return ok;
+}
+
+HistoryBlock *HistoryCache::take(const QDate &day)
+{
+    HistoryBlock *block = m_blocks.take(day.toJulianDay());
+    updateGauge();
+    return block;
+}
+
+void HistoryCache::clear()
+{
+    m_blocks.clear();
+    updateGauge();
+}
+
+double HistoryCache::hitRate() const
+{
+    quint64 total = m_hits + m_misses;
+    return total > 0 ? double(m_hits) / total : 0.0;
+}
+
+void HistoryCache::applyMemoryLimit()
+{
+    m_blocks.setMaxCost(qMin(m_account->budget(), m_account->limit()));
+    updateGauge();
+}
+
+void HistoryCache::updateGauge()
+{
+    m_bytesGauge->set(m_blocks.totalCost());
+    m_account->setUsage(m_blocks.totalCost());
+}
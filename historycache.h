@@ -0,0 +1,106 @@
+#ifndef HISTORYCACHE_H
+#define HISTORYCACHE_H
+
+#include <QCache>
+#include <QDate>
+#include <QList>
+#include <QVector>
+#include "sensordata.h"
+
+class MetricCounter;
+class MetricGauge;
+class MemoryAccount;
+
+// 单个通道的汇总值，可以逐个合并
+struct ChannelAggregate {
+    int count;
+    double min;
+    double max;
+    double sum;
+    double sumSquares;
+
+    ChannelAggregate() : count(0), min(0), max(0), sum(0), sumSquares(0) {}
+
+    void add(double value);
+    void merge(const ChannelAggregate &other);
+    double mean() const { return count > 0 ? sum / count : 0.0; }
+    double stdDev() const;
+};
+
+// 一天的查询结果，按时间升序，列式紧凑存放：
+// 每个采样只存实际有的通道，2 个通道约 48 字节（SensorData 本身约 200 字节）
+class HistoryBlock
+{
+public:
+    HistoryBlock();
+
+    void append(const SensorData &data);
+    int count() const { return m_timestamps.size(); }
+    bool isEmpty() const { return m_timestamps.isEmpty(); }
+    qint64 lastTimestamp() const { return m_timestamps.isEmpty() ? 0 : m_timestamps.last(); }
+
+    // 追加到 out，newestFirst 时按时间倒序
+    void appendTo(QList<SensorData> *out, bool newestFirst) const;
+
+    // 算出 derived 中还没有算过的派生通道（见 derivedchannels.h）并保存在块中，
+    // 之后追加的采样同样计算；返回块的内容是否变化
+    bool derive(quint32 derived);
+
+    const ChannelAggregate &aggregate(int channel) const { return m_aggregates[channel]; }
+    int costBytes() const;
+
+    qint64 cursor;   // 加载时存储的游标，未封闭的块据此补上新写入的记录
+    bool closed;     // 数据库中已有当天之后的采样，内容不再变化（见 SensorStorage::loadDay()）
+
+private:
+    SensorData at(int index) const;
+    void appendValues(const SensorData &data);
+
+    QVector<qint64> m_timestamps;
+    QVector<quint32> m_masks;
+    QVector<int> m_offsets;     // 第 i 个采样的值在 m_values 中的起始位置
+    QVector<double> m_values;
+    QVector<double> m_raw;
+    ChannelAggregate m_aggregates[SensorData::MAX_CHANNELS];
+    quint32 m_derived;          // 已经算过的派生通道
+};
+
+// 历史查询结果缓存
+//
+// 按天分块，LRU 淘汰，总大小不超过预算。已经结束的日子不再变化，
+// 块一直有效直到被淘汰；当天（未封闭）的块在使用时只补上之后新写入的记录。
+// 单个块超过预算时不缓存。用量记在内存账户 history_cache 上（见 memorybudget.h），
+// 内存压力升高时按账户的 limit() 淘汰。只在界面线程中使用。
+class HistoryCache
+{
+public:
+    explicit HistoryCache(int budgetBytes);
+
+    // 取出缓存的块，不存在时返回 0；块的所有权仍归缓存
+    HistoryBlock *find(const QDate &day);
+    // 放入（或在内容变化后重新放入）一个块，所有权转给缓存；超过预算时块被删除，返回 false
+    bool insert(const QDate &day, HistoryBlock *block);
+    // 取回块的所有权，用于修改后重新 insert()
+    HistoryBlock *take(const QDate &day);
+    void clear();
+
+    // 按内存账户当前的上限淘汰（压力变化时调用），压力解除后恢复到预算
+    void applyMemoryLimit();
+
+    quint64 hits() const { return m_hits; }
+    quint64 misses() const { return m_misses; }
+    double hitRate() const;
+
+private:
+    void updateGauge();
+
+    QCache<qint64, HistoryBlock> m_blocks;   // 键为儒略日
+    quint64 m_hits;
+    quint64 m_misses;
+    MetricCounter *m_hitCounter;
+    MetricCounter *m_missCounter;
+    MetricGauge *m_bytesGauge;
+    MemoryAccount *m_account;
+};
+
+#endif // HISTORYCACHE_H
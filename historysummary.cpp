@@ -0,0 +1,126 @@
+#include "historysummary.h"
+#include "channelregistry.h"
+#include <QVector>
+#include <cmath>
+
+// ============== ChannelSummary ==============
+
+double ChannelSummary::mean() const
+{
+    if (durationMs > 0)
+        return weightedSum / durationMs;
+    return count > 0 ? (min + max) / 2 : 0.0;
+}
+
+double ChannelSummary::stdDev() const
+{
+    if (durationMs <= 0)
+        return 0.0;
+    double m = weightedSum / durationMs;
+    double variance = weightedSquares / durationMs - m * m;
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+void ChannelSummary::include(double value)
+{
+    if (!hasData()) {
+        min = max = value;
+    } else {
+        min = qMin(min, value);
+        max = qMax(max, value);
+    }
+}
+
+void ChannelSummary::merge(const ChannelSummary &other)
+{
+    if (!other.hasData())
+        return;
+    if (!hasData()) {
+        *this = other;
+        return;
+    }
+    count += other.count;
+    min = qMin(min, other.min);
+    max = qMax(max, other.max);
+    durationMs += other.durationMs;
+    weightedSum += other.weightedSum;
+    weightedSquares += other.weightedSquares;
+    aboveMs += other.aboveMs;
+    belowMs += other.belowMs;
+}
+
+void SummaryBucket::merge(const SummaryBucket &other)
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        channels[c].merge(other.channels[c]);
+}
+
+// ============== 阶梯积分 ==============
+
+static inline qint64 floorTo(qint64 ms, qint64 step)
+{
+    qint64 q = ms / step;
+    if (ms % step < 0)
+        --q;
+    return q * step;
+}
+
+void integrateSteps(const QList<SensorData> &samples, qint64 from, qint64 to,
+                    qint64 bucketMs, qint64 maxGapMs, QMap<qint64, SummaryBucket> *buckets)
+{
+    QVector<qint64> times(samples.size());
+    for (int i = 0; i < samples.size(); ++i)
+        times[i] = samples.at(i).timestamp.toMSecsSinceEpoch();
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        bool alarm = c < channels->count() && channels->at(c).alarmEnabled;
+        double low = alarm ? channels->at(c).alarmMin : 0.0;
+        double high = alarm ? channels->at(c).alarmMax : 0.0;
+
+        int i = 0;
+        while (i < samples.size() && !samples.at(i).has(c))
+            ++i;
+        while (i < samples.size()) {
+            int j = i + 1;
+            while (j < samples.size() && !samples.at(j).has(c))
+                ++j;
+
+            qint64 t = times.at(i);
+            double v = samples.at(i).value(c);
+            qint64 holdEnd = t + maxGapMs;
+            if (j < samples.size())
+                holdEnd = qMin(holdEnd, times.at(j));
+
+            if (t >= from && t < to) {
+                qint64 key = floorTo(t, bucketMs);
+                SummaryBucket &bucket = (*buckets)[key];
+                bucket.startMs = key;
+                bucket.channels[c].include(v);
+                ++bucket.channels[c].count;
+            }
+
+            // 保持时间按桶切开
+            qint64 s = qMax(t, from);
+            qint64 e = qMin(holdEnd, to);
+            while (s < e) {
+                qint64 key = floorTo(s, bucketMs);
+                qint64 spanEnd = qMin(e, key + bucketMs);
+                qint64 span = spanEnd - s;
+                SummaryBucket &bucket = (*buckets)[key];
+                bucket.startMs = key;
+                ChannelSummary &summary = bucket.channels[c];
+                summary.include(v);
+                summary.durationMs += span;
+                summary.weightedSum += v * span;
+                summary.weightedSquares += v * v * span;
+                if (alarm && v > high)
+                    summary.aboveMs += span;
+                if (alarm && v < low)
+                    summary.belowMs += span;
+                s = spanEnd;
+            }
+            i = j;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef HISTORYSUMMARY_H
+#define HISTORYSUMMARY_H
+
+#include <QList>
+#include <QMap>
+#include "sensordata.h"
+
+// 一段时间内一个通道的统计
+//
+// 存储的序列按阶梯看待：每个值保持到同一通道的下一条记录，最多保持 maxGap
+// （死区策略下未写入的采样都在上一次写入值的死区内，超过 maxGap 没有记录视为中断）。
+// 平均值、标准差和超限时长都按保持时间加权，不受死区稀疏写入的影响；
+// 最小、最大值包括从上一段保持进来的值。
+struct ChannelSummary {
+    int count;              // 这段时间内的记录数
+    double min;
+    double max;
+    qint64 durationMs;      // 有数据的时长
+    double weightedSum;     // Σ 值 × 保持时长（毫秒）
+    double weightedSquares;
+    qint64 aboveMs;         // 高于报警上限的时长（通道未启用报警时为 0）
+    qint64 belowMs;
+
+    ChannelSummary()
+        : count(0), min(0), max(0), durationMs(0), weightedSum(0), weightedSquares(0),
+          aboveMs(0), belowMs(0) {}
+
+    bool hasData() const { return count > 0 || durationMs > 0; }
+    double mean() const;
+    double stdDev() const;
+
+    void include(double value);
+    void merge(const ChannelSummary &other);
+};
+
+// 一个时间桶（小时或天）内各通道的统计，下标为 ChannelRegistry 中的位置
+struct SummaryBucket {
+    qint64 startMs;
+    ChannelSummary channels[SensorData::MAX_CHANNELS];
+
+    SummaryBucket() : startMs(0) {}
+    void merge(const SummaryBucket &other);
+};
+
+// samples 按时间升序，其中应包含 from 之前 maxGapMs 内和 to 之后的记录，
+// 以便确定跨过边界的保持时长。把阶梯序列在 [from, to) 内按 bucketMs（UTC 对齐）切开积分，
+// 累加到 buckets（键为桶起点）。报警阈值取自 ChannelRegistry。
+void integrateSteps(const QList<SensorData> &samples, qint64 from, qint64 to,
+                    qint64 bucketMs, qint64 maxGapMs, QMap<qint64, SummaryBucket> *buckets);
+
+#endif // HISTORYSUMMARY_H
@@ -0,0 +1,242 @@
+#include "hottier.h"
+#include "metrics.h"
+#include "channelregistry.h"
+#include "derivedchannels.h"
+#include "memorybudget.h"
+
+HotTier::HotTier(int windowHours, int maxBytes, QObject *parent)
+    : QObject(parent)
+    , m_windowMs(qint64(qMax(1, windowHours)) * 3600 * 1000)
+    , m_maxBytes(qMax(64 * 1024, maxBytes))
+    , m_sealedBytes(0)
+    , m_sealedCount(0)
+    , m_openStart(-1)
+    , m_openEnd(-1)
+    , m_openCount(0)
+    , m_coveredFrom(Q_INT64_C(0x7fffffffffffffff))
+    , m_hasHeld(false)
+{
+    // 窗口分成约 48 段，淘汰以段为单位
+    m_segmentMs = qMax(qint64(60 * 1000), m_windowMs / 48);
+
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_bytesGauge = registry->gauge("smarthome_hot_tier_bytes",
+                                   "Memory used by the in-memory hot tier.");
+    m_samplesGauge = registry->gauge("smarthome_hot_tier_samples",
+                                     "Samples held in the in-memory hot tier.");
+    m_evicted = registry->counter("smarthome_hot_tier_evicted_segments_total",
+                                  "Hot tier segments dropped by age or memory limit.");
+    m_account = MemoryBudget::instance()->account("hot_tier", MemoryAccount::Cache, m_maxBytes);
+}
+
+int HotTier::maxBytes() const
+{
+    return qMin(m_maxBytes, m_account->limit());
+}
+
+void HotTier::applyMemoryLimit()
+{
+    // m_openEnd 在封闭之后仍是最新采样的时间
+    evict(m_openEnd);
+    updateMetrics();
+}
+
+int HotTier::openBytes() const
+{
+    if (m_openStart < 0)
+        return 0;
+    int bytes = 0;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (m_open[c].count() > 0)
+            bytes += m_open[c].sizeBytes();
+    }
+    return bytes;
+}
+
+int HotTier::sizeBytes() const
+{
+    return m_sealedBytes + openBytes();
+}
+
+int HotTier::sampleCount() const
+{
+    return m_sealedCount + m_openCount;
+}
+
+void HotTier::append(const SensorDataList &samples)
+{
+    if (samples.isEmpty())
+        return;
+    for (int i = 0; i < samples.size(); ++i) {
+        const SensorData &data = samples.at(i);
+        if (!m_hasHeld || m_persist.differs(m_held, data)) {
+            m_held = data;
+            m_hasHeld = true;
+            appendOne(data);
+        } else {
+            SensorData held = m_held;
+            held.timestamp = data.timestamp;
+            appendOne(held);
+        }
+    }
+    evict(m_openEnd);
+    updateMetrics();
+}
+
+void HotTier::appendOne(const SensorData &data)
+{
+    qint64 ts = data.timestamp.toMSecsSinceEpoch();
+
+    // 段按时长封闭；上限很小时按大小提前封闭，保证总有可以淘汰的段
+    if (m_openStart >= 0
+        && (ts - m_openStart >= m_segmentMs || openBytes() >= m_maxBytes / 8))
+        seal();
+
+    if (m_openStart < 0) {
+        const ChannelRegistry *channels = ChannelRegistry::instance();
+        for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+            m_open[c].clear();
+            if (c < channels->count())
+                m_open[c].setDecimals(channels->at(c).storageDecimals);
+        }
+        m_openStart = ts;
+        m_openEnd = ts;
+        m_openCount = 0;
+        if (m_coveredFrom > ts)
+            m_coveredFrom = ts;
+    }
+
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (data.has(c))
+            m_open[c].append(ts, data.value(c), data.rawValue(c));
+    }
+    m_openEnd = qMax(m_openEnd, ts);
+    ++m_openCount;
+}
+
+void HotTier::seal()
+{
+    Segment segment;
+    segment.start = m_openStart;
+    segment.end = m_openEnd;
+    segment.count = m_openCount;
+    segment.bytes = int(sizeof(Segment));
+    segment.derived = 0;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (m_open[c].count() > 0) {
+            segment.chunks[c] = m_open[c].data();
+            segment.bytes += segment.chunks[c].size();
+        }
+        m_open[c].clear();
+    }
+    m_sealed.append(segment);
+    m_sealedBytes += segment.bytes;
+    m_sealedCount += segment.count;
+    m_openStart = -1;
+    m_openCount = 0;
+}
+
+void HotTier::evict(qint64 newest)
+{
+    while (!m_sealed.isEmpty()
+           && (m_sealed.first().end < newest - m_windowMs || sizeBytes() > maxBytes())) {
+        const Segment &oldest = m_sealed.first();
+        m_sealedBytes -= oldest.bytes;
+        m_sealedCount -= oldest.count;
+        m_coveredFrom = oldest.end + 1;
+        m_sealed.removeFirst();
+        m_evicted->inc();
+    }
+}
+
+void HotTier::decode(const QByteArray &chunk, int channel, qint64 from, qint64 to,
+                     QMap<qint64, SensorData> *merged) const
+{
+    ChunkDecoder decoder(chunk);
+    qint64 ts;
+    double value, raw;
+    while (decoder.next(&ts, &value, &raw)) {
+        if (ts < from || ts >= to)
+            continue;
+        SensorData &data = (*merged)[ts];
+        if (data.isEmpty())
+            data.timestamp = QDateTime::fromMSecsSinceEpoch(ts);
+        data.setValue(channel, value, raw);
+    }
+}
+
+void HotTier::derive(Segment *segment, quint32 derived)
+{
+    QMap<qint64, SensorData> merged;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!segment->chunks[c].isEmpty())
+            decode(segment->chunks[c], c, segment->start, segment->end + 1, &merged);
+    }
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    ChunkEncoder encoders[SensorData::MAX_CHANNELS];
+    for (int c = 0; c < channels->count(); ++c)
+        encoders[c].setDecimals(channels->at(c).storageDecimals);
+    for (QMap<qint64, SensorData>::iterator it = merged.begin(); it != merged.end(); ++it) {
+        quint32 done = DerivedChannels::evaluate(&it.value(), derived);
+        for (int c = 0; c < channels->count(); ++c) {
+            if (done & (1u << c))
+                encoders[c].append(it.key(), it.value().value(c), it.value().value(c));
+        }
+    }
+
+    for (int c = 0; c < channels->count(); ++c) {
+        if (encoders[c].count() > 0) {
+            segment->chunks[c] = encoders[c].data();
+            segment->bytes += segment->chunks[c].size();
+            m_sealedBytes += segment->chunks[c].size();
+        }
+    }
+    segment->derived |= derived;
+}
+
+void HotTier::query(qint64 from, qint64 to, QList<SensorData> *out, quint32 derived)
+{
+    derived &= ChannelRegistry::instance()->derivedMask();
+
+    // 各段时间上不重叠，逐段合并各通道后按顺序输出
+    QMap<qint64, SensorData> merged;
+    for (int i = 0; i < m_sealed.size(); ++i) {
+        Segment &segment = m_sealed[i];
+        if (segment.end < from || segment.start >= to)
+            continue;
+        if (derived & ~segment.derived)
+            derive(&segment, derived & ~segment.derived);
+        for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+            if (!segment.chunks[c].isEmpty())
+                decode(segment.chunks[c], c, from, to, &merged);
+        }
+        for (QMap<qint64, SensorData>::const_iterator it = merged.constBegin();
+             it != merged.constEnd(); ++it)
+            out->append(it.value());
+        merged.clear();
+    }
+
+    // 未封闭的段还在变化，每次现算
+    if (m_openStart >= 0 && m_openEnd >= from && m_openStart < to) {
+        for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+            if (m_open[c].count() > 0)
+                decode(m_open[c].data(), c, from, to, &merged);
+        }
+        for (QMap<qint64, SensorData>::iterator it = merged.begin(); it != merged.end(); ++it) {
+            if (derived)
+                DerivedChannels::evaluate(&it.value(), derived);
+            out->append(it.value());
+        }
+    }
+    // 算出的派生通道也计入用量，超出上限时同样淘汰旧段
+    evict(m_openEnd);
+    updateMetrics();
+}
+
+void HotTier::updateMetrics()
+{
+    m_bytesGauge->set(sizeBytes());
+    m_account->setUsage(sizeBytes());
+    m_samplesGauge->set(sampleCount());
+}
@@ -0,0 +1,99 @@
+#ifndef HOTTIER_H
+#define HOTTIER_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QByteArray>
+#include "sensordata.h"
+#include "chunkcodec.h"
+#include "persistencepolicy.h"
+
+class MetricGauge;
+class MetricCounter;
+class MemoryAccount;
+
+// 最近一段时间采样的内存热层
+//
+// 直接订阅采样总线，不等数据库写入；按时间分段，每段每个通道一个压缩块（见 chunkcodec.h），
+// 1 秒一个采样时 24 小时两个通道约 200~400 KB。段写满（时长或大小）后封闭，
+// 超出时间窗口或内存上限时丢弃最旧的段。窗口和上限在构造时确定，之后不变；
+// 用量记在内存账户 hot_tier 上，内存压力升高时上限临时降到账户的 limit()。
+//
+// coveredFrom() 之后的采样都在热层中（总线丢弃的除外），查询最近的范围不访问数据库；
+// 更早的部分由调用者到持久存储中取（见 SensorStorage::setHotTier()）。
+// 设置了写库的持久化策略时按同样的死区保存：不会写库的采样保存为上一个写库值的保持值，
+// 和数据库中按阶梯补出的历史（SensorStorage::expandSteps()）一致，热层和数据库的分界处看不出差别。
+// 只在界面进程中创建，只在所在线程中使用。
+class HotTier : public QObject
+{
+    Q_OBJECT
+public:
+    HotTier(int windowHours, int maxBytes, QObject *parent = 0);
+
+    // 热层完整覆盖的起始时间（毫秒），还没有采样时返回 qint64 最大值
+    qint64 coveredFrom() const { return m_coveredFrom; }
+
+    // 按时间升序追加 from <= 时间戳 < to 的采样，并算出其中的派生通道 derived
+    // （见 derivedchannels.h）；封闭段算过的派生通道压缩后留在段中，下次直接解码
+    void query(qint64 from, qint64 to, QList<SensorData> *out, quint32 derived = 0);
+
+    int sizeBytes() const;
+    int sampleCount() const;
+
+    // 按内存账户当前的上限丢弃旧段（压力变化时调用）
+    void applyMemoryLimit();
+
+    // 写库的死区策略，第一个采样之前设置
+    void setPersistencePolicy(const PersistencePolicy &policy) { m_persist = policy; }
+
+public slots:
+    // 采样总线的订阅槽
+    void append(const SensorDataList &samples);
+
+private:
+    struct Segment {
+        qint64 start;
+        qint64 end;         // 最后一个采样的时间戳
+        int count;
+        int bytes;
+        QByteArray chunks[SensorData::MAX_CHANNELS];
+        quint32 derived;    // 已经算过的派生通道
+    };
+
+    void appendOne(const SensorData &data);
+    void seal();
+    void evict(qint64 newest);
+    int openBytes() const;
+    void decode(const QByteArray &chunk, int channel, qint64 from, qint64 to,
+                QMap<qint64, SensorData> *merged) const;
+    void derive(Segment *segment, quint32 derived);
+    void updateMetrics();
+    int maxBytes() const;
+
+    qint64 m_windowMs;
+    int m_maxBytes;
+    qint64 m_segmentMs;
+
+    QList<Segment> m_sealed;        // 旧的在前
+    int m_sealedBytes;
+    int m_sealedCount;
+
+    ChunkEncoder m_open[SensorData::MAX_CHANNELS];
+    qint64 m_openStart;             // -1 表示当前没有未封闭的段
+    qint64 m_openEnd;
+    int m_openCount;
+
+    qint64 m_coveredFrom;
+
+    PersistencePolicy m_persist;
+    bool m_hasHeld;
+    SensorData m_held;              // 按死区最后一个会写库的采样
+
+    MetricGauge *m_bytesGauge;
+    MetricGauge *m_samplesGauge;
+    MetricCounter *m_evicted;
+    MemoryAccount *m_account;
+};
+
+#endif // HOTTIER_H
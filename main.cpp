@@ -1,23 +1,332 @@
 #include <QApplication>
+#include <QCoreApplication>
 #include <QTextCodec>
+#include <QStringList>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
 #include "mainwindow.h"
+#include "monitorcore.h"
+#include "metricsserver.h"
+#include "appsettings.h"
+#include "startupprofiler.h"
+#include "channelregistry.h"
+#include "sensorstorage.h"
+#include "csvimport.h"
+#include "syntheticload.h"
+#include "memorybudget.h"
+#include "trendpredictor.h"
+#include "signalwatcher.h"
+#include <signal.h>
 
-int main(int argc, char *argv[])
+// 命令行参数
+//   --headless, -d  无界面守护进程：只采集、报警和存储
+//   --attach        界面附加到守护进程的数据库，不自己采集
+//   --import <csv>  把旧记录仪导出的 CSV 批量导入数据库后退出（格式见 csvimport.h）
+//   --load-test     同时加上合成的界面和数据库负载，核对采样抖动（见 syntheticload.h）
+//   --predict-eval <yyyy-MM-dd>[,<yyyy-MM-dd>]
+//                   用数据库中这几天的记录回放趋势预警，报告提前量和误报率后退出
+//   --replay <yyyy-MM-dd>[,<yyyy-MM-dd>] [--speed <倍速>]
+//                   把这几天的记录按倍速重新走一遍图表、报警和写库（见 replay.h），
+//                   写入 replay/dbPath 的临时数据库，结束后报告各环节的情况；可以和 --headless 一起用
+static bool hasArg(int argc, char *argv[], const char *longName, const char *shortName = 0)
 {
-    QApplication app(argc, argv);
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], longName) == 0) return true;
+        if (shortName && qstrcmp(argv[i], shortName) == 0) return true;
+    }
+    return false;
+}
+
+static const char *argValue(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (qstrcmp(argv[i], name) == 0)
+            return argv[i + 1];
+    }
+    return 0;
+}
 
+static void setupCodecs()
+{
     // 设置中文编码支持
     QTextCodec::setCodecForTr(QTextCodec::codecForName("UTF-8"));
     QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+}
+
+// 本地指标导出。默认的 metrics/socket 属于采集进程（守护进程或独立运行的界面）；
+// 回放用自己的套接字，附加到守护进程的界面只在配置了 metrics/attachSocket 时导出
+static void startMetrics(MetricsServer *server, MonitorCore::Mode mode)
+{
+    QSettings &settings = appSettings();
+    QString path;
+    if (mode == MonitorCore::REPLAY)
+        path = settings.value("replay/metricsSocket", "/tmp/smarthome-replay-metrics.sock").toString();
+    else if (mode == MonitorCore::ATTACH)
+        path = settings.value("metrics/attachSocket").toString();
+    else
+        path = settings.value("metrics/socket", "/tmp/smarthome-metrics.sock").toString();
+    if (!path.isEmpty())
+        server->listen(path);
+}
+
+static void startSyntheticLoad(int argc, char *argv[], SyntheticLoad *load)
+{
+    if (!hasArg(argc, argv, "--load-test"))
+        return;
+    QSettings &settings = appSettings();
+    load->start(settings.value("loadtest/cpuPercent", 50).toInt(),
+                settings.value("loadtest/dbRows", 2000).toInt(),
+                settings.value("loadtest/dbPath", "/tmp/smarthome-loadtest.db").toString());
+}
+
+// SIGTERM/SIGINT 退出事件循环，按正常路径排空并关闭数据库
+static void watchTermination(SignalWatcher *watcher, QCoreApplication *app)
+{
+    watcher->watch(SIGTERM);
+    watcher->watch(SIGINT);
+    QObject::connect(watcher, SIGNAL(received(int)), app, SLOT(quit()));
+}
+
+static QString databasePath()
+{
+    return appSettings().value("storage/path", "sensor_data.db").toString();
+}
+
+// yyyy-MM-dd 或 yyyy-MM-dd,yyyy-MM-dd
+static bool parseDateRange(const char *text, QDate *from, QDate *to)
+{
+    QStringList dates = QString::fromLocal8Bit(text).split(',');
+    *from = QDate::fromString(dates.first(), "yyyy-MM-dd");
+    *to = dates.size() > 1 ? QDate::fromString(dates.at(1), "yyyy-MM-dd") : *from;
+    return from->isValid() && to->isValid() && *from <= *to;
+}
+
+// 回放的源数据库是 storage/path；写入 replay/dbPath（默认 /tmp/smarthome-replay.db），
+// 每次回放前删除，结果可以重复。倍速为 --speed 或 replay/speed（默认 100），0 表示不等待
+static bool setupReplay(int argc, char *argv[], MonitorCore *core, QString *dbPath)
+{
+    const char *range = argValue(argc, argv, "--replay");
+    QDate from, to;
+    if (!parseDateRange(range, &from, &to)) {
+        qWarning() << "回放: 日期范围无效" << range;
+        return false;
+    }
+
+    QSettings &settings = appSettings();
+    QString scratch = settings.value("replay/dbPath", "/tmp/smarthome-replay.db").toString();
+    if (QFileInfo(scratch).absoluteFilePath() == QFileInfo(databasePath()).absoluteFilePath()) {
+        qWarning() << "回放: replay/dbPath 不能是源数据库" << scratch;
+        return false;
+    }
+    QFile::remove(scratch);
+    QFile::remove(scratch + "-journal");
+    QFile::remove(scratch + "-wal");
+    QFile::remove(scratch + "-shm");
+
+    double speed = settings.value("replay/speed", 100).toDouble();
+    if (const char *value = argValue(argc, argv, "--speed"))
+        speed = QString::fromLocal8Bit(value).toDouble();
+    core->setReplaySource(databasePath(), QDateTime(from, QTime(0, 0)).toMSecsSinceEpoch(),
+                          QDateTime(to.addDays(1), QTime(0, 0)).toMSecsSinceEpoch(), speed);
+    *dbPath = scratch;
+    return true;
+}
+
+// 无界面模式：不创建 QApplication 和任何窗口部件
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    setupCodecs();
+    SignalWatcher watcher;
+    watchTermination(&watcher, &app);
+    ChannelRegistry::instance()->load(appSettings());
+
+    bool replaying = argValue(argc, argv, "--replay") != 0;
+    MonitorCore::Mode mode = replaying ? MonitorCore::REPLAY : MonitorCore::ACQUIRE;
+    MetricsServer metricsServer;
+    startMetrics(&metricsServer, mode);
+    MemoryBudget::instance()->start();
+
+    MonitorCore core(mode);
+    QString dbPath = databasePath();
+    if (replaying) {
+        if (!setupReplay(argc, argv, &core, &dbPath))
+            return 1;
+        QObject::connect(&core, SIGNAL(replayFinished()), &app, SLOT(quit()));
+    }
+    if (!core.start(dbPath))
+        return 1;
+    core.startCollection();
+
+    SyntheticLoad load;
+    startSyntheticLoad(argc, argv, &load);
+
+    StartupProfiler::mark("daemon_ready");
+    return app.exec();
+}
+
+// 批量导入模式：不采集，写完数据库就退出。
+// 可以和守护进程同时运行（分批提交），但在调试设备时先停止采集更快
+static int runImport(int argc, char *argv[], const char *path)
+{
+    QCoreApplication app(argc, argv);
+    setupCodecs();
+    ChannelRegistry::instance()->load(appSettings());
+
+    SensorStorage storage("import");
+    if (!storage.open(databasePath())) {
+        qWarning() << "CSV 导入: 无法打开数据库" << storage.lastError();
+        return 1;
+    }
+
+    storage.setSummaryGap(MonitorCore::summaryGapMs());
+    CsvImporter importer(&storage);
+    importer.setCommitEvery(appSettings().value("import/commitEvery", 50000).toInt());
+    bool ok = importer.run(QString::fromLocal8Bit(path));
+    storage.close();
+
+    const CsvImporter::Report &report = importer.report();
+    double seconds = qMax(qint64(1), report.elapsedMs) / 1000.0;
+    qDebug() << "CSV 导入:" << report.lines << "行," << report.samples << "个采样,"
+             << report.values << "个读数写入," << report.duplicates << "个已存在跳过,"
+             << report.rejected << "行被拒绝";
+    qDebug() << "CSV 导入: 用时" << seconds << "秒,"
+             << qRound64(report.lines / seconds * 60) << "行/分钟,"
+             << report.bytes / seconds / (1024 * 1024) << "MB/秒";
+    if (report.samples > 0) {
+        qDebug() << "CSV 导入: 时间范围"
+                 << QDateTime::fromMSecsSinceEpoch(report.firstMs).toString("yyyy-MM-dd hh:mm:ss")
+                 << "~" << QDateTime::fromMSecsSinceEpoch(report.lastMs).toString("yyyy-MM-dd hh:mm:ss");
+    }
+    if (!ok) {
+        qWarning() << "CSV 导入失败:" << importer.lastError();
+        return 1;
+    }
+    return 0;
+}
+
+// 预警评估：按天顺序读出历史记录，送入和报警相同配置的预测器（见 trendpredictor.h）
+static int runPredictEval(int argc, char *argv[], const char *range)
+{
+    QCoreApplication app(argc, argv);
+    setupCodecs();
+    ChannelRegistry::instance()->load(appSettings());
+
+    QDate from, to;
+    if (!parseDateRange(range, &from, &to)) {
+        qWarning() << "预警评估: 日期范围无效" << range;
+        return 1;
+    }
+
+    SensorStorage storage("predict");
+    if (!storage.open(databasePath(), true)) {
+        qWarning() << "预警评估: 无法打开数据库" << storage.lastError();
+        return 1;
+    }
+    // 查询结果按阶梯补出死区筛掉的采样，和报警实时看到的一样
+    storage.setSummaryGap(MonitorCore::summaryGapMs());
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 derived = 0;
+    for (int c = 0; c < channels->count(); ++c) {
+        if (channels->at(c).isDerived() && channels->at(c).alarmEnabled)
+            derived |= 1u << c;
+    }
+
+    TrendPredictorConfig config = MonitorCore::loadPredictorConfig();
+    TrendEvaluation evaluation(config);
+    for (QDate day = from; day <= to; day = day.addDays(1)) {
+        QList<SensorData> rows;
+        if (!storage.queryRange(day, day, &rows, derived)) {
+            qWarning() << "预警评估: 查询失败" << storage.lastError();
+            return 1;
+        }
+        // 查询结果按时间倒序
+        for (int i = rows.size() - 1; i >= 0; --i)
+            evaluation.feed(rows.at(i));
+    }
+    evaluation.finish();
+    storage.close();
+
+    qDebug() << "预警评估:" << from.toString("yyyy-MM-dd") << "~" << to.toString("yyyy-MM-dd")
+             << "," << evaluation.samples() << "个采样, 窗口" << config.windowSec
+             << "秒, 预警范围" << config.horizonSec << "秒";
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        if (!info.alarmEnabled)
+            continue;
+        const TrendEvaluation::ChannelReport &r = evaluation.report(c);
+        qDebug() << " " << info.key << ": 预警" << r.preAlarms << "次, 命中" << r.truePositives
+                 << ", 误报" << r.falsePositives << ", 未到期" << r.undecided
+                 << ", 误报率" << QString::number(r.falsePositiveRate() * 100, 'f', 1) + "%";
+        qDebug() << " " << info.key << ": 越线" << r.crossings << "次, 提前预警" << r.predicted
+                 << ", 漏报" << r.crossings - r.predicted;
+        if (r.predicted > 0) {
+            qDebug() << " " << info.key << ": 提前量 平均" << r.leadSumMs / r.predicted / 1000
+                     << "秒, 最短" << r.leadMinMs / 1000 << "秒, 最长" << r.leadMaxMs / 1000 << "秒";
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    StartupProfiler::begin();
+
+    if (const char *csv = argValue(argc, argv, "--import"))
+        return runImport(argc, argv, csv);
+
+    if (const char *range = argValue(argc, argv, "--predict-eval"))
+        return runPredictEval(argc, argv, range);
+
+    if (hasArg(argc, argv, "--headless", "-d"))
+        return runHeadless(argc, argv);
+
+    QApplication app(argc, argv);
+    setupCodecs();
+    SignalWatcher watcher;
+    watchTermination(&watcher, &app);
+    // 通道配置在创建任何采集、存储和界面对象之前加载
+    ChannelRegistry::instance()->load(appSettings());
 
     // 设置应用程序样式
     app.setStyle("Fusion");
+    MainWindow::applyAppStyle();
+    StartupProfiler::mark("app_created");
+
+    bool replaying = argValue(argc, argv, "--replay") != 0;
+    MonitorCore::Mode mode = replaying ? MonitorCore::REPLAY
+                           : hasArg(argc, argv, "--attach") ? MonitorCore::ATTACH
+                                                            : MonitorCore::ACQUIRE;
+    MetricsServer metricsServer;
+    startMetrics(&metricsServer, mode);
+    // 各子系统的内存记账和压力检查（见 memorybudget.h）
+    MemoryBudget::instance()->start();
+
+    MonitorCore core(mode);
+    QString dbPath = databasePath();
+    if (replaying) {
+        if (!setupReplay(argc, argv, &core, &dbPath))
+            return 1;
+        // replay/exitWhenDone=false 时保留窗口，可以在历史页查看写入的结果
+        if (appSettings().value("replay/exitWhenDone", true).toBool())
+            QObject::connect(&core, SIGNAL(replayFinished()), &app, SLOT(quit()));
+    }
 
     // 创建并显示主窗口
-    MainWindow window;
+    MainWindow window(&core);
     window.setWindowTitle(QObject::tr("智能家居监控系统"));
     window.resize(800, 600);
     window.show();
+    StartupProfiler::mark("window_shown");
+
+    // 数据库在存储线程中打开，首帧不必等待
+    core.start(dbPath);
+
+    SyntheticLoad load;
+    startSyntheticLoad(argc, argv, &load);
 
     return app.exec();
 }
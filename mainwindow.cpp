@@ -3,68 +3,290 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QTimer>
-#include <QSqlQuery>
-#include <QSqlError>
 #include <QDateTime>
 #include <QPushButton>
 #include <QHeaderView>
 #include <QMessageBox>
 #include <QApplication>  // 添加这行
 #include <QFont>         // 确保包含QFont
+#include <QPaintEvent>
+#include <QShowEvent>
 #include <QDebug>
-#include <QTimer>
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
+#include <QElapsedTimer>
+#include <QStatusBar>
+#include <QTextDocument>
+#include <QtAlgorithms>
+#include "monitorcore.h"
+#include "sensorstorage.h"
+#include "startupprofiler.h"
+#include "channelregistry.h"
+#include "derivedchannels.h"
+#include "memorybudget.h"
+#include "appsettings.h"
+
+// 全局样式表（放大所有核心控件）
+// 整个程序只在启动时设置一次，控件通过 objectName 选择特殊样式，
+// 不再在各个控件上单独调用 setStyleSheet()。
+static const char *const kAppStyleSheet =
+    "QWidget { font-size: 32px; }"  // 全局字体
+    "QTabWidget::pane { border: none; }"
+    "QTabBar::tab {"
+    "   height: 30px;"      // 标签高度
+    "   min-width: 120px;"  // 标签最小宽度
+    "   font-size: 18px;"   // 标签字体
+    "}"
+    "QPushButton {"
+    "   min-height: 60px;"  // 按钮高度
+    "   min-width: 100px;"  // 按钮宽度
+    "   font-size: 32px;"   // 按钮字体
+    "}"
+    "QDateEdit, QComboBox {"
+    "   min-height: 60px;"  // 输入框高度
+    "   font-size: 64px;"   // 输入框字体
+    "}"
+    // 实时监控页面
+    "QLabel#valueLabel { font-weight: bold; }"
+    "QPushButton#collectionButton { min-width: 200px; }"
+    "QLabel#chartTitle { font-weight: bold; font-size: 24px; }"
+    "QLabel#chartValue { font-size: 24px; font-weight: bold; }"
+    // 历史记录页面
+    "QWidget#historyPage QDateEdit { font-size: 14px; }"
+    "QWidget#historyPage QPushButton { font-size: 16px; font-weight: bold; }"
+    "QTableWidget { font-size: 16px; }"
+    "QHeaderView::section { font-size: 16px; padding: 8px; }";
+
+// 内存记账的估计值
+static const int kTableCellBytes = 128;     // 一个 QTableWidgetItem 及其文字
+static const int kLogBlockBytes = 200;      // 日志区一行的 QTextBlock 和排版数据，不含文字
+static const int kLogLineChars = 60;        // 一行日志的平均字符数
+
+// 实时页不可见期间最多积攒的日志行，回到实时页时只看得到最后几屏
+static const int kMaxPendingLog = 500;
+
+void MainWindow::applyAppStyle()
 {
-    // 在构造函数中添加：
     QFont font;
     font.setPointSize(24);  // 基础字体放大到12pt（默认通常是9pt）
     QApplication::setFont(font);
+    qApp->setStyleSheet(kAppStyleSheet);
+}
 
-    // 设置全局样式表（放大所有核心控件）
-    this->setStyleSheet(
-        "QWidget { font-size: 32px; }"  // 全局字体
-        "QTabWidget::pane { border: none; }"
-        "QTabBar::tab {"
-        "   height: 64px;"      // 标签高度
-        "   min-width: 120px;"  // 标签最小宽度
-        "   font-size: 32px;"   // 标签字体
-        "}"
-        "QPushButton {"
-        "   min-height: 60px;"  // 按钮高度
-        "   min-width: 100px;"  // 按钮宽度
-        "   font-size: 32px;"   // 按钮字体
-        "}"
-        "QDateEdit, QComboBox {"
-        "   min-height: 60px;"  // 输入框高度
-        "   font-size: 64px;"   // 输入框字体
-        "}"
-    );
-    setupUI();
+MainWindow::MainWindow(MonitorCore *core, QWidget *parent)
+    : QMainWindow(parent)
+    , core(core)
+    , firstFrameMarked(false)
+    , pendingSampleCount(0)
+    , pendingLogChars(0)
+    , historyTable(0)
+    , liveHistoryTimer(0)
+    , historyValid(false)
+    , historyCursor(0)
+    , memoryTable(0)
+    , memoryInfoLabel(0)
+{
+    QSettings &settings = appSettings();
+    MemoryBudget *budget = MemoryBudget::instance();
+    historyAccount = budget->account("history_results", MemoryAccount::Buffer,
+                                     settings.value("memory/historyResultsKB", 8192).toInt() * 1024);
+    logAccount = budget->account("log", MemoryAccount::Buffer,
+                                 settings.value("memory/logKB", 256).toInt() * 1024);
+    connect(budget, SIGNAL(pressureChanged(int)), this, SLOT(onMemoryPressure(int)));
+    connect(budget, SIGNAL(checked()), this, SLOT(onMemoryChecked()));
 
-    setupDatabase();
+    setupUI();
 
-    sensorThread = new SensorThread(this);
-    connect(sensorThread, SIGNAL(dataReceived(float,float)),
-            this, SLOT(onSensorDataReceived(float,float)));
+    // 最近的历史从内存热层取
+    core->enableHotTier();
+
+    // 界面跟不上时丢弃新采样，不拖慢采集和存储
+    SampleBus::Options options;
+    options.capacity = 64;
+    options.policy = SampleBus::Drop;
+    core->subscribe("ui", this, "onSamples", options);
+    connect(core, SIGNAL(logMessage(QString)),
+            this, SLOT(onLogMessage(QString)));
+
+    // 附加到守护进程时由守护进程控制采集，回放时没有采集
+    if (!core->canControlCollection()) {
+        collectionButton->setEnabled(false);
+        collectionButton->setText(core->mode() == MonitorCore::REPLAY ? tr("正在回放历史")
+                                                                      : tr("已附加到守护进程"));
+    }
 
     displayTimer = new QTimer(this);
     connect(displayTimer, SIGNAL(timeout()), this, SLOT(update()));
     displayTimer->start(1000);
-
-    sensorThread->start();
 }
 
 void MainWindow::setupUI()
 {
     tabWidget = new QTabWidget(this);
-    tabWidget->setStyleSheet("QTabBar::tab { font-size: 32px; padding: 10px; }");
     setCentralWidget(tabWidget);
 
     // 实时监控页面
     setupRealtimeTab();
 
-    // 历史记录页面
-    setupHistoryTab();
+    // 历史记录页面：先放一个空页面，第一次切换过去时再创建控件
+    historyWidget = new QWidget();
+    historyWidget->setObjectName("historyPage");
+    tabWidget->addTab(historyWidget, tr("历史记录"));
+
+    // 内存页同样延迟创建
+    memoryWidget = new QWidget();
+    tabWidget->addTab(memoryWidget, tr("内存"));
+    connect(tabWidget, SIGNAL(currentChanged(int)), this, SLOT(onTabChanged(int)));
+}
+
+void MainWindow::onTabChanged(int index)
+{
+    if (tabWidget->widget(index) == historyWidget && !historyTable) {
+        setupHistoryTab();
+    }
+    if (tabWidget->widget(index) == memoryWidget) {
+        if (!memoryTable)
+            setupMemoryTab();
+        refreshMemoryView();
+    }
+    if (tabWidget->widget(index) == realtimeWidget)
+        refreshRealtimeView();
+}
+
+void MainWindow::setupMemoryTab()
+{
+    QVBoxLayout *layout = new QVBoxLayout(memoryWidget);
+
+    QStringList headers;
+    headers << tr("子系统") << tr("类型") << tr("当前") << tr("峰值") << tr("预算") << tr("当前上限");
+    memoryTable = new QTableWidget();
+    memoryTable->setColumnCount(headers.size());
+    memoryTable->setHorizontalHeaderLabels(headers);
+    memoryTable->horizontalHeader()->setResizeMode(QHeaderView::Stretch);
+    memoryTable->verticalHeader()->hide();
+    memoryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    memoryInfoLabel = new QLabel();
+
+    layout->addWidget(memoryInfoLabel);
+    layout->addWidget(memoryTable, 1);
+}
+
+static QString formatBytes(qint64 bytes)
+{
+    if (bytes < 0)
+        return QObject::tr("未知");
+    if (bytes < 10 * 1024 * 1024)
+        return QString("%1 KB").arg(bytes / 1024);
+    return QString("%1 MB").arg(bytes / (1024 * 1024));
+}
+
+void MainWindow::refreshMemoryView()
+{
+    if (!memoryTable)
+        return;
+
+    MemoryBudget *budget = MemoryBudget::instance();
+    QList<MemoryAccount *> accounts = budget->accounts();
+    memoryTable->setRowCount(accounts.size());
+    for (int i = 0; i < accounts.size(); ++i) {
+        const MemoryAccount *account = accounts.at(i);
+        QStringList cells;
+        cells << account->name()
+              << (account->kind() == MemoryAccount::Cache ? tr("缓存") : tr("缓冲"))
+              << formatBytes(account->usage()) << formatBytes(account->peak())
+              << formatBytes(account->budget()) << formatBytes(account->limit());
+        for (int column = 0; column < cells.size(); ++column)
+            memoryTable->setItem(i, column, new QTableWidgetItem(cells.at(column)));
+    }
+
+    static const char *const levels[] = { "正常", "偏高", "紧张" };
+    memoryInfoLabel->setText(tr("内存压力: %1    系统可用: %2    记账合计: %3 / %4")
+                             .arg(tr(levels[budget->pressure()]))
+                             .arg(formatBytes(budget->availableBytes()))
+                             .arg(formatBytes(budget->totalUsage()))
+                             .arg(formatBytes(budget->totalLimit())));
+}
+
+void MainWindow::onMemoryChecked()
+{
+    if (memoryTable && memoryWidget->isVisible() && !isMinimized())
+        refreshMemoryView();
+}
+
+void MainWindow::onMemoryPressure(int level)
+{
+    // 缓存由 MonitorCore 丢弃，这里截断界面自己持有的结果、日志和曲线层
+    Q_UNUSED(level);
+    trimHistory();
+    logDisplay->document()->setMaximumBlockCount(logLineLimit());
+    trimPendingLog();
+    updateLogUsage();
+    chartWidget->applyMemoryLimit();
+    onMemoryChecked();
+}
+
+int MainWindow::historyRowBytes() const
+{
+    return MemoryBudget::sampleBytes()
+         + (ChannelRegistry::instance()->count() + 1) * kTableCellBytes;
+}
+
+void MainWindow::trimHistory()
+{
+    int maxRows = qMax(1, historyAccount->limit() / historyRowBytes());
+    if (historyData.size() > maxRows) {
+        historyData.erase(historyData.begin() + maxRows, historyData.end());
+        if (historyTable)
+            historyTable->setRowCount(historyData.size());
+        statusBar()->showMessage(tr("历史记录超过内存预算，只保留最新的 %1 条").arg(maxRows), 10000);
+    }
+    historyAccount->setUsage(historyData.size() * historyRowBytes());
+}
+
+int MainWindow::logLineLimit() const
+{
+    return qMax(10, logAccount->limit() / (kLogBlockBytes + 2 * kLogLineChars));
+}
+
+void MainWindow::trimPendingLog()
+{
+    // 采样在环形缓冲中自然只剩最新的，显示时再按 logLineLimit() 截取
+    int limit = qMin(kMaxPendingLog, logLineLimit());
+    while (pendingMessages.size() > limit) {
+        pendingLogChars -= pendingMessages.first().second.size();
+        pendingMessages.removeFirst();
+    }
+}
+
+void MainWindow::updateLogUsage()
+{
+    QTextDocument *document = logDisplay->document();
+    int samples = int(qMin(pendingSampleCount, qint64(kMaxPendingLog)));
+    logAccount->setUsage((document->characterCount() + pendingLogChars) * 2
+                         + (document->blockCount() + pendingMessages.size()) * kLogBlockBytes
+                         + pendingSamples.size() * int(sizeof(SensorData))
+                         + samples * (kLogBlockBytes + 2 * kLogLineChars));
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    refreshRealtimeView();
+}
+
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange && !isMinimized())
+        refreshRealtimeView();
+}
+
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (!firstFrameMarked) {
+        StartupProfiler::mark("first_frame");
+        firstFrameMarked = true;
+    }
 }
 
 void MainWindow::setupRealtimeTab()
@@ -82,16 +304,18 @@ void MainWindow::setupRealtimeTab()
     QWidget *dataWidget = new QWidget();
     QHBoxLayout *dataLayout = new QHBoxLayout(dataWidget);
     dataLayout->setContentsMargins(0, 0, 0, 0);
-    tempLabel = new QLabel("温度: --°C");
-    humLabel = new QLabel("湿度: --%");
-    tempLabel->setStyleSheet("font-size: 32px; font-weight: bold;");
-    humLabel->setStyleSheet("font-size: 32px; font-weight: bold;");
-    dataLayout->addWidget(tempLabel);
-    dataLayout->addWidget(humLabel);
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        QLabel *label = new QLabel(QString("%1: --%2").arg(info.name, info.unit));
+        label->setObjectName("valueLabel");
+        dataLayout->addWidget(label);
+        valueLabels.append(label);
+    }
 
     // 右侧按钮
     collectionButton = new QPushButton(tr("开始收集数据"));
-    collectionButton->setStyleSheet("font-size: 32px; min-height: 60px; min-width: 200px;");
+    collectionButton->setObjectName("collectionButton");
     connect(collectionButton, SIGNAL(clicked()), this, SLOT(onToggleCollection()));
 
     // 添加到控制布局
@@ -103,6 +327,8 @@ void MainWindow::setupRealtimeTab()
     logDisplay = new QTextEdit();
     logDisplay->setReadOnly(true);
     logDisplay->setMaximumHeight(100);
+    // 只保留最近的日志，长时间运行时文档不会无限增长
+    logDisplay->document()->setMaximumBlockCount(logLineLimit());
 
     // 主布局
     layout->addWidget(controlWidget);
@@ -114,7 +340,6 @@ void MainWindow::setupRealtimeTab()
 
 void MainWindow::setupHistoryTab()
 {
-    historyWidget = new QWidget();
     QVBoxLayout *layout = new QVBoxLayout(historyWidget);
     layout->setSpacing(15);  // 增加布局间距
 
@@ -126,25 +351,36 @@ void MainWindow::setupHistoryTab()
     startDateEdit = new QDateEdit(QDate::currentDate().addDays(-7));
     startDateEdit->setCalendarPopup(true);
     startDateEdit->setMinimumHeight(35);
-    startDateEdit->setStyleSheet("font-size: 14px;");
 
     endDateEdit = new QDateEdit(QDate::currentDate());
     endDateEdit->setCalendarPopup(true);
     endDateEdit->setMinimumHeight(35);
-    endDateEdit->setStyleSheet("font-size: 14px;");
 
     // 按钮（放大并加粗）
     queryButton = new QPushButton(tr("查询"));
     queryButton->setMinimumSize(120, 45);
-    queryButton->setStyleSheet("font-size: 16px; font-weight: bold;");
 
     refreshButton = new QPushButton(tr("刷新"));
     refreshButton->setMinimumSize(120, 45);
-    refreshButton->setStyleSheet("font-size: 16px; font-weight: bold;");
+
+    summaryButton = new QPushButton(tr("统计"));
+    summaryButton->setMinimumSize(120, 45);
+    summaryBucketCombo = new QComboBox();
+    summaryBucketCombo->addItem(tr("按天"));
+    summaryBucketCombo->addItem(tr("按小时"));
+    summaryBucketCombo->setMinimumHeight(35);
 
     // 连接信号槽
     connect(queryButton, SIGNAL(clicked()), this, SLOT(onQueryHistoryData()));
     connect(refreshButton, SIGNAL(clicked()), this, SLOT(onRefreshHistoryData()));
+    connect(summaryButton, SIGNAL(clicked()), this, SLOT(onSummarizeHistory()));
+
+    // 实时更新：历史页可见时定期做增量刷新
+    liveHistoryCheck = new QCheckBox(tr("实时更新"));
+    liveHistoryTimer = new QTimer(this);
+    liveHistoryTimer->setInterval(2000);
+    connect(liveHistoryTimer, SIGNAL(timeout()), this, SLOT(onRefreshHistoryData()));
+    connect(liveHistoryCheck, SIGNAL(toggled(bool)), this, SLOT(onLiveHistoryToggled(bool)));
     // 添加到布局
     queryLayout->addWidget(new QLabel(tr("开始日期:")));
     queryLayout->addWidget(startDateEdit);
@@ -154,135 +390,375 @@ void MainWindow::setupHistoryTab()
     queryLayout->addSpacing(20);  // 增加间距
     queryLayout->addWidget(queryButton);
     queryLayout->addWidget(refreshButton);
+    queryLayout->addWidget(liveHistoryCheck);
+    queryLayout->addSpacing(20);
+    queryLayout->addWidget(summaryButton);
+    queryLayout->addWidget(summaryBucketCombo);
     queryLayout->addStretch();
 
     // ================= 历史数据表格 =================
+    // 时间 + 每个通道一列
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    QStringList headers;
+    headers << tr("时间");
+    for (int c = 0; c < channels->count(); ++c)
+        headers << QString("%1(%2)").arg(channels->at(c).name, channels->at(c).unit);
+
     historyTable = new QTableWidget();
-    historyTable->setColumnCount(3);
-    historyTable->setHorizontalHeaderLabels(
-        QStringList() << tr("时间") << tr("温度(°C)") << tr("湿度(%)")
-    );
+    historyTable->setColumnCount(headers.size());
+    historyTable->setHorizontalHeaderLabels(headers);
 
     // 列宽策略（重点修改）
     historyTable->horizontalHeader()->setStretchLastSection(false);
     historyTable->horizontalHeader()->setResizeMode(0, QHeaderView::Interactive);  // ✅ Qt4 使用 setResizeMode
-    historyTable->horizontalHeader()->setResizeMode(1, QHeaderView::Stretch);
-    historyTable->horizontalHeader()->setResizeMode(2, QHeaderView::Stretch);
+    for (int column = 1; column < headers.size(); ++column)
+        historyTable->horizontalHeader()->setResizeMode(column, QHeaderView::Stretch);
     historyTable->setColumnWidth(0, 220);
-    // 表格样式
-    historyTable->setStyleSheet(
-        "QTableWidget { font-size: 16px; } "
-        "QHeaderView::section { font-size: 16px; padding: 8px; }"  // 表头字体加大
-    );
     historyTable->verticalHeader()->setDefaultSectionSize(45);  // 行高
     historyTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     historyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
+    // 记录和统计分两页，共用上面的日期范围
+    historyViews = new QTabWidget();
+    historyViews->addTab(historyTable, tr("记录"));
+    historyViews->addTab(createSummaryPage(), tr("统计"));
+
     // ================= 整合布局 =================
     layout->addLayout(queryLayout);
-    layout->addWidget(historyTable, 1);  // 表格占据剩余空间
+    layout->addWidget(historyViews, 1);  // 表格占据剩余空间
+}
 
-    // 添加到Tab
-    tabWidget->addTab(historyWidget, tr("历史记录"));
-    tabWidget->setStyleSheet("QTabBar::tab { height: 30px; font-size: 18px; }");  // 放大Tab标签
+QWidget *MainWindow::createSummaryPage()
+{
+    QWidget *page = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(page);
+
+    QStringList headers;
+    headers << tr("通道") << tr("最小") << tr("最大") << tr("平均") << tr("标准差")
+            << tr("高于上限") << tr("低于下限") << tr("有数据");
+    summaryTable = new QTableWidget();
+    summaryTable->setColumnCount(headers.size());
+    summaryTable->setHorizontalHeaderLabels(headers);
+    summaryTable->horizontalHeader()->setResizeMode(QHeaderView::Stretch);
+    summaryTable->verticalHeader()->hide();
+    summaryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    summaryTable->setMaximumHeight(200);
+
+    // 分时段：时间 + 每个通道一列（平均 / 最小~最大）
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    QStringList bucketHeaders;
+    bucketHeaders << tr("时段");
+    for (int c = 0; c < channels->count(); ++c)
+        bucketHeaders << QString("%1(%2)").arg(channels->at(c).name, channels->at(c).unit);
+    breakdownTable = new QTableWidget();
+    breakdownTable->setColumnCount(bucketHeaders.size());
+    breakdownTable->setHorizontalHeaderLabels(bucketHeaders);
+    breakdownTable->horizontalHeader()->setResizeMode(QHeaderView::Stretch);
+    breakdownTable->horizontalHeader()->setResizeMode(0, QHeaderView::Interactive);
+    breakdownTable->setColumnWidth(0, 220);
+    breakdownTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    breakdownTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    summaryInfoLabel = new QLabel();
+
+    layout->addWidget(summaryTable);
+    layout->addWidget(summaryInfoLabel);
+    layout->addWidget(breakdownTable, 1);
+    return page;
 }
 
-void MainWindow::setupDatabase()
+static QString formatDuration(qint64 ms)
 {
-    db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName("sensor_data.db");
+    qint64 minutes = ms / 60000;
+    if (minutes < 60)
+        return QObject::tr("%1分").arg(minutes);
+    if (minutes < 24 * 60)
+        return QObject::tr("%1时%2分").arg(minutes / 60).arg(minutes % 60);
+    return QObject::tr("%1天%2时").arg(minutes / (24 * 60)).arg(minutes / 60 % 24);
+}
 
-    if (!db.open()) {
-        logDisplay->append(tr("无法打开数据库!"));
+void MainWindow::onSummarizeHistory()
+{
+    SensorStorage *storage = core->reader();
+    bool daily = summaryBucketCombo->currentIndex() == 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<SummaryBucket> buckets;
+    SummaryBucket total;
+    if (!storage->summarize(startDateEdit->date(), endDateEdit->date(), daily,
+                            &buckets, &total)) {
+        QMessageBox::warning(this, tr("统计失败"), tr("无法统计历史数据: ") + storage->lastError());
         return;
     }
+    qint64 elapsed = timer.elapsed();
+
+    // 整个范围
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    summaryTable->setRowCount(channels->count());
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        const ChannelSummary &summary = total.channels[c];
+        QStringList cells;
+        cells << info.name;
+        if (summary.hasData()) {
+            cells << info.format(summary.min) + info.unit
+                  << info.format(summary.max) + info.unit
+                  << info.format(summary.mean()) + info.unit
+                  << QString::number(summary.stdDev(), 'f', info.decimals + 1);
+            if (info.alarmEnabled)
+                cells << formatDuration(summary.aboveMs) << formatDuration(summary.belowMs);
+            else
+                cells << "-" << "-";
+            cells << formatDuration(summary.durationMs);
+        }
+        // 没有数据的通道只显示名称
+        for (int column = 0; column < summaryTable->columnCount(); ++column) {
+            QString text = column < cells.size() ? cells.at(column) : QString();
+            summaryTable->setItem(c, column, new QTableWidgetItem(text));
+        }
+    }
+
+    // 分时段，新的在前
+    breakdownTable->setUpdatesEnabled(false);
+    breakdownTable->setRowCount(buckets.size());
+    for (int i = 0; i < buckets.size(); ++i) {
+        const SummaryBucket &bucket = buckets.at(i);
+        QDateTime start = QDateTime::fromMSecsSinceEpoch(bucket.startMs);
+        breakdownTable->setItem(i, 0, new QTableWidgetItem(
+            start.toString(daily ? "yyyy-MM-dd" : "yyyy-MM-dd hh:00")));
+        for (int c = 0; c < channels->count(); ++c) {
+            const ChannelSummary &summary = bucket.channels[c];
+            const ChannelInfo &info = channels->at(c);
+            QString text;
+            if (summary.hasData()) {
+                text = QString("%1 (%2~%3)").arg(info.format(summary.mean()),
+                                                 info.format(summary.min),
+                                                 info.format(summary.max));
+            }
+            breakdownTable->setItem(i, c + 1, new QTableWidgetItem(text));
+        }
+    }
+    breakdownTable->setUpdatesEnabled(true);
 
-    // 创建表
-    QSqlQuery query;
-    query.exec("PRAGMA encoding = 'UTF-8';");  // 关键语句
-    query.exec("CREATE TABLE IF NOT EXISTS sensor_data ("
-               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "timestamp DATETIME, "
-               "temperature REAL, "
-               "humidity REAL)");
+    summaryInfoLabel->setText(tr("%1 ~ %2，%3 个时段，用时 %4 毫秒")
+                              .arg(startDateEdit->date().toString("yyyy-MM-dd"))
+                              .arg(endDateEdit->date().toString("yyyy-MM-dd"))
+                              .arg(buckets.size()).arg(elapsed));
+    historyViews->setCurrentIndex(1);
 }
 
-void MainWindow::saveToDatabase(float temp, float hum)
+void MainWindow::onSamples(const SensorDataList &samples)
 {
-    QSqlQuery query;
-    query.prepare("INSERT INTO sensor_data (timestamp, temperature, humidity) "
-                  "VALUES (:timestamp, :temp, :hum)");
-    query.bindValue(":timestamp", QDateTime::currentDateTime());
-    query.bindValue(":temp", temp);
-    query.bindValue(":hum", hum);
+    bool viewable = isRealtimeViewable();
+    for (int i = 0; i < samples.size(); ++i) {
+        const SensorData &data = samples.at(i);
+
+        // 更新图表（看不见的图表只记游标）
+        chartWidget->addDataPoint(data);
+
+        // 本次没有读数的通道保持上一次的值
+        for (int c = 0; c < valueLabels.size(); ++c) {
+            if (data.has(c))
+                latestValues.setValue(c, data.value(c));
+        }
 
-    if (!query.exec()) {
-        logDisplay->append(tr("保存数据失败: ") + query.lastError().text());
+        // 记录日志；看不见时只存下采样，显示时再格式化
+        if (viewable) {
+            appendLog(formatLogEntry(data));
+        } else {
+            if (pendingSamples.isEmpty())
+                pendingSamples.resize(kMaxPendingLog);
+            pendingSamples[int(pendingSampleCount % kMaxPendingLog)] = data;
+            ++pendingSampleCount;
+        }
     }
+
+    // 一批只刷新一次显示
+    if (viewable)
+        refreshRealtimeView();
+    else
+        updateLogUsage();
 }
 
-void MainWindow::onSensorDataReceived(float temp, float hum)
+QString MainWindow::formatLogEntry(const SensorData &data) const
 {
-    SensorData data(temp, hum);
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    QString logEntry = QString("[%1]").arg(data.timestamp.toString("hh:mm:ss"));
+    for (int c = 0; c < valueLabels.size(); ++c) {
+        if (!data.has(c))
+            continue;
+        const ChannelInfo &info = channels->at(c);
+        logEntry += QString(" %1:%2%3").arg(info.name, info.format(data.value(c)), info.unit);
+    }
+    return logEntry;
+}
 
-    // 更新图表
-    chartWidget->addDataPoint(data);
+void MainWindow::onLogMessage(const QString &text)
+{
+    appendLog(text);
+}
 
-    // 保存到数据库
-    saveToDatabase(temp, hum);
+bool MainWindow::isRealtimeViewable() const
+{
+    return realtimeWidget->isVisible() && !isMinimized();
+}
 
-    // 更新显示
-    tempLabel->setText(QString(tr("温度: %1°C")).arg(temp, 0, 'f', 1));
-    humLabel->setText(QString(tr("湿度: %1%")).arg(hum, 0, 'f', 1));
+void MainWindow::appendLog(const QString &text)
+{
+    if (isRealtimeViewable()) {
+        logDisplay->append(text);
+    } else {
+        pendingMessages.append(qMakePair(pendingSampleCount, text));
+        pendingLogChars += text.size();
+        trimPendingLog();
+    }
+    updateLogUsage();
+}
 
-    // 记录日志
-    QString logEntry = QString("[%1] T:%2°C H:%3%")
-                      .arg(QTime::currentTime().toString("hh:mm:ss"))
-                      .arg(temp, 0, 'f', 1)
-                      .arg(hum, 0, 'f', 1);
-    logDisplay->append(logEntry);
+void MainWindow::refreshRealtimeView()
+{
+    if (!isRealtimeViewable())
+        return;
+
+    // 派生通道按各通道最新的值重新计算，只在显示时进行
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    latestValues.channelMask &= ~channels->derivedMask();
+    DerivedChannels::evaluate(&latestValues, channels->derivedMask());
+    for (int c = 0; c < valueLabels.size(); ++c) {
+        if (latestValues.has(c))
+            valueLabels[c]->setText(channels->at(c).name + ": "
+                                    + channels->at(c).format(latestValues.value(c))
+                                    + channels->at(c).unit);
+    }
+    if (pendingSampleCount > 0 || !pendingMessages.isEmpty()) {
+        // 采样按收到的次序格式化，其他日志插回收到时的位置
+        qint64 keep = qMin(qint64(qMin(kMaxPendingLog, logLineLimit())), pendingSampleCount);
+        QStringList lines;
+        int m = 0;
+        for (qint64 s = pendingSampleCount - keep; s < pendingSampleCount; ++s) {
+            while (m < pendingMessages.size() && pendingMessages.at(m).first <= s)
+                lines << pendingMessages.at(m++).second;
+            lines << formatLogEntry(pendingSamples.at(int(s % kMaxPendingLog)));
+        }
+        while (m < pendingMessages.size())
+            lines << pendingMessages.at(m++).second;
+        logDisplay->append(lines.join("\n"));
+
+        pendingSamples.clear();
+        pendingSampleCount = 0;
+        pendingMessages.clear();
+        pendingLogChars = 0;
+        updateLogUsage();
+    }
 }
 
 void MainWindow::loadHistoryData()
 {
-    QSqlQuery query;
-    query.prepare("SELECT timestamp, temperature, humidity FROM sensor_data "
-                  "WHERE DATE(timestamp) BETWEEN :start AND :end "
-                  "ORDER BY timestamp DESC");
-    query.bindValue(":start", startDateEdit->date());
-    query.bindValue(":end", endDateEdit->date());
-
-    if (!query.exec()) {
-        QMessageBox::warning(this, tr("查询失败"), tr("无法查询历史数据: ") + query.lastError().text());
+    SensorStorage *storage = core->reader();
+    // 游标在查询之前取：之间写入的记录会再取到一次，合并时按时间戳去重
+    qint64 cursor = storage->maxId();
+    // 表格每个通道一列，派生通道在这里算出；结果按内存账户的上限只取最新的部分
+    int maxRows = qMax(1, historyAccount->limit() / historyRowBytes());
+    if (!storage->queryRange(startDateEdit->date(), endDateEdit->date(), &historyData,
+                             ChannelRegistry::instance()->derivedMask(), maxRows)) {
+        historyValid = false;
+        historyAccount->setUsage(historyData.size() * historyRowBytes());
+        QMessageBox::warning(this, tr("查询失败"), tr("无法查询历史数据: ") + storage->lastError());
         return;
     }
+    historyAccount->setUsage(historyData.size() * historyRowBytes());
+    if (storage->lastQueryTruncated())
+        statusBar()->showMessage(tr("查询结果超过内存预算，只显示最新的 %1 条")
+                                 .arg(historyData.size()), 10000);
+
+    historyValid = true;
+    historyStart = startDateEdit->date();
+    historyEnd = endDateEdit->date();
+    historyCursor = cursor;
+    updateHistoryTable();
+}
 
-    historyData.clear();
-    while (query.next()) {
-        SensorData data;
-        data.timestamp = query.value(0).toDateTime();
-        data.temperature = query.value(1).toDouble();
-        data.humidity = query.value(2).toDouble();
-        historyData.append(data);
+static bool newerFirst(const SensorData &a, const SensorData &b)
+{
+    return a.timestamp > b.timestamp;
+}
+
+void MainWindow::refreshHistoryData()
+{
+    if (!historyValid || startDateEdit->date() != historyStart
+        || endDateEdit->date() != historyEnd) {
+        loadHistoryData();
+        return;
     }
 
-    updateHistoryTable();
+    SensorStorage *storage = core->reader();
+    QList<SensorData> rows;
+    if (!storage->fetchSince(historyCursor, &rows, &historyCursor)) {
+        liveHistoryCheck->setChecked(false);
+        QMessageBox::warning(this, tr("刷新失败"), tr("无法查询历史数据: ") + storage->lastError());
+        return;
+    }
+    DerivedChannels::evaluate(&rows, ChannelRegistry::instance()->derivedMask());
+
+    // 只要所选日期内的，和查询结果一样按时间倒序
+    QList<SensorData> fresh;
+    for (int i = 0; i < rows.size(); ++i) {
+        QDate day = rows.at(i).timestamp.date();
+        if (day >= historyStart && day <= historyEnd)
+            fresh.append(rows.at(i));
+    }
+    if (fresh.isEmpty())
+        return;
+    qStableSort(fresh.begin(), fresh.end(), newerFirst);
+
+    // 和查询一样补出死区筛掉的采样；接在已显示的最新一条之后的，从那一条开始补
+    bool anchored = !historyData.isEmpty()
+                 && fresh.last().timestamp > historyData.first().timestamp;
+    if (anchored)
+        fresh.append(historyData.first());
+    storage->expandSteps(&fresh);
+    if (anchored)
+        fresh.removeLast();
+
+    // 按时间戳合并：晚到的、时间上更早的记录插到对应位置，已经显示过的同一采样就地替换
+    historyTable->setUpdatesEnabled(false);
+    for (int i = fresh.size() - 1; i >= 0; --i) {
+        const SensorData &data = fresh.at(i);
+        int row = qLowerBound(historyData.begin(), historyData.end(), data, newerFirst)
+                - historyData.begin();
+        if (row < historyData.size() && historyData.at(row).timestamp == data.timestamp) {
+            historyData[row] = data;
+        } else {
+            historyData.insert(row, data);
+            historyTable->insertRow(row);
+        }
+        setHistoryRow(row, data);
+    }
+    // 不超过查询时的条数上限，多出来的是最早的
+    trimHistory();
+    historyTable->setUpdatesEnabled(true);
 }
 
 void MainWindow::updateHistoryTable()
 {
     historyTable->setRowCount(historyData.size());
 
-    for (int i = 0; i < historyData.size(); ++i) {
-        const SensorData &data = historyData[i];
+    for (int i = 0; i < historyData.size(); ++i)
+        setHistoryRow(i, historyData[i]);
+}
+
+void MainWindow::setHistoryRow(int row, const SensorData &data)
+{
+    const ChannelRegistry *channels = ChannelRegistry::instance();
 
-        QTableWidgetItem *timeItem = new QTableWidgetItem(data.timestamp.toString("yyyy-MM-dd hh:mm:ss"));
-        QTableWidgetItem *tempItem = new QTableWidgetItem(QString::number(data.temperature, 'f', 1));
-        QTableWidgetItem *humItem = new QTableWidgetItem(QString::number(data.humidity, 'f', 1));
+    QTableWidgetItem *timeItem = new QTableWidgetItem(data.timestamp.toString("yyyy-MM-dd hh:mm:ss"));
+    historyTable->setItem(row, 0, timeItem);
 
-        historyTable->setItem(i, 0, timeItem);
-        historyTable->setItem(i, 1, tempItem);
-        historyTable->setItem(i, 2, humItem);
+    // 没有该通道读数的单元格留空
+    for (int c = 0; c < channels->count(); ++c) {
+        QString text = data.has(c) ? channels->at(c).format(data.value(c)) : QString();
+        historyTable->setItem(row, c + 1, new QTableWidgetItem(text));
     }
 }
 
@@ -293,7 +769,20 @@ void MainWindow::onQueryHistoryData()
 
 void MainWindow::onRefreshHistoryData()
 {
-    loadHistoryData();
+    // 定时刷新只在历史页可见时进行
+    if (sender() == liveHistoryTimer && (!historyWidget->isVisible() || isMinimized()))
+        return;
+    refreshHistoryData();
+}
+
+void MainWindow::onLiveHistoryToggled(bool enabled)
+{
+    if (enabled) {
+        refreshHistoryData();
+        liveHistoryTimer->start();
+    } else {
+        liveHistoryTimer->stop();
+    }
 }
 
 void MainWindow::updateDisplay()
@@ -303,25 +792,18 @@ void MainWindow::updateDisplay()
 
 MainWindow::~MainWindow()
 {
-    if (sensorThread) {
-        sensorThread->quit();
-        sensorThread->wait(1000); // 等待最多1秒
-        if (sensorThread->isRunning()) {
-            sensorThread->terminate();
-        }
-        delete sensorThread;
-    }
+    // 采集线程和数据库由 MonitorCore 管理
 }
 void MainWindow::onToggleCollection()
 {
     qDebug() << "Toggle collection clicked";
-    if (sensorThread->isCollecting()) {
+    if (core->isCollecting()) {
         qDebug() << "Stopping collection";
-        sensorThread->stopCollection();
+        core->stopCollection();
         collectionButton->setText(tr("开始收集数据"));
     } else {
         qDebug() << "Starting collection";
-        sensorThread->startCollection();
+        core->startCollection();
         collectionButton->setText(tr("停止收集数据"));
     }
 }
@@ -2,42 +2,83 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QSqlDatabase>
 #include <QTextEdit>
 #include <QTableWidget>
 #include <QTabWidget>
 #include <QDateEdit>
 #include <QTimer>
 #include <QLabel>
-#include "sensorthread.h"
+#include <QPushButton>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QVector>
+#include <QPair>
 #include "chartwidget.h"
 
+class MonitorCore;
+class MemoryAccount;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 public:
-    explicit MainWindow(QWidget *parent = 0);
+    explicit MainWindow(MonitorCore *core, QWidget *parent = 0);
     ~MainWindow();
 
+    // 设置全局字体和样式表，创建窗口前调用一次
+    static void applyAppStyle();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void showEvent(QShowEvent *event);
+    void changeEvent(QEvent *event);
+
 private slots:
-    void onSensorDataReceived(float temperature, float humidity);
+    void onSamples(const SensorDataList &samples);
+    void onLogMessage(const QString &text);
     void updateDisplay();
     void onQueryHistoryData();
     void onRefreshHistoryData();
+    void onLiveHistoryToggled(bool enabled);
+    void onSummarizeHistory();
     void onToggleCollection();
+    void onTabChanged(int index);
+    void onMemoryPressure(int level);
+    void onMemoryChecked();
 private:
     void setupUI();
-    void setupDatabase();
-    void saveToDatabase(float temp, float hum);
     void loadHistoryData();
     void setupRealtimeTab();    // 声明实时监控页面初始化
-    void setupHistoryTab();     // 声明历史记录页面初始化
+    void setupHistoryTab();     // 历史记录页面，第一次显示时才创建
     void updateHistoryTable();
+    // 只取上次查询（或刷新）之后写入的记录插到表格顶部；查询条件变了时整体重查
+    void refreshHistoryData();
+    void setHistoryRow(int row, const SensorData &data);
+    QWidget *createSummaryPage();
+
+    // 内存页：各子系统的内存账户（见 memorybudget.h），第一次显示时才创建
+    void setupMemoryTab();
+    void refreshMemoryView();
+    // 查询结果和日志按各自内存账户的上限截断
+    int historyRowBytes() const;
+    void trimHistory();
+    int logLineLimit() const;
+    // 待显示的采样和消息各自只保留最新的 kMaxPendingLog 条，同时不超过 logLineLimit()
+    void trimPendingLog();
+    void updateLogUsage();
+
+    // 实时页不可见（在历史页或窗口最小化）时只记下最新值和原样的采样，
+    // 显示时再格式化成日志，一次刷新
+    bool isRealtimeViewable() const;
+    QString formatLogEntry(const SensorData &data) const;
+    void appendLog(const QString &text);
+    void refreshRealtimeView();
 
     QPushButton *collectionButton; // 添加这个按钮
 
-    SensorThread *sensorThread;
+    MonitorCore *core;
     QTimer *displayTimer;
+    bool firstFrameMarked;         // 启动计时的 first_frame 已经记录
 
     // UI组件
     QTabWidget *tabWidget;
@@ -45,8 +86,16 @@ private:
     // 实时监控页面
     QWidget *realtimeWidget;
     ChartWidget *chartWidget;
-    QLabel *tempLabel, *humLabel;
+    QList<QLabel *> valueLabels;   // 每个通道一个，顺序与 ChannelRegistry 相同
     QTextEdit *logDisplay;
+    SensorData latestValues;      // 各通道最近一次的读数
+    // 实时页不可见期间收到的采样，环形保存最新的 kMaxPendingLog 个，见 trimPendingLog()
+    QVector<SensorData> pendingSamples;
+    qint64 pendingSampleCount;    // 不可见以来收到的采样数
+    // 不可见期间的其他日志，first 为它之前收到的采样数，显示时按这个次序插回
+    QList<QPair<qint64, QString> > pendingMessages;
+    int pendingLogChars;          // pendingMessages 的字符数
+    MemoryAccount *logAccount;    // 日志区和待显示的日志，memory/logKB
 
     // 历史记录页面
     QWidget *historyWidget;
@@ -55,9 +104,28 @@ private:
     QDateEdit *endDateEdit;
     QPushButton *queryButton;
     QPushButton *refreshButton;
+    QCheckBox *liveHistoryCheck;
+    QTimer *liveHistoryTimer;
+
+    // 统计：按所选日期范围汇总，不经过 historyData
+    QTabWidget *historyViews;        // 记录 / 统计
+    QPushButton *summaryButton;
+    QComboBox *summaryBucketCombo;   // 按小时 / 按天
+    QTableWidget *summaryTable;      // 每个通道一行
+    QTableWidget *breakdownTable;    // 每个时间桶一行
+    QLabel *summaryInfoLabel;
+
+    QList<SensorData> historyData;   // 按时间倒序，与表格行一一对应
+    bool historyValid;
+    QDate historyStart;              // 当前结果对应的查询条件
+    QDate historyEnd;
+    qint64 historyCursor;            // 查询时存储的游标（见 SensorStorage::fetchSince）
+    MemoryAccount *historyAccount;   // historyData 和表格，memory/historyResultsKB
 
-    QSqlDatabase db;
-    QList<SensorData> historyData;
+    // 内存页
+    QWidget *memoryWidget;
+    QTableWidget *memoryTable;
+    QLabel *memoryInfoLabel;
 
 
 };
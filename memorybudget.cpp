@@ -0,0 +1,196 @@
+#include "memorybudget.h"
+#include "metrics.h"
+#include "appsettings.h"
+#include "sensordata.h"
+#include <QTimer>
+#include <QFile>
+#include <QDebug>
+
+// ============== MemoryAccount ==============
+
+MemoryAccount::MemoryAccount(const QString &name, Kind kind, int budget)
+    : m_name(name)
+    , m_kind(kind)
+    , m_budget(qMax(0, budget))
+{
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    QString labels = QString("subsystem=\"%1\"").arg(name);
+    m_usageGauge = registry->gauge("smarthome_memory_usage_bytes",
+                                   "Memory accounted to a subsystem.", labels);
+    m_peakGauge = registry->gauge("smarthome_memory_peak_bytes",
+                                  "Highest memory accounted to a subsystem since start.", labels);
+    registry->gauge("smarthome_memory_budget_bytes",
+                    "Configured memory budget of a subsystem.", labels)->set(m_budget);
+}
+
+int MemoryAccount::limit() const
+{
+    switch (MemoryBudget::instance()->pressure()) {
+    case MemoryBudget::Elevated:
+        return m_kind == Cache ? m_budget / 2 : m_budget;
+    case MemoryBudget::Critical:
+        return m_kind == Cache ? 0 : m_budget / 2;
+    default:
+        return m_budget;
+    }
+}
+
+void MemoryAccount::setUsage(int bytes)
+{
+    m_usage.fetchAndStoreRelaxed(bytes);
+    m_usageGauge->set(bytes);
+    // 并发更新时峰值可能少记一次，只用于显示
+    if (bytes > int(m_peak)) {
+        m_peak.fetchAndStoreRelaxed(bytes);
+        m_peakGauge->set(bytes);
+    }
+}
+
+// ============== MemoryBudget ==============
+
+MemoryBudget::MemoryBudget()
+    : m_available(-1)
+    , m_totalKB(0)
+    , m_lowFreeKB(8192)
+    , m_criticalFreeKB(4096)
+    , m_timer(0)
+{
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_pressureGauge = registry->gauge("smarthome_memory_pressure",
+                                      "Memory pressure level: 0 normal, 1 elevated, 2 critical.");
+    m_availableGauge = registry->gauge("smarthome_memory_available_bytes",
+                                       "System memory available at the last pressure check.");
+}
+
+MemoryBudget *MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return &budget;
+}
+
+MemoryAccount *MemoryBudget::account(const QString &name, MemoryAccount::Kind kind,
+                                     int budgetBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_accounts.size(); ++i) {
+        if (m_accounts[i]->name() == name)
+            return m_accounts[i];
+    }
+    MemoryAccount *account = new MemoryAccount(name, kind, budgetBytes);
+    m_accounts.append(account);
+    return account;
+}
+
+QList<MemoryAccount *> MemoryBudget::accounts() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_accounts;
+}
+
+qint64 MemoryBudget::totalUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (int i = 0; i < m_accounts.size(); ++i)
+        total += m_accounts[i]->usage();
+    return total;
+}
+
+qint64 MemoryBudget::totalLimit() const
+{
+    if (m_totalKB > 0)
+        return m_totalKB * 1024;
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (int i = 0; i < m_accounts.size(); ++i)
+        total += m_accounts[i]->budget();
+    return total;
+}
+
+void MemoryBudget::start()
+{
+    QSettings &settings = appSettings();
+    settings.beginGroup("memory");
+    m_totalKB = settings.value("totalKB", 0).toLongLong();
+    m_lowFreeKB = settings.value("lowFreeKB", m_lowFreeKB).toLongLong();
+    m_criticalFreeKB = settings.value("criticalFreeKB", m_criticalFreeKB).toLongLong();
+    int checkSec = qMax(1, settings.value("checkSec", 5).toInt());
+    settings.endGroup();
+
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(check()));
+    }
+    m_timer->start(checkSec * 1000);
+}
+
+int MemoryBudget::sampleBytes()
+{
+    // QDateTime 的私有数据约 20 字节，加上两次分配的堆管理开销
+    return int(sizeof(void *) + sizeof(SensorData)) + 20 + 2 * 8;
+}
+
+qint64 MemoryBudget::readAvailable() const
+{
+#ifdef __linux__
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly))
+        return -1;
+    qint64 available = -1;
+    qint64 estimate = 0;
+    QList<QByteArray> lines = meminfo.readAll().split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        QList<QByteArray> fields = lines[i].simplified().split(' ');
+        if (fields.size() < 2)
+            continue;
+        qint64 kb = fields[1].toLongLong();
+        if (fields[0] == "MemAvailable:")
+            available = kb;
+        else if (fields[0] == "MemFree:" || fields[0] == "Buffers:" || fields[0] == "Cached:")
+            estimate += kb;
+    }
+    // 3.14 之前的内核没有 MemAvailable
+    return (available >= 0 ? available : estimate) * 1024;
+#else
+    return -1;
+#endif
+}
+
+MemoryBudget::Pressure MemoryBudget::levelFor(qint64 available, qint64 total,
+                                              int marginPercent) const
+{
+    qint64 limit = totalLimit() * (100 - marginPercent) / 100;
+    qint64 low = m_lowFreeKB * 1024 * (100 + marginPercent) / 100;
+    qint64 critical = m_criticalFreeKB * 1024 * (100 + marginPercent) / 100;
+
+    if ((available >= 0 && available < critical) || (limit > 0 && total > limit))
+        return Critical;
+    if ((available >= 0 && available < low) || (limit > 0 && total > limit * 9 / 10))
+        return Elevated;
+    return Normal;
+}
+
+void MemoryBudget::check()
+{
+    m_available = readAvailable();
+    qint64 total = totalUsage();
+    m_availableGauge->set(int(qMin(m_available, qint64(0x7fffffff))));
+
+    // 升级立即生效，降级要留出余量
+    Pressure current = pressure();
+    Pressure level = levelFor(m_available, total, 0);
+    if (level < current)
+        level = qMin(current, levelFor(m_available, total, 25));
+
+    if (level != current) {
+        m_pressure.fetchAndStoreRelaxed(level);
+        m_pressureGauge->set(level);
+        if (level > current)
+            qWarning() << "内存压力升高到" << level << ": 可用" << m_available / 1024
+                       << "KB, 记账" << total / 1024 << "KB";
+        else
+            qDebug() << "内存压力降低到" << level;
+        emit pressureChanged(level);
+    }
+    emit checked();
+}
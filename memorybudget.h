@@ -0,0 +1,115 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QList>
+#include <QString>
+
+class QTimer;
+class MetricGauge;
+
+// 一个子系统的内存账户
+//
+// 子系统登记时给出预算，用量变化时 setUsage()（任意线程），并且自己保证不超出 limit()。
+// limit() 随压力变化：缓存在 Elevated 时减半、Critical 时为 0（全部丢弃，需要时重新读库）；
+// 缓冲区（查询结果、图表、日志）只在 Critical 时减半，超出的部分截断。
+class MemoryAccount
+{
+public:
+    enum Kind {
+        Cache = 0,
+        Buffer = 1
+    };
+
+    const QString &name() const { return m_name; }
+    Kind kind() const { return m_kind; }
+    int budget() const { return m_budget; }
+    int limit() const;
+
+    void setUsage(int bytes);
+    int usage() const { return m_usage; }
+    int peak() const { return m_peak; }
+
+private:
+    friend class MemoryBudget;
+    MemoryAccount(const QString &name, Kind kind, int budget);
+
+    QString m_name;
+    Kind m_kind;
+    int m_budget;
+    QAtomicInt m_usage;
+    QAtomicInt m_peak;
+    MetricGauge *m_usageGauge;
+    MetricGauge *m_peakGauge;
+};
+
+// 内存记账
+//
+// 各子系统的账户导出为 smarthome_memory_usage_bytes / smarthome_memory_peak_bytes /
+// smarthome_memory_budget_bytes{subsystem="..."}，界面的“内存”页列出同样的内容。
+// 界面线程里定时检查压力：系统可用内存（/proc/meminfo 的 MemAvailable，老内核上按
+// MemFree + Buffers + Cached 估计）和所有账户的用量之和，升降时发出 pressureChanged()，
+// 各子系统据此按新的 limit() 丢弃缓存、截断结果，赶在 OOM killer 之前。
+// 回到较低的级别需要留出 25% 的余量，避免在阈值附近来回切换。
+//
+// [memory] 下的配置（各账户自己的预算见登记处）：
+//   totalKB        账户用量之和的上限，超过 90% 为 Elevated、超过为 Critical，默认为预算之和
+//   lowFreeKB      系统可用内存低于此值为 Elevated，默认 8192
+//   criticalFreeKB 低于此值为 Critical，默认 4096
+//   checkSec       检查周期，默认 5
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+public:
+    enum Pressure {
+        Normal = 0,
+        Elevated = 1,
+        Critical = 2
+    };
+
+    static MemoryBudget *instance();
+
+    // 登记账户，同名重复登记时返回已有的账户（预算不变）；账户一直有效
+    MemoryAccount *account(const QString &name, MemoryAccount::Kind kind, int budgetBytes);
+    QList<MemoryAccount *> accounts() const;
+
+    Pressure pressure() const { return Pressure(int(m_pressure)); }
+    // 最近一次检查时系统的可用内存，-1 表示未知
+    qint64 availableBytes() const { return m_available; }
+    qint64 totalUsage() const;
+    qint64 totalLimit() const;
+
+    // 读取配置并开始定时检查，在界面线程调用一次
+    void start();
+
+    // QList<SensorData> 中一个元素的大致占用：节点指针、堆上的 SensorData 和 QDateTime 的私有数据
+    static int sampleBytes();
+
+signals:
+    void pressureChanged(int level);
+    // 每次检查之后，供界面刷新显示
+    void checked();
+
+public slots:
+    void check();
+
+private:
+    MemoryBudget();
+    qint64 readAvailable() const;
+    Pressure levelFor(qint64 available, qint64 total, int marginPercent) const;
+
+    mutable QMutex m_mutex;
+    QList<MemoryAccount *> m_accounts;
+    QAtomicInt m_pressure;
+    qint64 m_available;
+    qint64 m_totalKB;        // 0 表示按预算之和
+    qint64 m_lowFreeKB;
+    qint64 m_criticalFreeKB;
+    QTimer *m_timer;
+    MetricGauge *m_pressureGauge;
+    MetricGauge *m_availableGauge;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,320 @@
+#include "metrics.h"
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+static QString seriesName(const QString &name, const QString &suffix,
+                          const QString &labels, const QString &extra = QString())
+{
+    QString all = labels;
+    if (!extra.isEmpty()) {
+        if (!all.isEmpty()) all += ",";
+        all += extra;
+    }
+    if (all.isEmpty())
+        return name + suffix;
+    return name + suffix + "{" + all + "}";
+}
+
+// ============== 指标类型 ==============
+
+void MetricCounter::write(QTextStream &out, const QString &name, const QString &labels) const
+{
+    out << seriesName(name, QString(), labels) << " " << value() << "\n";
+}
+
+void MetricGauge::write(QTextStream &out, const QString &name, const QString &labels) const
+{
+    out << seriesName(name, QString(), labels) << " " << value() << "\n";
+}
+
+MetricHistogram::MetricHistogram(const QVector<int> &bounds, double scale)
+    : m_bounds(bounds)
+#ifdef METRICS_ATOMIC_SUM64
+    , m_sum(0)
+#endif
+    , m_scale(scale > 0 ? scale : 1.0)
+{
+    m_buckets = new QAtomicInt[m_bounds.size() + 1];
+}
+
+MetricHistogram::~MetricHistogram()
+{
+    delete [] m_buckets;
+}
+
+void MetricHistogram::observe(int v)
+{
+    int i = 0;
+    const int n = m_bounds.size();
+    while (i < n && v > m_bounds[i]) ++i;
+    m_buckets[i].ref();
+#ifdef METRICS_ATOMIC_SUM64
+    __sync_fetch_and_add(&m_sum, qint64(v));
+#else
+    // 观测值不为负；低位加上 v 后回绕时进位
+    quint32 add = quint32(qMax(0, v));
+    quint32 old = quint32(m_sumLow.fetchAndAddRelaxed(int(add)));
+    if (old + add < old)
+        m_sumHigh.ref();
+#endif
+}
+
+qint64 MetricHistogram::sum() const
+{
+#ifdef METRICS_ATOMIC_SUM64
+    return __sync_fetch_and_add(&m_sum, qint64(0));
+#else
+    // 高位在读低位前后不变时两者一致；进位还没加上的一瞬间可能少 2^32，下次导出即恢复
+    quint32 high, low;
+    do {
+        high = quint32(int(m_sumHigh));
+        low = quint32(int(m_sumLow));
+    } while (high != quint32(int(m_sumHigh)));
+    return (qint64(high) << 32) | low;
+#endif
+}
+
+quint32 MetricHistogram::count() const
+{
+    quint32 total = 0;
+    for (int i = 0; i <= m_bounds.size(); ++i)
+        total += quint32(int(m_buckets[i]));
+    return total;
+}
+
+int MetricHistogram::quantile(double q) const
+{
+    quint32 total = count();
+    if (total == 0)
+        return 0;
+    quint32 rank = quint32(q * total + 0.999999);
+    quint32 cumulative = 0;
+    for (int i = 0; i < m_bounds.size(); ++i) {
+        cumulative += quint32(int(m_buckets[i]));
+        if (cumulative >= rank)
+            return m_bounds[i];
+    }
+    return -1;
+}
+
+void MetricHistogram::write(QTextStream &out, const QString &name, const QString &labels) const
+{
+    // 桶内计数是非累积的，导出时再累加
+    quint32 cumulative = 0;
+    for (int i = 0; i < m_bounds.size(); ++i) {
+        cumulative += quint32(int(m_buckets[i]));
+        QString le = QString("le=\"%1\"").arg(m_bounds[i] / m_scale);
+        out << seriesName(name, "_bucket", labels, le) << " " << cumulative << "\n";
+    }
+    cumulative += quint32(int(m_buckets[m_bounds.size()]));
+    qint64 sum = this->sum();
+    out << seriesName(name, "_bucket", labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+    out << seriesName(name, "_sum", labels) << " "
+        << QString::number(sum / m_scale, 'g', 12) << "\n";
+    out << seriesName(name, "_count", labels) << " " << cumulative << "\n";
+}
+
+// ============== MetricsRegistry ==============
+
+MetricsRegistry::MetricsRegistry()
+    : m_startTime(QDateTime::currentDateTime().toTime_t())
+{
+    m_rssBytes = gauge("process_resident_memory_bytes", "Resident memory size in bytes.");
+    m_uptimeSeconds = gauge("smarthome_uptime_seconds", "Seconds since the process started.");
+}
+
+MetricsRegistry *MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+Metric *MetricsRegistry::find(Type type, const QString &name, const QString &labels) const
+{
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &e = m_entries[i];
+        if (e.type == type && e.name == name && e.labels == labels)
+            return e.metric;
+    }
+    return 0;
+}
+
+void MetricsRegistry::add(Type type, const QString &name, const QString &help,
+                          const QString &labels, Metric *metric)
+{
+    Entry e;
+    e.type = type;
+    e.name = name;
+    e.help = help;
+    e.labels = labels;
+    e.metric = metric;
+    m_entries.append(e);
+}
+
+MetricCounter *MetricsRegistry::counter(const QString &name, const QString &help,
+                                        const QString &labels)
+{
+    QMutexLocker locker(&m_mutex);
+    Metric *m = find(COUNTER, name, labels);
+    if (!m) {
+        m = new MetricCounter;
+        add(COUNTER, name, help, labels, m);
+    }
+    return static_cast<MetricCounter *>(m);
+}
+
+MetricGauge *MetricsRegistry::gauge(const QString &name, const QString &help,
+                                    const QString &labels)
+{
+    QMutexLocker locker(&m_mutex);
+    Metric *m = find(GAUGE, name, labels);
+    if (!m) {
+        m = new MetricGauge;
+        add(GAUGE, name, help, labels, m);
+    }
+    return static_cast<MetricGauge *>(m);
+}
+
+MetricHistogram *MetricsRegistry::histogram(const QString &name, const QString &help,
+                                            const QVector<int> &bounds, double scale,
+                                            const QString &labels)
+{
+    QMutexLocker locker(&m_mutex);
+    Metric *m = find(HISTOGRAM, name, labels);
+    if (!m) {
+        m = new MetricHistogram(bounds, scale);
+        add(HISTOGRAM, name, help, labels, m);
+    }
+    return static_cast<MetricHistogram *>(m);
+}
+
+void MetricsRegistry::refreshProcessGauges()
+{
+#ifdef __linux__
+    // /proc/self/statm 第二列是常驻页数
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1)
+            m_rssBytes->set(int(fields[1].toLong() * sysconf(_SC_PAGESIZE)));
+    }
+#endif
+    m_uptimeSeconds->set(int(QDateTime::currentDateTime().toTime_t() - m_startTime));
+}
+
+QByteArray MetricsRegistry::exposition()
+{
+    refreshProcessGauges();
+
+    QByteArray text;
+    QTextStream out(&text, QIODevice::WriteOnly);
+
+    QMutexLocker locker(&m_mutex);
+
+    // 同名指标（不同标签）归为一组，只输出一次 HELP/TYPE
+    QList<QString> done;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &head = m_entries[i];
+        if (done.contains(head.name)) continue;
+        done.append(head.name);
+
+        const char *type = head.type == COUNTER ? "counter"
+                         : head.type == GAUGE ? "gauge" : "histogram";
+        out << "# HELP " << head.name << " " << head.help << "\n";
+        out << "# TYPE " << head.name << " " << type << "\n";
+
+        for (int j = i; j < m_entries.size(); ++j) {
+            const Entry &e = m_entries[j];
+            if (e.name == head.name)
+                e.metric->write(out, e.name, e.labels);
+        }
+    }
+    out.flush();
+    return text;
+}
+
+// ============== 常用指标 ==============
+
+namespace Metrics {
+
+MetricCounter *samplesTotal()
+{
+    static MetricCounter *m = MetricsRegistry::instance()->counter(
+        "smarthome_samples_total", "Samples acquired from the sensor.");
+    return m;
+}
+
+MetricCounter *samplesDropped(const QString &reason)
+{
+    return MetricsRegistry::instance()->counter(
+        "smarthome_samples_dropped_total", "Samples that were acquired but not delivered or stored.",
+        QString("reason=\"%1\"").arg(reason));
+}
+
+MetricCounter *readFailures(const QString &channel)
+{
+    return MetricsRegistry::instance()->counter(
+        "smarthome_sensor_read_failures_total", "Failed sensor reads.",
+        QString("channel=\"%1\"").arg(channel));
+}
+
+MetricGauge *sampleIntervalMs()
+{
+    static MetricGauge *m = MetricsRegistry::instance()->gauge(
+        "smarthome_sample_interval_milliseconds", "Configured sampling interval.");
+    return m;
+}
+
+// 数据库提交耗时的桶边界，单位：微秒
+static QVector<int> commitLatencyBounds()
+{
+    QVector<int> bounds;
+    bounds << 500 << 1000 << 2500 << 5000 << 10000 << 25000
+           << 50000 << 100000 << 250000 << 500000 << 1000000;
+    return bounds;
+}
+
+MetricHistogram *dbCommitLatency()
+{
+    static MetricHistogram *m = MetricsRegistry::instance()->histogram(
+        "smarthome_db_commit_seconds", "Latency of database writes.",
+        commitLatencyBounds(), 1e6);
+    return m;
+}
+
+MetricGauge *dbSizeBytes()
+{
+    static MetricGauge *m = MetricsRegistry::instance()->gauge(
+        "smarthome_db_size_bytes", "Size of the sample database on disk.");
+    return m;
+}
+
+MetricCounter *chartRepaints()
+{
+    static MetricCounter *m = MetricsRegistry::instance()->counter(
+        "smarthome_ui_chart_repaints_total", "Chart paint events handled on the GUI thread.");
+    return m;
+}
+
+// 绘制一帧图表耗时的桶边界，单位：微秒
+static QVector<int> frameTimeBounds()
+{
+    QVector<int> bounds;
+    bounds << 1000 << 2500 << 5000 << 10000 << 16667 << 33333
+           << 50000 << 100000 << 250000;
+    return bounds;
+}
+
+MetricHistogram *chartFrameTime()
+{
+    static MetricHistogram *m = MetricsRegistry::instance()->histogram(
+        "smarthome_ui_chart_frame_seconds", "Time spent painting one chart.",
+        frameTimeBounds(), 1e6);
+    return m;
+}
+
+} // namespace Metrics
@@ -0,0 +1,147 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+    #define METRICS_ATOMIC_SUM64
+#endif
+#include <QVector>
+
+class QTextStream;
+
+// 运行状态指标（Prometheus 文本格式导出）
+//
+// 指标对象在启动时向 MetricsRegistry 注册一次，调用方保存返回的指针，
+// 之后在热路径上只做原子操作，不分配内存；标签值也在注册时确定，热路径上不查名字。
+// 计数器按 32 位无符号导出，回绕时 Prometheus 会按计数器重置处理。
+
+class Metric
+{
+public:
+    virtual ~Metric() {}
+    virtual void write(QTextStream &out, const QString &name, const QString &labels) const = 0;
+};
+
+// 单调递增计数器
+class MetricCounter : public Metric
+{
+public:
+    void inc() { m_value.ref(); }
+    void add(int n) { m_value.fetchAndAddRelaxed(n); }
+    quint32 value() const { return quint32(int(m_value)); }
+
+    void write(QTextStream &out, const QString &name, const QString &labels) const;
+
+private:
+    QAtomicInt m_value;
+};
+
+// 瞬时值，可增可减
+class MetricGauge : public Metric
+{
+public:
+    void set(int v) { m_value.fetchAndStoreRelaxed(v); }
+    void add(int n) { m_value.fetchAndAddRelaxed(n); }
+    int value() const { return m_value; }
+
+    void write(QTextStream &out, const QString &name, const QString &labels) const;
+
+private:
+    QAtomicInt m_value;
+};
+
+// 固定桶直方图
+// 观测值以整数单位（例如微秒）记录，导出时除以 scale 换算为基本单位（例如秒）。
+// 总和用 64 位累加（32 位的微秒数累计 35 分钟就会回绕）。Qt4 没有 64 位原子量：
+// 工具链支持 8 字节 __sync 原子操作时直接用它，否则拆成两个 32 位原子量，低位回绕时进位，
+// observe() 都只是原子加，不加锁。
+class MetricHistogram : public Metric
+{
+public:
+    MetricHistogram(const QVector<int> &bounds, double scale);
+    ~MetricHistogram();
+
+    void observe(int v);
+
+    quint32 count() const;
+    // q 分位数所在桶的上界（桶分辨率的估计）；落在最后的 +Inf 桶时返回 -1
+    int quantile(double q) const;
+
+    void write(QTextStream &out, const QString &name, const QString &labels) const;
+
+private:
+    QVector<int> m_bounds;
+    QAtomicInt *m_buckets;  // m_bounds.size() + 1 个桶，最后一个是 +Inf
+    qint64 sum() const;
+
+#ifdef METRICS_ATOMIC_SUM64
+    mutable volatile qint64 m_sum;
+#else
+    QAtomicInt m_sumLow;
+    QAtomicInt m_sumHigh;
+#endif
+    double m_scale;
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry *instance();
+
+    // 同名同标签重复注册时返回已有对象
+    MetricCounter *counter(const QString &name, const QString &help,
+                           const QString &labels = QString());
+    MetricGauge *gauge(const QString &name, const QString &help,
+                       const QString &labels = QString());
+    MetricHistogram *histogram(const QString &name, const QString &help,
+                               const QVector<int> &bounds, double scale,
+                               const QString &labels = QString());
+
+    // 生成完整的 Prometheus 文本
+    QByteArray exposition();
+
+private:
+    MetricsRegistry();
+
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry {
+        Type type;
+        QString name;
+        QString help;
+        QString labels;
+        Metric *metric;
+    };
+
+    Metric *find(Type type, const QString &name, const QString &labels) const;
+    void add(Type type, const QString &name, const QString &help,
+             const QString &labels, Metric *metric);
+    void refreshProcessGauges();
+
+    mutable QMutex m_mutex;
+    QList<Entry> m_entries;
+
+    MetricGauge *m_rssBytes;
+    MetricGauge *m_uptimeSeconds;
+    uint m_startTime;
+};
+
+// 常用指标，首次调用时注册
+namespace Metrics {
+    MetricCounter *samplesTotal();
+    // 按原因注册，调用方保存返回的指针
+    MetricCounter *samplesDropped(const QString &reason);
+    MetricCounter *readFailures(const QString &channel);
+    MetricGauge *sampleIntervalMs();
+    MetricHistogram *dbCommitLatency();
+    MetricGauge *dbSizeBytes();
+    MetricCounter *chartRepaints();
+    MetricHistogram *chartFrameTime();
+}
+
+#endif // METRICS_H
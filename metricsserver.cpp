@@ -0,0 +1,68 @@
+#include "metricsserver.h"
+#include "metrics.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDebug>
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent)
+{
+    m_server = new QLocalServer(this);
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+MetricsServer::~MetricsServer()
+{
+    m_server->close();
+}
+
+bool MetricsServer::listen(const QString &socketPath)
+{
+    // 有进程应答时不抢占它的套接字；连不上的是上次异常退出留下的文件，清理掉
+    QLocalSocket probe;
+    probe.connectToServer(socketPath);
+    if (probe.waitForConnected(200)) {
+        probe.abort();
+        qWarning() << "指标服务: 已有进程在" << socketPath << "导出指标，本进程不导出";
+        return false;
+    }
+    QLocalServer::removeServer(socketPath);
+
+    if (!m_server->listen(socketPath)) {
+        qWarning() << "指标服务监听失败:" << socketPath << m_server->errorString();
+        return false;
+    }
+    m_socketPath = socketPath;
+    qDebug() << "Metrics exported on" << socketPath;
+    return true;
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void MetricsServer::onReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) return;
+
+    QByteArray request = socket->readAll();
+    QByteArray body = MetricsRegistry::instance()->exposition();
+
+    if (request.startsWith("GET ")) {
+        QByteArray header = "HTTP/1.0 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                            "Connection: close\r\n\r\n";
+        socket->write(header);
+    }
+    socket->write(body);
+
+    // 每个连接只应答一次
+    disconnect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    socket->disconnectFromServer();
+}
@@ -0,0 +1,32 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QString>
+
+class QLocalServer;
+
+// 在本地 UNIX 套接字上导出 MetricsRegistry
+// 客户端发送 HTTP GET 时按 HTTP/1.0 应答，其他请求直接返回指标文本。
+// 例如：curl --unix-socket /tmp/smarthome-metrics.sock http://localhost/metrics
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject *parent = 0);
+    ~MetricsServer();
+
+    // 已有进程在 socketPath 上应答时返回 false，不删除它的套接字
+    bool listen(const QString &socketPath);
+    QString socketPath() const { return m_socketPath; }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    QLocalServer *m_server;
+    QString m_socketPath;
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,609 @@
+#include "monitorcore.h"
+#include "sensorthread.h"
+#include "sensorstorage.h"
+#include "alarmcontroller.h"
+#include "appsettings.h"
+#include "startupprofiler.h"
+#include "samplering.h"
+#include "sht11conversion.h"
+#include "channelregistry.h"
+#include "derivedchannels.h"
+#include "hottier.h"
+#include "memorybudget.h"
+#include "metrics.h"
+#include "replay.h"
+#include <QThread>
+#include <QStringList>
+#include <QDebug>
+
+MonitorCore::MonitorCore(Mode mode, QObject *parent)
+    : QObject(parent)
+    , m_mode(mode)
+    , m_sensorThread(0)
+    , m_ring(0)
+    , m_storageThread(0)
+    , m_writer(0)
+    , m_reader(0)
+    , m_reportedPreAlarm(0)
+    , m_firstSampleMarked(false)
+    , m_bus(0)
+    , m_hot(0)
+    , m_replay(0)
+    , m_pollTimer(0)
+    , m_lastId(0)
+    , m_intervalMs(1000)
+    , m_hasLastEmitted(false)
+{
+    qRegisterMetaType<SensorData>("SensorData");
+
+    m_alarm = new AlarmController(this);
+    configurePredictor();
+    m_bus = new SampleBus(this);
+    m_intervalMs = appSettings().value("sensor/intervalMs", 1000).toInt();
+
+    if (m_mode == ACQUIRE) {
+        m_sensorThread = new SensorThread(this);
+        m_sensorThread->setSampleBus(m_bus);
+        connect(m_sensorThread, SIGNAL(sampleIntervalChanged(QDateTime,int)),
+                this, SLOT(onSampleIntervalChanged(QDateTime,int)));
+
+        QSettings &settings = appSettings();
+        m_sensorThread->setSampleInterval(settings.value("sensor/intervalMs", 1000).toInt());
+        m_sensorThread->setConversionTimeout(settings.value("sensor/conversionTimeoutMs", 500).toInt());
+
+        // 默认沿用旧版公式；数据手册型号默认开启湿度温度补偿
+        QString model = settings.value("sensor/model", "legacy").toString();
+        m_sensorThread->setConversionProfile(
+            sht11Profile(model, settings.value("sensor/vdd", 0.0).toDouble()),
+            settings.value("sensor/compensateHumidity", model != "legacy").toBool());
+        const ChannelRegistry *channels = ChannelRegistry::instance();
+        for (int c = 0; c < channels->count(); ++c)
+            m_sensorThread->setFilterConfig(c, loadFilterConfig(channels->at(c).key));
+        m_sensorThread->setAdaptiveRate(loadAdaptiveRate());
+        m_sensorThread->setRealtime(loadRealtimeConfig());
+
+        if (settings.value("shm/enabled", true).toBool()) {
+            m_ring = new SampleRing;
+            if (m_ring->create(settings.value("shm/name", SAMPLERING_DEFAULT_NAME).toString(),
+                               settings.value("shm/capacity", 1024).toInt())) {
+                m_sensorThread->setSampleRing(m_ring);
+            }
+        }
+    } else if (m_mode == REPLAY) {
+        // 回放线程代替采集线程发布采样，其余和采集时相同
+        m_replay = new ReplayThread(this);
+        m_replay->setSampleBus(m_bus);
+        connect(m_replay, SIGNAL(sampleIntervalChanged(QDateTime,int)),
+                this, SLOT(onSampleIntervalChanged(QDateTime,int)));
+        connect(m_replay, SIGNAL(finished()), this, SLOT(onReplayFinished()));
+    }
+
+    if (m_mode != ATTACH) {
+        // 写库放在独立线程，打开数据库和建表不占用启动时间
+        m_storageThread = new QThread(this);
+        m_writer = new SensorStorage("writer");
+        applyStorageLayout(m_writer);
+        m_writer->setPersistencePolicy(loadPersistencePolicy());
+        applyDurability(m_writer);
+        m_writer->setSummaryGap(summaryGapMs());
+        m_writer->moveToThread(m_storageThread);
+        connect(this, SIGNAL(intervalChangeRequested(QDateTime,int)),
+                m_writer, SLOT(storeIntervalChange(QDateTime,int)));
+        connect(m_writer, SIGNAL(opened(bool)), this, SLOT(onStorageOpened(bool)));
+        connect(m_writer, SIGNAL(writeFailed(QString)), this, SLOT(onWriteFailed(QString)));
+
+        // 存储不能丢采样，队列满时让采集线程等待
+        SampleBus::Options storage;
+        storage.capacity = 1024;
+        storage.policy = SampleBus::Block;
+        subscribe("storage", m_writer, "storeBatch", storage);
+
+        // 报警在界面线程中处理，界面忙时不能让采集线程等它：队列放得下界面卡顿
+        // 十几分钟的采样，仍然满了才丢弃（smarthome_bus_dropped_total{subscriber="alarm"}）
+        SampleBus::Options alarm;
+        alarm.capacity = 1024;
+        alarm.policy = SampleBus::Drop;
+        subscribe("alarm", this, "onAlarmSamples", alarm);
+    } else {
+        m_pollTimer = new QTimer(this);
+        connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(onPollStore()));
+    }
+
+    // 内存压力升高时热层和历史查询缓存先让出内存
+    connect(MemoryBudget::instance(), SIGNAL(pressureChanged(int)),
+            this, SLOT(onMemoryPressure(int)));
+}
+
+// 退出时按顺序排空：先停生产者（采集线程等待当前采样发布完），再让总线把队列中的采样
+// 交给存储线程，然后补写保持值，最后在存储线程中提交内存中的采样并关闭数据库。
+// 存储线程按投递顺序处理，关闭一定排在前面的采样之后
+MonitorCore::~MonitorCore()
+{
+    if (m_sensorThread)
+        m_sensorThread->requestStop();
+    if (m_replay && m_replay->isRunning()) {
+        m_replay->requestStop();
+        m_replay->wait();
+    }
+    delete m_ring;
+    if (m_storageThread) {
+        if (m_storageThread->isRunning()) {
+            m_bus->flush();
+            flushPendingSample();
+            // 连接必须在打开它的线程里关闭
+            QMetaObject::invokeMethod(m_writer, "close", Qt::BlockingQueuedConnection);
+            m_storageThread->quit();
+            m_storageThread->wait();
+        }
+        const PersistencePolicy &persist = m_writer->persistencePolicy();
+        if (persist.isEnabled()) {
+            log(QString(tr("持久化: 采样 %1 个，写入 %2 个，压缩比 %3:1"))
+                .arg(persist.offered()).arg(persist.stored())
+                .arg(persist.compressionRatio(), 0, 'f', 1));
+        }
+        delete m_writer;
+    }
+}
+
+bool MonitorCore::start(const QString &dbPath)
+{
+    m_dbPath = dbPath;
+
+    if (m_mode != ATTACH) {
+        m_storageThread->start();
+        QMetaObject::invokeMethod(m_writer, "open", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_dbPath), Q_ARG(bool, false));
+        if (m_sensorThread)
+            m_sensorThread->start();
+        if (m_replay)
+            m_replay->start();
+        return true;
+    }
+
+    if (!reader()->isOpen()) {
+        log(tr("无法打开数据库!"));
+        return false;
+    }
+    // 从附加时刻开始跟随，不回放已有数据
+    m_lastId = m_reader->maxId();
+    m_pollTimer->start(1000);
+    return true;
+}
+
+void MonitorCore::startCollection()
+{
+    if (m_sensorThread)
+        m_sensorThread->startCollection();
+}
+
+void MonitorCore::stopCollection()
+{
+    if (m_sensorThread) {
+        m_sensorThread->stopCollection();
+        flushPendingSample();
+    }
+}
+
+bool MonitorCore::isCollecting() const
+{
+    if (m_sensorThread)
+        return m_sensorThread->isCollecting();
+    if (m_replay)
+        return m_replay->isRunning();
+    return m_pollTimer && m_pollTimer->isActive();
+}
+
+void MonitorCore::enableHotTier()
+{
+    // 窗口和内存上限只在创建时读取，hot/windowHours 为 0 时关闭
+    int hotHours = appSettings().value("hot/windowHours", 24).toInt();
+    if (m_hot || hotHours <= 0)
+        return;
+    m_hot = new HotTier(hotHours, appSettings().value("hot/maxKB", 4096).toInt() * 1024, this);
+    m_hot->setPersistencePolicy(loadPersistencePolicy());
+    if (m_reader)
+        m_reader->setHotTier(m_hot);
+
+    // 在界面线程，满了丢弃而不是让采集线程等待
+    SampleBus::Options hot;
+    hot.capacity = 4096;
+    hot.policy = SampleBus::Drop;
+    subscribe("hot", m_hot, "append", hot);
+}
+
+SensorStorage *MonitorCore::reader()
+{
+    if (!m_reader) {
+        m_reader = new SensorStorage(m_mode == ATTACH ? "follower" : "reader", this);
+        applyStorageLayout(m_reader);
+        // 历史查询结果按天缓存，history/cacheKB 为 0 时不缓存
+        m_reader->setCacheBudget(appSettings().value("history/cacheKB", 8192).toInt() * 1024);
+        m_reader->setHotTier(m_hot);
+        m_reader->setSummaryGap(summaryGapMs());
+        m_reader->open(m_dbPath, true);
+    }
+    return m_reader;
+}
+
+// [realtime] policy、priority、cpu、lockMemory、jitterLimitUs、jitterReportSec，见 realtime.h
+RealtimeConfig MonitorCore::loadRealtimeConfig()
+{
+    RealtimeConfig config;
+    QSettings &settings = appSettings();
+    settings.beginGroup("realtime");
+    config.policy = settings.value("policy", config.policy).toString().toLower();
+    config.priority = settings.value("priority", config.policy == "other" ? 0 : 50).toInt();
+    config.cpu = settings.value("cpu", config.cpu).toInt();
+    config.lockMemory = settings.value("lockMemory", config.lockMemory).toBool();
+    config.jitterLimitUs = settings.value("jitterLimitUs", config.jitterLimitUs).toInt();
+    config.jitterReportSec = settings.value("jitterReportSec", config.jitterReportSec).toInt();
+    settings.endGroup();
+    return config;
+}
+
+qint64 MonitorCore::summaryGapMs()
+{
+    QSettings &settings = appSettings();
+    int heartbeat = settings.value("persist/heartbeatSec", 300).toInt();
+    return qint64(settings.value("history/maxGapSec", 2 * heartbeat).toInt()) * 1000;
+}
+
+void MonitorCore::subscribe(const QString &name, QObject *receiver, const char *method,
+                            const SampleBus::Options &defaults)
+{
+    SampleBus::Options options = defaults;
+    QSettings &settings = appSettings();
+    settings.beginGroup("bus/" + name);
+    options.batchSize = settings.value("batchSize", options.batchSize).toInt();
+    options.maxLatencyMs = settings.value("maxLatencyMs", options.maxLatencyMs).toInt();
+    options.capacity = settings.value("capacity", options.capacity).toInt();
+    QString policy = settings.value("policy").toString();
+    if (policy == "drop")
+        options.policy = SampleBus::Drop;
+    else if (policy == "coalesce")
+        options.policy = SampleBus::CoalesceLatest;
+    else if (policy == "block")
+        options.policy = SampleBus::Block;
+    settings.endGroup();
+
+    m_bus->subscribe(name, receiver, method, options);
+}
+
+void MonitorCore::onAlarmSamples(const SensorDataList &samples)
+{
+    if (!m_firstSampleMarked) {
+        StartupProfiler::mark("first_sample");
+        m_firstSampleMarked = true;
+    }
+
+    for (int i = 0; i < samples.size(); ++i)
+        evaluateAlarm(samples.at(i));
+}
+
+void MonitorCore::onSampleIntervalChanged(const QDateTime &at, int intervalMs)
+{
+    if (intervalMs != m_intervalMs)
+        log(QString(tr("采样周期: %1 ms")).arg(intervalMs));
+    m_intervalMs = intervalMs;
+    emit intervalChangeRequested(at, intervalMs);
+}
+
+void MonitorCore::onPollStore()
+{
+    QList<SensorData> rows;
+    if (!m_reader->fetchSince(m_lastId, &rows, &m_lastId)) {
+        log(tr("读取数据失败: ") + m_reader->lastError());
+        return;
+    }
+    if (rows.isEmpty())
+        return;
+
+    // 采集端可能启用了自适应周期，补阶梯时使用当前生效的周期
+    int interval = m_reader->intervalAt(rows.last().timestamp);
+    if (interval > 0)
+        m_intervalMs = interval;
+    // 数据库中是阶梯序列（见 PersistencePolicy），两条记录之间补出保持值；
+    // 和历史查询（SensorStorage::expandSteps()）一样，超过 maxGap 的间隔是中断，不补
+    qint64 maxGap = summaryGapMs();
+    for (int i = 0; i < rows.size(); ++i) {
+        if (m_hasLastEmitted && m_lastEmitted.timestamp.msecsTo(rows[i].timestamp) <= maxGap) {
+            QList<SensorData> held;
+            PersistencePolicy::fillSteps(m_lastEmitted, rows[i], m_intervalMs, &held);
+            for (int k = 0; k < held.size(); ++k)
+                m_bus->publish(held[k]);
+        }
+        m_bus->publish(rows[i]);
+        m_lastEmitted = rows[i];
+        m_hasLastEmitted = true;
+    }
+}
+
+void MonitorCore::onStorageOpened(bool ok)
+{
+    if (ok) {
+        StartupProfiler::mark("storage_ready");
+    } else {
+        log(tr("无法打开数据库!"));
+    }
+}
+
+void MonitorCore::onWriteFailed(const QString &error)
+{
+    log(tr("保存数据失败: ") + error);
+}
+
+void MonitorCore::setReplaySource(const QString &path, qint64 fromMs, qint64 toMs, double speed)
+{
+    if (!m_replay)
+        return;
+    SensorStorage *source = new SensorStorage("replay");
+    applyStorageLayout(source);
+    m_replay->setSource(source, path);
+    m_replay->setRange(fromMs, toMs);
+    m_replay->setSpeed(speed);
+    m_replay->setMaxGap(summaryGapMs());
+}
+
+void MonitorCore::onReplayFinished()
+{
+    // 写库的队列排在补写之后，等它处理完再取统计
+    QMetaObject::invokeMethod(m_writer, "flushPending", Qt::BlockingQueuedConnection);
+
+    const ReplayThread::Report &report = m_replay->report();
+    if (!report.ok)
+        log(tr("回放失败: ") + report.error);
+    double seconds = qMax(qint64(1), report.elapsedMs) / 1000.0;
+    double span = report.lastMs > report.firstMs ? (report.lastMs - report.firstMs) / 1000.0 : 0;
+    log(QString(tr("回放: 读出 %1 条记录，发布 %2 个采样，用时 %3 秒（%4 个/秒，%5 倍速），最多落后 %6 ms"))
+        .arg(report.rows).arg(report.published).arg(seconds, 0, 'f', 1)
+        .arg(qRound64(report.published / seconds)).arg(span / seconds, 0, 'f', 0)
+        .arg(report.maxBehindMs));
+
+    QList<SampleBus::SubscriberStats> stats = m_bus->stats();
+    for (int i = 0; i < stats.size(); ++i) {
+        const SampleBus::SubscriberStats &s = stats.at(i);
+        log(QString(tr("回放: %1 收到 %2 个（%3 批），丢弃 %4，合并 %5，最长队列 %6，"
+                       "最长延迟 %7 ms，处理一批平均 %8 ms、最长 %9 ms"))
+            .arg(s.name).arg(s.delivered).arg(s.batches).arg(s.dropped).arg(s.coalesced)
+            .arg(s.peakDepth).arg(s.lagNsMax / 1000000)
+            .arg(s.batches > 0 ? s.handlerNsTotal / s.batches / 1e6 : 0.0, 0, 'f', 2)
+            .arg(s.handlerNsMax / 1e6, 0, 'f', 2));
+    }
+
+    // 图表只在界面进程中绘制；分位数按桶的上界估计
+    MetricHistogram *frames = Metrics::chartFrameTime();
+    if (frames->count() > 0) {
+        int p50 = frames->quantile(0.5);
+        int p99 = frames->quantile(0.99);
+        log(QString(tr("回放: 图表绘制 %1 帧，P50 <= %2，P99 <= %3"))
+            .arg(frames->count())
+            .arg(p50 < 0 ? tr("超出范围") : QString("%1 ms").arg(p50 / 1000.0))
+            .arg(p99 < 0 ? tr("超出范围") : QString("%1 ms").arg(p99 / 1000.0)));
+    }
+    emit replayFinished();
+}
+
+void MonitorCore::onMemoryPressure(int level)
+{
+    if (m_hot)
+        m_hot->applyMemoryLimit();
+    if (m_reader)
+        m_reader->applyMemoryLimit();
+    if (level == MemoryBudget::Critical)
+        log(tr("内存不足，已丢弃历史缓存"));
+}
+
+void MonitorCore::log(const QString &text)
+{
+    // 无界面模式下日志只能从控制台看到
+    qDebug() << text;
+    emit logMessage(text);
+}
+
+// persist/deadband/<通道>：死区，0 表示每个采样都写入
+// persist/heartbeatSec：即使没有变化也至少每隔多久写入一次
+PersistencePolicy MonitorCore::loadPersistencePolicy()
+{
+    PersistencePolicy persist;
+    QSettings &settings = appSettings();
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    for (int c = 0; c < channels->count(); ++c) {
+        persist.setDeadband(c, settings.value("persist/deadband/" + channels->at(c).key,
+                                              0.0).toDouble());
+    }
+    persist.setHeartbeat(settings.value("persist/heartbeatSec", 300).toInt());
+    return persist;
+}
+
+// adaptive/enabled 开启后采样周期在 [minIntervalMs, maxIntervalMs] 内随信号活动调整
+// 各通道阈值：adaptive/rate/<通道>（单位/秒）、adaptive/stdDev/<通道>
+AdaptiveRateConfig MonitorCore::loadAdaptiveRate()
+{
+    AdaptiveRateConfig c;
+    QSettings &settings = appSettings();
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    settings.beginGroup("adaptive");
+    c.enabled = settings.value("enabled", c.enabled).toBool();
+    c.minIntervalMs = settings.value("minIntervalMs", c.minIntervalMs).toInt();
+    c.maxIntervalMs = settings.value("maxIntervalMs", c.maxIntervalMs).toInt();
+    c.settleSamples = settings.value("settleSamples", c.settleSamples).toInt();
+    for (int i = 0; i < channels->count(); ++i) {
+        const QString &key = channels->at(i).key;
+        c.rateThreshold[i] = settings.value("rate/" + key, c.rateThreshold[i]).toDouble();
+        c.stdDevThreshold[i] = settings.value("stdDev/" + key, c.stdDevThreshold[i]).toDouble();
+    }
+    settings.endGroup();
+    return c;
+}
+
+// 停止采集时补写最后一个死区内的采样，阶梯序列在停止时刻结束
+// 在存储线程中执行，排在已经投递给存储的采样之后
+void MonitorCore::flushPendingSample()
+{
+    QMetaObject::invokeMethod(m_writer, "flushPending", Qt::QueuedConnection);
+}
+
+// storage/layout: rows（默认）| chunked，守护进程和附加的界面进程读同一份配置
+void MonitorCore::applyStorageLayout(SensorStorage *storage)
+{
+    QSettings &settings = appSettings();
+    if (settings.value("storage/layout", "rows").toString() != "chunked")
+        return;
+    storage->setLayout(SensorStorage::ChunkedLayout,
+                       settings.value("storage/chunkMinutes", 60).toInt(),
+                       settings.value("storage/chunkFlushSamples", 60).toInt());
+}
+
+// storage/durability: sync（默认）| group | buffered（见 SensorStorage::Durability）
+// storage/groupCommitMs：group 的提交周期，默认 1000；storage/checkpointSec：buffered 的写入周期，默认 60
+// 在 applyStorageLayout() 和设置死区策略之后调用，丢失窗口和它们有关
+void MonitorCore::applyDurability(SensorStorage *storage)
+{
+    QSettings &settings = appSettings();
+    AdaptiveRateConfig adaptive = loadAdaptiveRate();
+    storage->setSampleInterval(adaptive.enabled ? adaptive.maxIntervalMs
+                                                : settings.value("sensor/intervalMs", 1000).toInt());
+    QString mode = settings.value("storage/durability", "sync").toString();
+    if (mode == "group") {
+        storage->setDurability(SensorStorage::GroupCommit,
+                               settings.value("storage/groupCommitMs", 1000).toInt());
+    } else if (mode == "buffered") {
+        storage->setDurability(SensorStorage::Buffered,
+                               settings.value("storage/checkpointSec", 60).toInt() * 1000);
+    } else {
+        if (mode != "sync")
+            qWarning() << "未知的 storage/durability:" << mode << "，按 sync 处理";
+        storage->setDurability(SensorStorage::SyncEach, 0);
+    }
+    if (storage->lossWindowMs() > 0)
+        log(QString(tr("持久化级别: %1，断电最多丢失约 %2 ms 的采样"))
+            .arg(mode).arg(storage->lossWindowMs()));
+}
+
+// 滤波配置：[filter/<通道>] 下的 spike/median/ewma/kalman/clamp 等键，默认全部关闭
+ChannelFilterConfig MonitorCore::loadFilterConfig(const QString &channel)
+{
+    ChannelFilterConfig c;
+    QSettings &settings = appSettings();
+    settings.beginGroup("filter/" + channel);
+    c.spikeEnabled = settings.value("spike", c.spikeEnabled).toBool();
+    c.spikeMaxStep = settings.value("spikeMaxStep", c.spikeMaxStep).toFloat();
+    c.spikeMaxRejects = settings.value("spikeMaxRejects", c.spikeMaxRejects).toInt();
+    c.medianWindow = settings.value("median", c.medianWindow).toInt();
+    c.ewmaEnabled = settings.value("ewma", c.ewmaEnabled).toBool();
+    c.ewmaAlpha = settings.value("ewmaAlpha", c.ewmaAlpha).toFloat();
+    c.kalmanEnabled = settings.value("kalman", c.kalmanEnabled).toBool();
+    c.kalmanQ = settings.value("kalmanQ", c.kalmanQ).toFloat();
+    c.kalmanR = settings.value("kalmanR", c.kalmanR).toFloat();
+    c.clampEnabled = settings.value("clamp", c.clampEnabled).toBool();
+    c.clampMin = settings.value("clampMin", c.clampMin).toFloat();
+    c.clampMax = settings.value("clampMax", c.clampMax).toFloat();
+    settings.endGroup();
+    return c;
+}
+
+// 逐个检查注册表中启用了报警的通道，日志列出所有越限的通道
+// 派生通道只有配置了报警阈值时才在这里算出
+void MonitorCore::evaluateAlarm(const SensorData &sample)
+{
+    if (m_alarm->isAlarming() && !m_predictor.isEnabled())
+        return;
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 derived = 0;
+    for (int c = 0; c < channels->count(); ++c) {
+        if (channels->at(c).isDerived() && channels->at(c).alarmEnabled)
+            derived |= 1u << c;
+    }
+    SensorData withDerived;
+    if (derived) {
+        withDerived = sample;
+        DerivedChannels::evaluate(&withDerived, derived);
+    }
+    const SensorData &data = derived ? withDerived : sample;
+
+    // 报警期间趋势也要跟着更新，否则报警结束后窗口里是旧数据
+    if (m_predictor.isEnabled())
+        reportPrediction(m_predictor.update(data));
+    if (m_alarm->isAlarming())
+        return;
+
+    QStringList outOfRange;
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        if (!info.alarmEnabled || !data.has(c))
+            continue;
+        double v = data.value(c);
+        if (v > info.alarmMax || v < info.alarmMin)
+            outOfRange << info.name + ":" + info.format(v) + info.unit;
+    }
+
+    if (!outOfRange.isEmpty()) {
+        m_alarm->triggerAlarm();
+        log(tr("报警: ") + outOfRange.join(" "));
+    }
+}
+
+// 配置预警，同时取好各通道的指标，每个采样不再按名字查找
+void MonitorCore::configurePredictor()
+{
+    m_predictor.configure(loadPredictorConfig());
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    MetricsRegistry *metrics = MetricsRegistry::instance();
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        m_crossingGauge[c] = 0;
+        m_preAlarmCounter[c] = 0;
+        if (!m_predictor.isEnabled() || c >= channels->count() || !channels->at(c).alarmEnabled)
+            continue;
+        QString labels = QString("channel=\"%1\"").arg(channels->at(c).key);
+        // 没有预警时为 -1，便于按阈值告警
+        m_crossingGauge[c] = metrics->gauge("smarthome_predicted_crossing_seconds",
+                                            "Projected seconds until the alarm threshold is crossed "
+                                            "while a pre-alarm is active, -1 otherwise.", labels);
+        m_crossingGauge[c]->set(-1);
+        m_preAlarmCounter[c] = metrics->counter("smarthome_prealarms_total",
+                                                "Pre-alarms raised from trend extrapolation.", labels);
+    }
+}
+
+void MonitorCore::reportPrediction(quint32 raised)
+{
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 preAlarm = m_predictor.preAlarmMask();
+    quint32 changed = preAlarm | m_reportedPreAlarm;
+    m_reportedPreAlarm = preAlarm;
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        if (!(changed & (1u << c)) || !m_crossingGauge[c])
+            continue;
+        const TrendPredictor::Prediction &p = m_predictor.prediction(c);
+        m_crossingGauge[c]->set(preAlarm & (1u << c) ? qRound(p.secondsToCross) : -1);
+        if (!(raised & (1u << c)))
+            continue;
+
+        m_preAlarmCounter[c]->inc();
+        log(QString(tr("预警: %1 %2%3，按当前趋势约 %4 分钟后%5 %6%3"))
+            .arg(info.name).arg(info.format(p.level)).arg(info.unit)
+            .arg(qMax(1, qRound(p.secondsToCross / 60)))
+            .arg(p.upper ? tr("高于") : tr("低于"))
+            .arg(info.format(p.upper ? info.alarmMax : info.alarmMin)));
+    }
+}
+
+// [predict] 下的配置，enabled=false 时关闭预警
+TrendPredictorConfig MonitorCore::loadPredictorConfig()
+{
+    TrendPredictorConfig c;
+    QSettings &settings = appSettings();
+    settings.beginGroup("predict");
+    c.enabled = settings.value("enabled", c.enabled).toBool();
+    c.windowSec = settings.value("windowSec", c.windowSec).toInt();
+    c.horizonSec = settings.value("horizonSec", c.horizonSec).toInt();
+    c.minSamples = settings.value("minSamples", c.minSamples).toInt();
+    c.minSpanSec = settings.value("minSpanSec", c.minSpanSec).toInt();
+    c.minR2 = settings.value("minR2", c.minR2).toDouble();
+    c.maxSamples = settings.value("maxSamples", c.maxSamples).toInt();
+    settings.endGroup();
+    return c;
+}
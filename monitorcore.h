@@ -0,0 +1,129 @@
+#ifndef MONITORCORE_H
+#define MONITORCORE_H
+
+#include <QObject>
+#include <QTimer>
+#include "sensordata.h"
+#include "samplefilter.h"
+#include "persistencepolicy.h"
+#include "adaptiverate.h"
+#include "realtime.h"
+#include "samplebus.h"
+#include "trendpredictor.h"
+
+class QThread;
+class SensorThread;
+class SensorStorage;
+class AlarmController;
+class SampleRing;
+class HotTier;
+class ReplayThread;
+class MetricGauge;
+class MetricCounter;
+
+// 采集、报警判断和存储，不依赖任何界面组件
+// 图形界面和无界面守护进程共用这一层。
+//
+// 采样发布到 SampleBus，存储（存储线程）、报警（本线程）和界面等消费者各自订阅，
+// 新增消费者只需调用 subscribe()。有界面时最近的采样另外订阅到内存热层（enableHotTier()），
+// 供 reader() 查询最近的历史。
+class MonitorCore : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode {
+        ACQUIRE = 0,    // 本进程读传感器并写数据库
+        ATTACH = 1,     // 附加到守护进程维护的数据库，只跟随新数据
+        REPLAY = 2      // 回放数据库中的历史代替采集，写入另一个数据库（见 replay.h）
+    };
+
+    explicit MonitorCore(Mode mode, QObject *parent = 0);
+    ~MonitorCore();
+
+    // 数据库在存储线程中打开，不阻塞调用者；回放模式下 dbPath 是写入的临时数据库
+    bool start(const QString &dbPath);
+
+    // 回放模式：start() 之前设置源数据库、时间范围 [fromMs, toMs) 和倍速。
+    // 回放结束后在日志中报告各订阅者的情况，然后发出 replayFinished()
+    void setReplaySource(const QString &path, qint64 fromMs, qint64 toMs, double speed);
+
+    Mode mode() const { return m_mode; }
+    bool canControlCollection() const { return m_mode == ACQUIRE; }
+
+    void startCollection();
+    void stopCollection();
+    bool isCollecting() const;
+
+    // 供界面线程查询历史数据的连接，首次调用时打开
+    SensorStorage *reader();
+    // 界面调用：创建内存热层（hottier.h）并订阅总线，reader() 查询最近的历史不访问数据库。
+    // 无界面的守护进程不查询历史，不创建
+    void enableHotTier();
+
+    SampleBus *bus() const { return m_bus; }
+
+    // 统计中一个值最长的保持时间：history/maxGapSec，默认为心跳间隔的两倍
+    static qint64 summaryGapMs();
+
+    // 趋势预警的配置，[predict] 下（见 trendpredictor.h）
+    static TrendPredictorConfig loadPredictorConfig();
+
+    // 订阅采样总线；配置 [bus/<name>] 下的 batchSize、maxLatencyMs、capacity、
+    // policy（drop|coalesce|block）覆盖 defaults
+    void subscribe(const QString &name, QObject *receiver, const char *method,
+                   const SampleBus::Options &defaults);
+
+signals:
+    void logMessage(const QString &text);
+    void intervalChangeRequested(const QDateTime &at, int intervalMs);
+    void replayFinished();
+
+private slots:
+    void onAlarmSamples(const SensorDataList &samples);
+    void onSampleIntervalChanged(const QDateTime &at, int intervalMs);
+    void onPollStore();
+    void onStorageOpened(bool ok);
+    void onWriteFailed(const QString &error);
+    void onMemoryPressure(int level);
+    void onReplayFinished();
+
+private:
+    void log(const QString &text);
+    ChannelFilterConfig loadFilterConfig(const QString &channel);
+    void applyStorageLayout(SensorStorage *storage);
+    void applyDurability(SensorStorage *storage);
+    PersistencePolicy loadPersistencePolicy();
+    AdaptiveRateConfig loadAdaptiveRate();
+    RealtimeConfig loadRealtimeConfig();
+    void flushPendingSample();
+    void evaluateAlarm(const SensorData &data);
+    void configurePredictor();
+    void reportPrediction(quint32 raised);
+
+    Mode m_mode;
+    QString m_dbPath;
+    SensorThread *m_sensorThread;
+    SampleRing *m_ring;         // 共享内存发布，供本机其他进程读取
+    QThread *m_storageThread;
+    SensorStorage *m_writer;    // 运行在 m_storageThread 中
+    SensorStorage *m_reader;    // 运行在界面线程中
+    AlarmController *m_alarm;
+    TrendPredictor m_predictor; // 报警之前的趋势预警，和报警在同一线程
+    quint32 m_reportedPreAlarm; // 上次导出指标时处于预警的通道
+    // 预警的指标，按通道下标；未启用报警的通道为 0
+    MetricGauge *m_crossingGauge[SensorData::MAX_CHANNELS];
+    MetricCounter *m_preAlarmCounter[SensorData::MAX_CHANNELS];
+    bool m_firstSampleMarked;   // 启动计时的 first_sample 已经记录
+    SampleBus *m_bus;
+    HotTier *m_hot;             // 界面线程，最近采样的内存副本，只在有界面时创建
+    ReplayThread *m_replay;     // 回放模式下代替采集线程
+
+    // 附加模式：轮询数据库中的新记录，按阶梯补出未写入的采样
+    QTimer *m_pollTimer;
+    qint64 m_lastId;
+    int m_intervalMs;
+    bool m_hasLastEmitted;
+    SensorData m_lastEmitted;
+};
+
+#endif // MONITORCORE_H
@@ -0,0 +1,107 @@
+#include "persistencepolicy.h"
+#include "metrics.h"
+#include <QtGlobal>
+
+PersistencePolicy::PersistencePolicy()
+    : m_heartbeatMs(300 * 1000)
+    , m_hasLast(false)
+    , m_hasPending(false)
+    , m_offered(0)
+    , m_stored(0)
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_deadband[c] = 0.0;
+
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_persisted = registry->counter("smarthome_samples_persisted_total",
+                                    "Samples written to storage by the persistence policy.");
+    m_suppressed = registry->counter("smarthome_samples_suppressed_total",
+                                     "Samples within the deadband that were not written.");
+}
+
+void PersistencePolicy::setDeadband(int channel, double deadband)
+{
+    if (channel >= 0 && channel < SensorData::MAX_CHANNELS)
+        m_deadband[channel] = qMax(0.0, deadband);
+}
+
+void PersistencePolicy::setHeartbeat(int seconds)
+{
+    m_heartbeatMs = qint64(qMax(1, seconds)) * 1000;
+}
+
+bool PersistencePolicy::isEnabled() const
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (m_deadband[c] > 0.0)
+            return true;
+    }
+    return false;
+}
+
+bool PersistencePolicy::differs(const SensorData &last, const SensorData &data) const
+{
+    if (!isEnabled() || data.channelMask != last.channelMask
+        || last.timestamp.msecsTo(data.timestamp) >= m_heartbeatMs)
+        return true;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (data.has(c) && qAbs(data.value(c) - last.value(c)) > m_deadband[c])
+            return true;
+    }
+    return false;
+}
+
+bool PersistencePolicy::accept(const SensorData &data)
+{
+    ++m_offered;
+
+    bool store = !m_hasLast || differs(m_last, data);
+
+    if (!store) {
+        m_hasPending = true;
+        m_pending = data;
+        m_suppressed->inc();
+        return false;
+    }
+
+    m_hasLast = true;
+    m_last = data;
+    m_hasPending = false;
+    ++m_stored;
+    m_persisted->inc();
+    return true;
+}
+
+SensorData PersistencePolicy::takePending()
+{
+    m_hasPending = false;
+    m_last = m_pending;
+    ++m_stored;
+    m_persisted->inc();
+    return m_pending;
+}
+
+double PersistencePolicy::compressionRatio() const
+{
+    return m_stored > 0 ? double(m_offered) / double(m_stored) : 1.0;
+}
+
+void PersistencePolicy::fillSteps(const SensorData &previous, const SensorData &next,
+                                  int intervalMs, QList<SensorData> *out, int maxSamples)
+{
+    if (intervalMs <= 0)
+        return;
+
+    qint64 gap = previous.timestamp.msecsTo(next.timestamp);
+    if (gap <= intervalMs * 3 / 2)
+        return;
+
+    // 只补最靠近 next 的部分，长时间断开后不一次补出过多采样
+    qint64 steps = (gap - intervalMs / 2) / intervalMs;
+    qint64 first = qMax(qint64(1), steps - maxSamples + 1);
+    for (qint64 k = first; k <= steps; ++k) {
+        SensorData held = previous;
+        held.timestamp = previous.timestamp.addMSecs(k * intervalMs);
+        out->append(held);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef PERSISTENCEPOLICY_H
+#define PERSISTENCEPOLICY_H
+
+#include <QList>
+#include "sensordata.h"
+
+class MetricCounter;
+
+// 采样持久化策略：死区 + 心跳
+//
+// 只有当某个通道与上一次写入的值相差超过该通道的死区、出现或缺少了某个通道，
+// 或距上一次写入超过心跳间隔时才写入数据库。未写入的采样都在上一次写入值的死区内，因此把存储的序列看作
+// 阶梯（每个值保持到下一条记录）即可还原，误差不超过死区。
+// 所有通道死区为 0 时不做过滤，每个采样都写入（默认）。
+class PersistencePolicy
+{
+public:
+    PersistencePolicy();
+
+    // channel 为 ChannelRegistry 中的下标
+    void setDeadband(int channel, double deadband);
+    void setHeartbeat(int seconds);
+    qint64 heartbeatMs() const { return m_heartbeatMs; }
+    bool isEnabled() const;
+
+    // 判断是否写入；返回 true 时记为最后写入的值
+    bool accept(const SensorData &data);
+    // 上一次写入的是 last 时 data 是否要写入；不改变状态、不计数（热层按同样的阶梯保存）
+    bool differs(const SensorData &last, const SensorData &data) const;
+
+    // 停止采集或退出时补写最后一个未写入的采样，让阶梯序列的结尾准确
+    bool hasPending() const { return m_hasPending; }
+    SensorData takePending();
+
+    quint64 offered() const { return m_offered; }
+    quint64 stored() const { return m_stored; }
+    // 采样数 / 写入数
+    double compressionRatio() const;
+
+    // 在 previous 和 next 之间按 intervalMs 补出保持 previous 值的采样（阶梯还原）。
+    // 间隔不超过 1.5 个周期时不补，最多补 maxSamples 个
+    static void fillSteps(const SensorData &previous, const SensorData &next,
+                          int intervalMs, QList<SensorData> *out, int maxSamples = 3600);
+
+private:
+    double m_deadband[SensorData::MAX_CHANNELS];
+    qint64 m_heartbeatMs;
+
+    bool m_hasLast;
+    SensorData m_last;
+    bool m_hasPending;
+    SensorData m_pending;
+
+    quint64 m_offered;
+    quint64 m_stored;
+    MetricCounter *m_persisted;
+    MetricCounter *m_suppressed;
+};
+
+#endif // PERSISTENCEPOLICY_H
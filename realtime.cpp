@@ -0,0 +1,190 @@
+#include "realtime.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+#ifdef __linux__
+    #include <sched.h>
+    #include <time.h>
+    #include <errno.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+#endif
+
+// 抖动的桶边界，单位：微秒
+static QVector<int> jitterBounds()
+{
+    QVector<int> bounds;
+    bounds << 50 << 100 << 200 << 500 << 1000 << 2000 << 5000
+           << 10000 << 20000 << 50000 << 100000 << 500000;
+    return bounds;
+}
+
+#ifndef __linux__
+// Qt4 的 QThread::msleep() 是受保护的
+class Sleeper : public QThread
+{
+public:
+    static void sleepMs(qint64 ms) { msleep((unsigned long)ms); }
+};
+#endif
+
+namespace Realtime {
+
+#ifdef __linux__
+// 预先触及一段栈，锁定内存时这些页一起被锁住，采集时不会因缺页而停顿
+static void prefaultStack()
+{
+    volatile char stack[64 * 1024];
+    memset(const_cast<char *>(stack), 0, sizeof(stack));
+}
+#endif
+
+void apply(const RealtimeConfig &config)
+{
+#ifdef __linux__
+    if (config.policy == "fifo" || config.policy == "rr") {
+        int policy = config.policy == "fifo" ? SCHED_FIFO : SCHED_RR;
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = qBound(sched_get_priority_min(policy), config.priority,
+                                      sched_get_priority_max(policy));
+        int rc = pthread_setschedparam(pthread_self(), policy, &param);
+        if (rc != 0)
+            qWarning() << "无法设置实时调度" << config.policy << param.sched_priority
+                       << ":" << strerror(rc);
+        else
+            qDebug() << "采集线程: 调度策略" << config.policy << "优先级" << param.sched_priority;
+    } else if (config.priority != 0) {
+        // Linux 上 nice 值按线程生效
+        pid_t tid = pid_t(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, qBound(-20, config.priority, 19)) < 0)
+            qWarning() << "无法设置采集线程 nice 值" << config.priority << ":" << strerror(errno);
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (config.cpu >= 0 && cpus > 1) {
+        if (config.cpu >= cpus) {
+            qWarning() << "CPU" << config.cpu << "不存在，共" << cpus << "个，采集线程不绑定";
+        } else {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(config.cpu, &set);
+            // pid 0 表示调用线程
+            if (sched_setaffinity(0, sizeof(set), &set) < 0)
+                qWarning() << "无法把采集线程绑定到 CPU" << config.cpu << ":" << strerror(errno);
+        }
+    }
+
+    if (config.lockMemory) {
+        prefaultStack();
+        if (mlockall(MCL_CURRENT) < 0)
+            qWarning() << "无法锁定内存:" << strerror(errno);
+    }
+#else
+    if (config.policy != "other" || config.cpu >= 0 || config.lockMemory)
+        qWarning() << "此平台不支持实时调度设置，忽略 [realtime]";
+#endif
+}
+
+qint64 monotonicNs()
+{
+#ifdef __linux__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return clock.nsecsElapsed();
+#endif
+}
+
+void sleepUntilNs(qint64 deadlineNs)
+{
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = time_t(deadlineNs / 1000000000);
+    ts.tv_nsec = long(deadlineNs % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+    }
+#else
+    qint64 remaining = deadlineNs - monotonicNs();
+    if (remaining > 0)
+        Sleeper::sleepMs((remaining + 999999) / 1000000);
+#endif
+}
+
+} // namespace Realtime
+
+// ============== JitterMonitor ==============
+
+JitterMonitor::JitterMonitor()
+    : m_limitUs(0)
+    , m_reportNs(0)
+    , m_windowStart(0)
+    , m_windowMaxUs(0)
+    , m_windowOverruns(0)
+{
+    m_window = new MetricHistogram(jitterBounds(), 1e6);
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_total = registry->histogram("smarthome_sensor_tick_jitter_seconds",
+                                  "Delay from the scheduled sampling tick to the start of the read.",
+                                  jitterBounds(), 1e6);
+    m_overruns = registry->counter("smarthome_sensor_tick_overruns_total",
+                                   "Sampling ticks skipped because a read took longer than the interval.");
+}
+
+JitterMonitor::~JitterMonitor()
+{
+    delete m_window;
+}
+
+void JitterMonitor::configure(int limitUs, int reportSec)
+{
+    m_limitUs = qMax(0, limitUs);
+    m_reportNs = qint64(qMax(0, reportSec)) * 1000000000;
+}
+
+void JitterMonitor::record(qint64 lateNs)
+{
+    int us = int(qBound(qint64(0), lateNs / 1000, qint64(0x7fffffff)));
+    m_total->observe(us);
+    m_window->observe(us);
+    m_windowMaxUs = qMax(m_windowMaxUs, us);
+
+    qint64 now = Realtime::monotonicNs();
+    if (m_windowStart == 0)
+        m_windowStart = now;
+    if (m_reportNs > 0 && now - m_windowStart >= m_reportNs) {
+        report();
+        m_windowStart = now;
+    }
+}
+
+void JitterMonitor::recordOverrun()
+{
+    m_overruns->inc();
+    ++m_windowOverruns;
+}
+
+void JitterMonitor::report()
+{
+    // 分位数是桶的上界，-1 表示超过最大的桶
+    int p50 = m_window->quantile(0.50);
+    int p99 = m_window->quantile(0.99);
+    qDebug() << "采样抖动(微秒): 次数" << m_window->count() << "p50 <=" << p50
+             << "p99 <=" << p99 << "最大" << m_windowMaxUs << "超时" << m_windowOverruns;
+    if (m_limitUs > 0 && (p99 < 0 || p99 > m_limitUs))
+        qWarning() << "采样抖动 p99 超过限值" << m_limitUs << "微秒";
+
+    delete m_window;
+    m_window = new MetricHistogram(jitterBounds(), 1e6);
+    m_windowMaxUs = 0;
+    m_windowOverruns = 0;
+}
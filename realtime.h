@@ -0,0 +1,70 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+class MetricHistogram;
+class MetricCounter;
+
+// 采集线程的实时调度配置（[realtime] 下），在采集线程里应用到线程自身
+//   policy     other（默认）| fifo | rr
+//   priority   fifo/rr 为 1~99；other 为 nice 值（-20~19，负值需要权限），0 表示不改
+//   cpu        绑定到的 CPU 编号，-1 不绑定；单核时忽略
+//   lockMemory 锁定进程当前已映射的内存（mlockall MCL_CURRENT），
+//              采集线程的栈先预先触及；不锁定以后的分配，界面的内存增长不受 RLIMIT_MEMLOCK 限制
+// 权限不足等失败只打印警告，采集照常进行。
+//
+// fifo/rr 下总线的 Block 策略仍可能让采集线程等待低优先级的存储线程（QMutex 没有优先级继承），
+// 最长等待 blockTimeoutMs。
+struct RealtimeConfig {
+    QString policy;
+    int priority;
+    int cpu;
+    bool lockMemory;
+
+    int jitterLimitUs;      // 每个报告周期的 p99 超过时警告，0 表示不检查
+    int jitterReportSec;    // 报告周期，0 表示不报告
+
+    RealtimeConfig() : policy("other"), priority(0), cpu(-1), lockMemory(false),
+                       jitterLimitUs(0), jitterReportSec(60) {}
+};
+
+namespace Realtime {
+    // 应用到调用线程
+    void apply(const RealtimeConfig &config);
+
+    // 单调时钟（纳秒）和睡到绝对时刻；Linux 上用 clock_nanosleep，
+    // 醒来的误差不随周期累积
+    qint64 monotonicNs();
+    void sleepUntilNs(qint64 deadlineNs);
+}
+
+// 采样节拍抖动：实际开始读取的时刻比计划时刻晚多少
+// 累计值导出为 smarthome_sensor_tick_jitter_seconds；另外按报告周期统计 p50/p99/最大值
+// 写入日志，用来在负载下核对 p99 限值。只在采集线程中使用。
+class JitterMonitor
+{
+public:
+    JitterMonitor();
+    ~JitterMonitor();
+
+    void configure(int limitUs, int reportSec);
+    void record(qint64 lateNs);
+    void recordOverrun();
+
+private:
+    void report();
+
+    int m_limitUs;
+    qint64 m_reportNs;
+    qint64 m_windowStart;
+    int m_windowMaxUs;
+    int m_windowOverruns;
+    MetricHistogram *m_window;      // 本报告周期，不导出
+    MetricHistogram *m_total;
+    MetricCounter *m_overruns;
+};
+
+#endif // REALTIME_H
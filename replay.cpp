@@ -0,0 +1,124 @@
+#include "replay.h"
+#include "sensorstorage.h"
+#include "samplebus.h"
+#include "persistencepolicy.h"
+
+// 一次从游标读出的采样数
+static const int kBatchSamples = 512;
+// 等待下一个采样时最长睡多久，期间可以响应 requestStop()
+static const qint64 kMaxSleepUs = 100 * 1000;
+
+ReplayThread::ReplayThread(QObject *parent)
+    : QThread(parent)
+    , m_source(0)
+    , m_bus(0)
+    , m_fromMs(0)
+    , m_toMs(0)
+    , m_speed(100)
+    , m_maxGapMs(600 * 1000)
+    , m_running(true)
+    , m_intervalMs(0)
+    , m_hasPrevious(false)
+{
+}
+
+ReplayThread::~ReplayThread()
+{
+    m_running = false;
+    wait();
+    delete m_source;
+}
+
+void ReplayThread::setSource(SensorStorage *source, const QString &path)
+{
+    m_source = source;
+    m_path = path;
+    m_source->moveToThread(this);
+}
+
+void ReplayThread::setRange(qint64 fromMs, qint64 toMs)
+{
+    m_fromMs = fromMs;
+    m_toMs = toMs;
+}
+
+void ReplayThread::run()
+{
+    m_report = Report();
+    m_intervalMs = 0;
+    m_hasPrevious = false;
+
+    if (!m_source->open(m_path, true) || !m_source->openCursor(m_fromMs, m_toMs)) {
+        m_report.error = m_source->lastError();
+        m_source->close();
+        return;
+    }
+
+    m_clock.start();
+    QList<SensorData> rows;
+    while (m_running) {
+        rows.clear();
+        if (!m_source->readCursor(&rows, kBatchSamples)) {
+            m_report.error = m_source->lastError();
+            break;
+        }
+        if (rows.isEmpty()) {
+            m_report.ok = true;
+            break;
+        }
+        replay(rows);
+    }
+    m_report.elapsedMs = m_clock.elapsed();
+    m_source->close();
+}
+
+void ReplayThread::replay(const QList<SensorData> &rows)
+{
+    // 采样周期很少变化，一批首尾相同时整批都用它
+    int first = m_source->intervalAt(rows.first().timestamp);
+    int last = m_source->intervalAt(rows.last().timestamp);
+    for (int i = 0; i < rows.size() && m_running; ++i) {
+        const SensorData &row = rows.at(i);
+        int interval = first == last ? first : m_source->intervalAt(row.timestamp);
+        if (interval > 0 && interval != m_intervalMs) {
+            m_intervalMs = interval;
+            emit sampleIntervalChanged(row.timestamp, interval);
+        }
+
+        if (m_hasPrevious && m_intervalMs > 0
+            && m_previous.timestamp.msecsTo(row.timestamp) <= m_maxGapMs) {
+            QList<SensorData> held;
+            PersistencePolicy::fillSteps(m_previous, row, m_intervalMs, &held);
+            for (int k = 0; k < held.size() && m_running; ++k)
+                publish(held.at(k));
+        }
+        publish(row);
+        m_previous = row;
+        m_hasPrevious = true;
+        ++m_report.rows;
+    }
+}
+
+void ReplayThread::publish(const SensorData &data)
+{
+    qint64 ms = data.timestamp.toMSecsSinceEpoch();
+    if (m_report.firstMs < 0)
+        m_report.firstMs = ms;
+
+    if (m_speed > 0) {
+        qint64 dueUs = qint64((ms - m_report.firstMs) * 1000 / m_speed);
+        qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+        while (nowUs < dueUs && m_running) {
+            usleep(qMin(dueUs - nowUs, kMaxSleepUs));
+            nowUs = m_clock.nsecsElapsed() / 1000;
+        }
+        m_report.maxBehindMs = qMax(m_report.maxBehindMs, (nowUs - dueUs) / 1000);
+    }
+
+    // 时间戳保持原样，周期按当时的设置
+    SensorData sample = data;
+    sample.intervalMs = m_intervalMs;
+    m_bus->publish(sample);
+    ++m_report.published;
+    m_report.lastMs = ms;
+}
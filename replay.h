@@ -0,0 +1,83 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <QThread>
+#include <QString>
+#include <QElapsedTimer>
+#include "sensordata.h"
+
+class SensorStorage;
+class SampleBus;
+
+// 历史回放：把数据库中记录的一段时间按原来的时间戳重新发布到采样总线
+//
+// 取代采集线程作为生产者（MonitorCore::REPLAY），图表、报警、热层和写库
+// （写到临时数据库）照常订阅，走的是和现场完全相同的路径，用来复现现场的问题和做可重复的负载测试。
+// 源数据库用顺序游标（SensorStorage::openCursor()）一批批读出，内存中只有一批；
+// 数据库中是阶梯序列（见 PersistencePolicy），两条记录之间按当时的采样周期补出保持值，
+// 总线上看到的采样和现场一样多。
+// 按 speed 倍速发布：第 i 个采样在开始后 (t_i - t_0) / speed 时发布，speed <= 0 时不等待。
+// 订阅者跟不上时 Block 策略让回放等待，落后的时间计入 maxBehindMs；各订阅者的队列、
+// 丢弃和处理时间由 SampleBus::stats() 给出。
+class ReplayThread : public QThread
+{
+    Q_OBJECT
+public:
+    struct Report {
+        bool ok;
+        QString error;
+        qint64 rows;            // 从源数据库读出的采样
+        qint64 published;       // 发布到总线的采样（包括补出的保持值）
+        qint64 firstMs;
+        qint64 lastMs;
+        qint64 elapsedMs;
+        qint64 maxBehindMs;     // 发布比计划晚的最长时间
+
+        Report() : ok(false), rows(0), published(0), firstMs(-1), lastMs(-1),
+                   elapsedMs(0), maxBehindMs(0) {}
+    };
+
+    explicit ReplayThread(QObject *parent = 0);
+    ~ReplayThread();
+
+    // start() 之前设置。source 由本线程接管：移到本线程、在这里打开和关闭，结束后删除
+    void setSource(SensorStorage *source, const QString &path);
+    void setRange(qint64 fromMs, qint64 toMs);
+    void setSpeed(double speed) { m_speed = speed; }
+    void setSampleBus(SampleBus *bus) { m_bus = bus; }
+    // 两条记录之间超过 ms 的间隔是中断，不补保持值，和历史查询、附加模式一致
+    void setMaxGap(qint64 ms) { m_maxGapMs = ms; }
+
+    void requestStop() { m_running = false; }
+
+    // 线程结束之后读取
+    const Report &report() const { return m_report; }
+
+signals:
+    // 源数据库中的采样周期变化，和采集线程的同名信号含义相同
+    void sampleIntervalChanged(const QDateTime &at, int intervalMs);
+
+protected:
+    void run();
+
+private:
+    void replay(const QList<SensorData> &rows);
+    void publish(const SensorData &data);
+
+    SensorStorage *m_source;
+    QString m_path;
+    SampleBus *m_bus;
+    qint64 m_fromMs;
+    qint64 m_toMs;
+    double m_speed;
+    qint64 m_maxGapMs;
+    volatile bool m_running;
+
+    QElapsedTimer m_clock;      // 从开始回放算起
+    int m_intervalMs;
+    bool m_hasPrevious;
+    SensorData m_previous;
+    Report m_report;
+};
+
+#endif // REPLAY_H
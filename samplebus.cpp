@@ -0,0 +1,234 @@
+#include "samplebus.h"
+#include "metrics.h"
+#include <QThread>
+#include <QTimer>
+#include <QMetaObject>
+#include <QDebug>
+
+// 投递延迟的桶边界，单位：微秒
+static QVector<int> lagBounds()
+{
+    QVector<int> bounds;
+    bounds << 100 << 500 << 1000 << 5000 << 10000 << 50000
+           << 100000 << 500000 << 1000000 << 5000000;
+    return bounds;
+}
+
+// ============== SampleBus ==============
+
+SampleBus::SampleBus(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+}
+
+SampleBus::~SampleBus()
+{
+    QMutexLocker locker(&m_mutex);
+    qDeleteAll(m_subscriptions);
+    m_subscriptions.clear();
+    qDeleteAll(m_retired);
+    m_retired.clear();
+}
+
+void SampleBus::subscribe(const QString &name, QObject *receiver, const char *method,
+                          const Options &options)
+{
+    SampleSubscription *subscription =
+        new SampleSubscription(name, receiver, method, options, &m_clock);
+    subscription->moveToThread(receiver->thread());
+
+    QMutexLocker locker(&m_mutex);
+    m_subscriptions.append(subscription);
+}
+
+void SampleBus::unsubscribe(QObject *receiver)
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = m_subscriptions.size() - 1; i >= 0; --i) {
+        if (m_subscriptions[i]->receiver() == receiver) {
+            SampleSubscription *subscription = m_subscriptions.takeAt(i);
+            subscription->detach();
+            m_retired.append(subscription);
+        }
+    }
+}
+
+void SampleBus::publish(const SensorData &data)
+{
+    // Block 的订阅者可能让 enqueue() 等待，不能持有总线的锁：
+    // 否则 stats()、flush()、订阅和其他发布者都要跟着等
+    QList<SampleSubscription *> subscriptions;
+    {
+        QMutexLocker locker(&m_mutex);
+        subscriptions = m_subscriptions;
+    }
+    for (int i = 0; i < subscriptions.size(); ++i)
+        subscriptions[i]->enqueue(data);
+}
+
+void SampleBus::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_subscriptions.size(); ++i)
+        QMetaObject::invokeMethod(m_subscriptions[i], "drain", Qt::QueuedConnection);
+}
+
+QList<SampleBus::SubscriberStats> SampleBus::stats()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<SubscriberStats> result;
+    for (int i = 0; i < m_subscriptions.size(); ++i)
+        result.append(m_subscriptions[i]->stats());
+    return result;
+}
+
+// ============== SampleSubscription ==============
+
+SampleSubscription::SampleSubscription(const QString &name, QObject *receiver,
+                                       const char *method,
+                                       const SampleBus::Options &options,
+                                       const QElapsedTimer *clock)
+    : m_receiver(receiver)
+    , m_method(method)
+    , m_options(options)
+    , m_clock(clock)
+    , m_scheduled(false)
+    , m_detached(false)
+{
+    m_stats.name = name;
+    m_options.batchSize = qMax(1, m_options.batchSize);
+    m_options.capacity = qMax(m_options.batchSize, m_options.capacity);
+
+    // 子对象随订阅对象一起移到接收者线程
+    m_latencyTimer = new QTimer(this);
+    m_latencyTimer->setSingleShot(true);
+    connect(m_latencyTimer, SIGNAL(timeout()), this, SLOT(drain()));
+
+    QString labels = QString("subscriber=\"%1\"").arg(name);
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    m_depth = registry->gauge("smarthome_bus_queue_depth",
+                              "Samples waiting in a bus subscriber's queue.", labels);
+    m_delivered = registry->counter("smarthome_bus_delivered_total",
+                                    "Samples delivered to a bus subscriber.", labels);
+    m_dropped = registry->counter("smarthome_bus_dropped_total",
+                                  "Samples dropped because a bus subscriber's queue was full.",
+                                  labels);
+    m_coalesced = registry->counter("smarthome_bus_coalesced_total",
+                                    "Queued samples replaced by a newer one.", labels);
+    m_lag = registry->histogram("smarthome_bus_delivery_lag_seconds",
+                                "Time from publish to delivery of the oldest sample in a batch.",
+                                lagBounds(), 1e6, labels);
+}
+
+void SampleSubscription::enqueue(const SensorData &data)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_detached)
+        return;
+
+    if (m_queue.size() >= m_options.capacity) {
+        bool canBlock = m_options.policy == SampleBus::Block
+                     && QThread::currentThread() != thread();
+        if (canBlock) {
+            QElapsedTimer waited;
+            waited.start();
+            while (m_queue.size() >= m_options.capacity && !m_detached) {
+                int left = m_options.blockTimeoutMs - int(waited.elapsed());
+                if (left <= 0 || !m_notFull.wait(&m_mutex, left))
+                    break;
+            }
+            if (m_detached)
+                return;
+        }
+
+        if (m_queue.size() >= m_options.capacity) {
+            if (m_options.policy == SampleBus::CoalesceLatest) {
+                m_queue.last() = data;
+                m_coalesced->inc();
+                ++m_stats.coalesced;
+            } else {
+                m_dropped->inc();
+                ++m_stats.dropped;
+            }
+            return;
+        }
+    }
+
+    bool wasEmpty = m_queue.isEmpty();
+    m_queue.append(data);
+    m_enqueuedNs.append(m_clock->nsecsElapsed());
+    m_depth->set(m_queue.size());
+    m_stats.peakDepth = qMax(m_stats.peakDepth, m_queue.size());
+
+    if (m_scheduled)
+        return;
+    if (m_queue.size() >= m_options.batchSize || m_options.maxLatencyMs <= 0) {
+        m_scheduled = true;
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    } else if (wasEmpty) {
+        // 计时器只能在它所在的线程里启动
+        QMetaObject::invokeMethod(this, "armLatencyTimer", Qt::QueuedConnection);
+    }
+}
+
+void SampleSubscription::detach()
+{
+    QMutexLocker locker(&m_mutex);
+    m_detached = true;
+    m_queue.clear();
+    m_enqueuedNs.clear();
+    m_depth->set(0);
+    m_notFull.wakeAll();
+}
+
+void SampleSubscription::armLatencyTimer()
+{
+    if (!m_latencyTimer->isActive())
+        m_latencyTimer->start(m_options.maxLatencyMs);
+}
+
+// 在接收者线程中一次取走整个队列：落后时一批补齐，而不是一个个投递
+void SampleSubscription::drain()
+{
+    SensorDataList batch;
+    qint64 oldest;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_scheduled = false;
+        if (m_queue.isEmpty() || m_detached)
+            return;
+        batch.swap(m_queue);
+        oldest = m_enqueuedNs.first();
+        m_enqueuedNs.clear();
+        m_depth->set(0);
+        m_notFull.wakeAll();
+    }
+    m_latencyTimer->stop();
+
+    qint64 start = m_clock->nsecsElapsed();
+    m_lag->observe(int(qMin(qint64(0x7fffffff), (start - oldest) / 1000)));
+    m_delivered->add(batch.size());
+
+    if (!m_receiver)
+        return;
+    if (!QMetaObject::invokeMethod(m_receiver, m_method.constData(), Qt::DirectConnection,
+                                   Q_ARG(SensorDataList, batch))) {
+        qWarning() << "SampleBus: 无法调用" << m_receiver->metaObject()->className()
+                   << m_method.constData();
+    }
+
+    qint64 handler = m_clock->nsecsElapsed() - start;
+    QMutexLocker locker(&m_mutex);
+    m_stats.delivered += batch.size();
+    ++m_stats.batches;
+    m_stats.handlerNsTotal += handler;
+    m_stats.handlerNsMax = qMax(m_stats.handlerNsMax, handler);
+    m_stats.lagNsMax = qMax(m_stats.lagNsMax, start - oldest);
+}
+
+SampleBus::SubscriberStats SampleSubscription::stats()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,137 @@
+#ifndef SAMPLEBUS_H
+#define SAMPLEBUS_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QPointer>
+#include <QElapsedTimer>
+#include "sensordata.h"
+
+class QTimer;
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
+class SampleSubscription;
+
+// 采样总线
+//
+// 生产者（采集线程、附加模式的轮询）只调用 publish()，不知道有哪些消费者。
+// 每个订阅者有自己的队列，在接收对象所在的线程中按批收到采样，
+// 一个消费者变慢只会让自己的队列变长，不影响其他消费者。
+//
+// 队列满时的处理方式：
+//   Drop            丢弃新采样
+//   CoalesceLatest  用新采样替换队尾，订阅者总能看到最新值（适合只显示当前值的消费者）
+//   Block           发布者等待，直到队列有空位；最多等 blockTimeoutMs，超时后丢弃。
+//                   发布者与订阅者在同一线程时等待会死锁，此时按 Drop 处理。
+//                   等待时不持有总线的锁，但发布者本身停下了：只用于有自己线程、
+//                   不能丢采样的消费者（写库），不要用于界面线程中的消费者
+//
+// 每个订阅者导出队列长度、投递延迟（从发布到交给订阅者）、丢弃和合并计数，
+// 标签 subscriber="<name>"。
+class SampleBus : public QObject
+{
+    Q_OBJECT
+public:
+    enum Policy {
+        Drop = 0,
+        CoalesceLatest = 1,
+        Block = 2
+    };
+
+    struct Options {
+        int batchSize;        // 攒够这么多个采样再投递
+        int maxLatencyMs;     // 不满一批时最多等待多久，0 表示不等待
+        int capacity;         // 队列上限
+        Policy policy;
+        int blockTimeoutMs;
+
+        Options() : batchSize(1), maxLatencyMs(0), capacity(256), policy(Drop),
+                    blockTimeoutMs(1000) {}
+    };
+
+    // 一个订阅者从订阅以来的累计情况（回放报告用，见 replay.h）
+    struct SubscriberStats {
+        QString name;
+        qint64 delivered;
+        qint64 dropped;
+        qint64 coalesced;
+        int peakDepth;          // 队列最长时的采样数
+        qint64 batches;
+        qint64 handlerNsTotal;  // 订阅槽处理各批用的时间
+        qint64 handlerNsMax;
+        qint64 lagNsMax;        // 最长的投递延迟
+
+        SubscriberStats() : delivered(0), dropped(0), coalesced(0), peakDepth(0), batches(0),
+                            handlerNsTotal(0), handlerNsMax(0), lagNsMax(0) {}
+    };
+
+    explicit SampleBus(QObject *parent = 0);
+    ~SampleBus();
+
+    // method 是 receiver 的槽名（不带参数表），签名为 void method(const SensorDataList &)，
+    // 在 receiver 所在线程中调用。订阅之后 receiver 不能再换线程。
+    void subscribe(const QString &name, QObject *receiver, const char *method,
+                   const Options &options = Options());
+    void unsubscribe(QObject *receiver);
+
+    // 可以在任何线程调用
+    void publish(const SensorData &data);
+
+    QList<SubscriberStats> stats();
+
+    // 让每个订阅者尽快取走队列中的采样，不等凑满一批或延迟计时器（退出前排空）。
+    // 投递排在接收者线程中已有的事件之后
+    void flush();
+
+private:
+    QMutex m_mutex;
+    QList<SampleSubscription *> m_subscriptions;
+    // 已退订的订阅：发布者可能正在锁外使用它们，总线销毁时才删除
+    QList<SampleSubscription *> m_retired;
+    QElapsedTimer m_clock;    // 各订阅者共用的单调时钟，计算投递延迟
+};
+
+// 一个订阅者的队列，对象放在接收者的线程中，drain() 在那里执行
+class SampleSubscription : public QObject
+{
+    Q_OBJECT
+public:
+    SampleSubscription(const QString &name, QObject *receiver, const char *method,
+                       const SampleBus::Options &options, const QElapsedTimer *clock);
+
+    QObject *receiver() const { return m_receiver; }
+    void enqueue(const SensorData &data);
+    // 退订：丢弃队列，之后的采样不再接收，也不再投递
+    void detach();
+    SampleBus::SubscriberStats stats();
+
+private slots:
+    void drain();
+    void armLatencyTimer();
+
+private:
+    QPointer<QObject> m_receiver;
+    QByteArray m_method;
+    SampleBus::Options m_options;
+    const QElapsedTimer *m_clock;
+    QTimer *m_latencyTimer;
+
+    QMutex m_mutex;
+    QWaitCondition m_notFull;
+    SensorDataList m_queue;
+    QList<qint64> m_enqueuedNs;
+    bool m_scheduled;
+    bool m_detached;
+    SampleBus::SubscriberStats m_stats;
+
+    MetricGauge *m_depth;
+    MetricCounter *m_delivered;
+    MetricCounter *m_dropped;
+    MetricCounter *m_coalesced;
+    MetricHistogram *m_lag;
+};
+
+#endif // SAMPLEBUS_H
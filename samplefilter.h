@@ -0,0 +1,273 @@
+#ifndef SAMPLEFILTER_H
+#define SAMPLEFILTER_H
+
+#include <QtGlobal>
+
+// 采样滤波流水线
+//
+// 每个阶段是一个带固定大小状态的小类，提供 configure()/reset()/process()。
+// 阶段通过 FilterChain<First, Rest> 在编译期串联，整条链内联展开，
+// 每个采样不分配内存。各阶段可以通过配置单独关闭（关闭时原样输出）。
+
+// 单个通道的滤波配置
+struct ChannelFilterConfig {
+    // 尖峰剔除：与上一个输出相差超过 spikeMaxStep 的读数用上一个输出代替，
+    // 连续剔除 spikeMaxRejects 次后接受新值（视为真实阶跃）
+    bool spikeEnabled;
+    float spikeMaxStep;
+    int spikeMaxRejects;
+
+    // 中值滤波窗口，1 表示关闭，最大 MEDIAN_MAX_WINDOW
+    int medianWindow;
+
+    // 指数加权滑动平均，alpha 越小越平滑
+    bool ewmaEnabled;
+    float ewmaAlpha;
+
+    // 一维卡尔曼滤波：q 为过程噪声，r 为测量噪声
+    bool kalmanEnabled;
+    float kalmanQ;
+    float kalmanR;
+
+    // 限幅
+    bool clampEnabled;
+    float clampMin;
+    float clampMax;
+
+    enum { MEDIAN_MAX_WINDOW = 9 };
+
+    ChannelFilterConfig()
+        : spikeEnabled(false), spikeMaxStep(5.0f), spikeMaxRejects(3)
+        , medianWindow(1)
+        , ewmaEnabled(false), ewmaAlpha(0.3f)
+        , kalmanEnabled(false), kalmanQ(0.01f), kalmanR(0.5f)
+        , clampEnabled(false), clampMin(-40.0f), clampMax(125.0f) {}
+};
+
+// ============== 滤波阶段 ==============
+
+class SpikeRejectFilter
+{
+public:
+    SpikeRejectFilter() : m_enabled(false), m_maxStep(0), m_maxRejects(0) { reset(); }
+
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_enabled = c.spikeEnabled;
+        m_maxStep = c.spikeMaxStep;
+        m_maxRejects = c.spikeMaxRejects;
+    }
+
+    void reset() { m_hasLast = false; m_rejects = 0; m_rejectedTotal = 0; }
+
+    float process(float x)
+    {
+        if (!m_enabled) return x;
+        if (m_hasLast && qAbs(x - m_last) > m_maxStep && m_rejects < m_maxRejects) {
+            ++m_rejects;
+            ++m_rejectedTotal;
+            return m_last;
+        }
+        m_hasLast = true;
+        m_rejects = 0;
+        m_last = x;
+        return x;
+    }
+
+    quint32 rejectedTotal() const { return m_rejectedTotal; }
+
+private:
+    bool m_enabled;
+    float m_maxStep;
+    int m_maxRejects;
+    bool m_hasLast;
+    float m_last;
+    int m_rejects;
+    quint32 m_rejectedTotal;
+};
+
+template <int MaxN>
+class MedianFilter
+{
+public:
+    MedianFilter() : m_window(1) { reset(); }
+
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_window = qBound(1, c.medianWindow, MaxN);
+        reset();
+    }
+
+    void reset() { m_count = 0; m_pos = 0; }
+
+    float process(float x)
+    {
+        if (m_window <= 1) return x;
+
+        m_buf[m_pos] = x;
+        m_pos = (m_pos + 1) % m_window;
+        if (m_count < m_window) ++m_count;
+
+        // 窗口很小，拷贝后插入排序
+        float sorted[MaxN];
+        for (int i = 0; i < m_count; ++i) {
+            float v = m_buf[i];
+            int j = i;
+            while (j > 0 && sorted[j - 1] > v) {
+                sorted[j] = sorted[j - 1];
+                --j;
+            }
+            sorted[j] = v;
+        }
+        return sorted[m_count / 2];
+    }
+
+private:
+    float m_buf[MaxN];
+    int m_window;
+    int m_count;
+    int m_pos;
+};
+
+class EwmaFilter
+{
+public:
+    EwmaFilter() : m_enabled(false), m_alpha(1.0f) { reset(); }
+
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_enabled = c.ewmaEnabled;
+        m_alpha = qBound(0.0f, c.ewmaAlpha, 1.0f);
+    }
+
+    void reset() { m_hasValue = false; }
+
+    float process(float x)
+    {
+        if (!m_enabled) return x;
+        if (!m_hasValue) {
+            m_hasValue = true;
+            m_value = x;
+        } else {
+            m_value += m_alpha * (x - m_value);
+        }
+        return m_value;
+    }
+
+private:
+    bool m_enabled;
+    float m_alpha;
+    bool m_hasValue;
+    float m_value;
+};
+
+class KalmanFilter
+{
+public:
+    KalmanFilter() : m_enabled(false), m_q(0), m_r(1) { reset(); }
+
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_enabled = c.kalmanEnabled;
+        m_q = c.kalmanQ;
+        m_r = c.kalmanR > 0 ? c.kalmanR : 1e-6f;
+    }
+
+    void reset() { m_hasValue = false; }
+
+    float process(float z)
+    {
+        if (!m_enabled) return z;
+        if (!m_hasValue) {
+            m_hasValue = true;
+            m_x = z;
+            m_p = m_r;
+            return m_x;
+        }
+        m_p += m_q;                       // 预测
+        float k = m_p / (m_p + m_r);      // 增益
+        m_x += k * (z - m_x);             // 更新
+        m_p *= (1.0f - k);
+        return m_x;
+    }
+
+private:
+    bool m_enabled;
+    float m_q;
+    float m_r;
+    bool m_hasValue;
+    float m_x;
+    float m_p;
+};
+
+class ClampFilter
+{
+public:
+    ClampFilter() : m_enabled(false), m_min(0), m_max(0) {}
+
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_enabled = c.clampEnabled;
+        m_min = c.clampMin;
+        m_max = c.clampMax;
+    }
+
+    void reset() {}
+
+    float process(float x)
+    {
+        return m_enabled ? qBound(m_min, x, m_max) : x;
+    }
+
+private:
+    bool m_enabled;
+    float m_min;
+    float m_max;
+};
+
+// ============== 编译期串联 ==============
+
+struct FilterEnd
+{
+    void configure(const ChannelFilterConfig &) {}
+    void reset() {}
+    float process(float x) { return x; }
+};
+
+template <class First, class Rest = FilterEnd>
+class FilterChain
+{
+public:
+    void configure(const ChannelFilterConfig &c)
+    {
+        m_first.configure(c);
+        m_rest.configure(c);
+    }
+
+    void reset()
+    {
+        m_first.reset();
+        m_rest.reset();
+    }
+
+    float process(float x)
+    {
+        return m_rest.process(m_first.process(x));
+    }
+
+    First &first() { return m_first; }
+    Rest &rest() { return m_rest; }
+
+private:
+    First m_first;
+    Rest m_rest;
+};
+
+// 每个通道使用的滤波链：尖峰剔除 -> 中值 -> EWMA -> 卡尔曼 -> 限幅
+typedef FilterChain<SpikeRejectFilter,
+        FilterChain<MedianFilter<ChannelFilterConfig::MEDIAN_MAX_WINDOW>,
+        FilterChain<EwmaFilter,
+        FilterChain<KalmanFilter,
+        FilterChain<ClampFilter> > > > > ChannelFilter;
+
+#endif // SAMPLEFILTER_H
@@ -0,0 +1,156 @@
+#include "samplering.h"
+#include <QDebug>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+
+SampleRing::SampleRing()
+    : m_header(0)
+    , m_slots(0)
+    , m_mapSize(0)
+    , m_next(0)
+{
+}
+
+SampleRing::~SampleRing()
+{
+    destroy();
+}
+
+// pid 是否还是一个活着的本程序进程（崩溃后 pid 可能已被其他程序复用）
+static bool writerAlive(quint32 pid)
+{
+    if (pid == 0 || pid == quint32(getpid()))
+        return false;
+    if (kill(pid_t(pid), 0) < 0 && errno == ESRCH)
+        return false;
+#ifdef __linux__
+    char self[PATH_MAX];
+    char other[PATH_MAX];
+    ssize_t n1 = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    ssize_t n2 = readlink(QByteArray("/proc/" + QByteArray::number(pid) + "/exe").constData(),
+                          other, sizeof(other) - 1);
+    if (n1 > 0 && n2 > 0 && (n1 != n2 || memcmp(self, other, size_t(n1)) != 0))
+        return false;
+#endif
+    return true;
+}
+
+bool SampleRing::retireStale(const QByteArray &shmName)
+{
+    int fd = shm_open(shmName.constData(), O_RDWR, 0);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(samplering_header)) {
+        void *p = mmap(0, sizeof(samplering_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            samplering_header *header = static_cast<samplering_header *>(p);
+            if (header->magic == SAMPLERING_MAGIC && !header->retired
+                    && writerAlive(header->writer_pid)) {
+                qWarning() << "共享内存" << shmName << "已有写者在运行, pid" << header->writer_pid;
+                munmap(p, sizeof(samplering_header));
+                close(fd);
+                return false;
+            }
+            // 还映射着旧内存的读者看到 retired 后重新打开
+            header->retired = 1;
+            samplering_barrier();
+            munmap(p, sizeof(samplering_header));
+        }
+    }
+    close(fd);
+    shm_unlink(shmName.constData());
+    return true;
+}
+
+bool SampleRing::create(const QString &name, int capacity)
+{
+    destroy();
+
+    quint32 cap = 16;
+    while (cap < quint32(capacity) && cap < (1u << 20)) cap <<= 1;
+
+    // 总是新建：旧内存可能还被读者映射着，不能在原处清零重用
+    QByteArray shmName = name.toLocal8Bit();
+    int fd = shm_open(shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        if (!retireStale(shmName))
+            return false;
+        fd = shm_open(shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        qWarning() << "创建共享内存失败:" << name << strerror(errno);
+        return false;
+    }
+
+    // 新建的共享内存全部为 0，magic 写入之前读者拒绝打开
+    m_mapSize = samplering_map_size(cap);
+    if (ftruncate(fd, off_t(m_mapSize)) < 0) {
+        qWarning() << "设置共享内存大小失败:" << strerror(errno);
+        close(fd);
+        shm_unlink(shmName.constData());
+        return false;
+    }
+
+    void *p = mmap(0, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        qWarning() << "映射共享内存失败:" << strerror(errno);
+        shm_unlink(shmName.constData());
+        return false;
+    }
+
+    m_header = static_cast<samplering_header *>(p);
+    m_header->version = SAMPLERING_VERSION;
+    m_header->capacity = cap;
+    m_header->slot_size = sizeof(samplering_slot);
+    m_header->head = 0;
+    m_header->filled = 0;
+    m_header->writer_pid = quint32(getpid());
+    samplering_barrier();
+    m_header->magic = SAMPLERING_MAGIC;
+
+    m_slots = reinterpret_cast<samplering_slot *>(m_header + 1);
+    m_name = name;
+    m_next = 0;
+    return true;
+}
+
+void SampleRing::destroy()
+{
+    if (!m_header)
+        return;
+
+    // 读者可能仍映射着这块内存，只标记 retired、解除映射，不 shm_unlink；
+    // 下次启动的写者删除它并新建
+    m_header->retired = 1;
+    samplering_barrier();
+    munmap(m_header, m_mapSize);
+    m_header = 0;
+    m_slots = 0;
+}
+
+void SampleRing::publish(qint64 timestampMs, float temperature, float humidity, quint32 flags)
+{
+    if (!m_header)
+        return;
+
+    samplering_slot *slot = &m_slots[m_next & (m_header->capacity - 1)];
+
+    slot->seq = m_next * 2u + 1u;
+    samplering_barrier();
+    slot->flags = flags;
+    slot->timestamp_ms = timestampMs;
+    slot->temperature = temperature;
+    slot->humidity = humidity;
+    samplering_barrier();
+    slot->seq = (m_next + 1u) * 2u;
+
+    ++m_next;
+    if (m_next == m_header->capacity)
+        m_header->filled = 1;
+    samplering_barrier();
+    m_header->head = m_next;
+}
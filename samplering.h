@@ -0,0 +1,37 @@
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <QString>
+#include "sampleringabi.h"
+
+// 实时采样共享内存环形缓冲区的写端
+// 布局和读端 API 见 sampleringabi.h。只允许一个线程调用 publish()。
+class SampleRing
+{
+public:
+    SampleRing();
+    ~SampleRing();
+
+    // 新建共享内存，capacity 向上取整为 2 的幂。
+    // 同名的共享内存还有活着的写者时失败；写者已经不在的旧内存标记为 retired 后删除
+    bool create(const QString &name, int capacity);
+    void destroy();
+    bool isValid() const { return m_header != 0; }
+
+    // 发布一个采样，不加锁、不分配内存、不进入内核
+    void publish(qint64 timestampMs, float temperature, float humidity, quint32 flags);
+
+private:
+    Q_DISABLE_COPY(SampleRing)
+
+    // 处理已经存在的同名共享内存，可以新建时返回 true
+    static bool retireStale(const QByteArray &shmName);
+
+    QString m_name;
+    samplering_header *m_header;
+    samplering_slot *m_slots;
+    size_t m_mapSize;
+    quint32 m_next;
+};
+
+#endif // SAMPLERING_H
@@ -0,0 +1,209 @@
+/*
+ * 实时采样共享内存环形缓冲区（读端 API）
+ *
+ * 采集进程把每个采样写入 POSIX 共享内存 /smarthome-samples，本机其他进程
+ * （云端上传代理、空调控制器等）直接映射读取，不再轮询 sensor_data.db。
+ *
+ * 只有一个写者；读者数量不限，读者之间、读者与写者之间互不等待：
+ *   - 每个槽有自己的序号 seq。写入第 n 个采样时先把 seq 置为奇数 2n+1，
+ *     写完数据后再置为 2n+2（按 32 位回绕）。
+ *   - 读者读 seq、拷贝槽内容、再读 seq，两次相同且等于期望值即为完整数据；
+ *     否则说明该槽已被覆盖（读者落后超过一圈），读者跳到最旧的有效采样继续，
+ *     不会重试等待。
+ *   - 写者退出时置 retired；新的写者启动时确认旧写者已经不在，同样置 retired 后
+ *     删除旧的共享内存再新建，不会改写读者正在映射的内存。读者没有新采样时检查
+ *     samplering_retired()，为真时关闭后重新打开。
+ *   - 同名的共享内存只能有一个写者，已有写者在运行时新的写者拒绝创建。
+ *
+ * 纯 C 头文件，没有需要链接的库（旧版 glibc 需要 -lrt）。
+ * 参考实现见 tools/samplering_reader.c。
+ */
+#ifndef SAMPLERINGABI_H
+#define SAMPLERINGABI_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLERING_MAGIC        0x534d5252u     /* "SMRR" */
+#define SAMPLERING_VERSION      1u
+#define SAMPLERING_DEFAULT_NAME "/smarthome-samples"
+
+/* 采样标志 */
+#define SAMPLERING_FLAG_TEMPERATURE_VALID  0x1u
+#define SAMPLERING_FLAG_HUMIDITY_VALID     0x2u
+
+/* 所有字段按自然对齐排列，OABI/EABI 下布局相同 */
+struct samplering_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;          /* 槽数量，2 的幂，序号回绕时槽位保持连续 */
+    uint32_t slot_size;         /* sizeof(struct samplering_slot) */
+    volatile uint32_t head;     /* 已发布的采样总数（32 位回绕） */
+    uint32_t writer_pid;
+    volatile uint32_t retired;  /* 非 0：写者已退出或已被取代，不会再有新采样 */
+    volatile uint32_t filled;   /* 非 0：已经写满过一圈，所有槽都有效（head 回绕后仍为 1） */
+    uint32_t reserved[8];       /* 补齐到 64 字节，head 不与槽共享缓存行 */
+};
+
+struct samplering_slot {
+    volatile uint32_t seq;      /* 见文件头说明 */
+    uint32_t flags;
+    int64_t timestamp_ms;       /* 自 1970-01-01 UTC 起的毫秒数 */
+    float temperature;          /* °C */
+    float humidity;             /* % */
+};
+
+struct samplering_sample {
+    uint32_t index;             /* 采样序号（32 位回绕） */
+    uint32_t flags;
+    int64_t timestamp_ms;
+    float temperature;
+    float humidity;
+};
+
+struct samplering_reader {
+    const struct samplering_header *header;
+    const struct samplering_slot *entries;  /* 不能叫 slots：Qt 把它定义为宏 */
+    size_t map_size;
+    uint32_t next;              /* 下一个要读的采样序号 */
+    uint32_t lost;              /* 因落后被覆盖而跳过的采样数 */
+};
+
+#define samplering_barrier() __sync_synchronize()
+
+static inline size_t samplering_map_size(uint32_t capacity)
+{
+    return sizeof(struct samplering_header) + (size_t)capacity * sizeof(struct samplering_slot);
+}
+
+/*
+ * 只读映射共享内存。成功返回 0，读者从当前最新位置开始（只读新采样）；
+ * 失败返回 -1（errno 有效）或 -2（版本/布局不匹配）。
+ */
+static inline int samplering_open(struct samplering_reader *r, const char *name)
+{
+    struct stat st;
+    const struct samplering_header *h;
+    void *p;
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    fd = shm_open(name ? name : SAMPLERING_DEFAULT_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct samplering_header)) {
+        close(fd);
+        return -1;
+    }
+    p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -1;
+
+    h = (const struct samplering_header *)p;
+    if (h->magic != SAMPLERING_MAGIC || h->version != SAMPLERING_VERSION
+        || h->slot_size != sizeof(struct samplering_slot)
+        || samplering_map_size(h->capacity) > (size_t)st.st_size) {
+        munmap(p, (size_t)st.st_size);
+        return -2;
+    }
+
+    r->header = h;
+    r->entries = (const struct samplering_slot *)(h + 1);
+    r->map_size = (size_t)st.st_size;
+    r->next = h->head;
+    return 0;
+}
+
+static inline void samplering_close(struct samplering_reader *r)
+{
+    if (r->header)
+        munmap((void *)r->header, r->map_size);
+    memset(r, 0, sizeof(*r));
+}
+
+/* 已发布但尚未读取的采样数 */
+static inline uint32_t samplering_pending(const struct samplering_reader *r)
+{
+    return r->header->head - r->next;
+}
+
+/* 写者已经退出或被新写者取代：读完剩余采样后关闭，再 samplering_open() 新的共享内存 */
+static inline int samplering_retired(const struct samplering_reader *r)
+{
+    return r->header->retired != 0;
+}
+
+/* 从缓冲区中仍保留的最旧采样开始读（处理积压数据） */
+static inline void samplering_rewind(struct samplering_reader *r)
+{
+    uint32_t cap = r->header->capacity;
+    uint32_t filled, head;
+
+    /* 序号按 32 位回绕，不能只看 head > cap。写者先置 filled 再发布 head，
+     * 所以先读 filled：为 0 时之后读到的 head 还没有回绕过 */
+    filled = r->header->filled;
+    samplering_barrier();
+    head = r->header->head;
+    r->next = filled || head >= cap ? head - cap : 0;
+}
+
+/*
+ * 读取下一个采样。
+ * 返回 1：out 已填充；0：暂无新采样；
+ * 返回 -1：读者落后太多，部分采样已被覆盖，r->lost 累加跳过数量，可以立即再调用。
+ */
+static inline int samplering_read(struct samplering_reader *r, struct samplering_sample *out)
+{
+    const struct samplering_slot *slot;
+    uint32_t head, cap, expect, s1, s2;
+
+    head = r->header->head;
+    samplering_barrier();
+    if (head == r->next)
+        return 0;
+
+    cap = r->header->capacity;
+    if (head - r->next > cap) {
+        r->lost += head - r->next - cap;
+        r->next = head - cap;
+        return -1;
+    }
+
+    slot = &r->entries[r->next % cap];
+    expect = (r->next + 1u) * 2u;
+
+    s1 = slot->seq;
+    samplering_barrier();
+    out->flags = slot->flags;
+    out->timestamp_ms = slot->timestamp_ms;
+    out->temperature = slot->temperature;
+    out->humidity = slot->humidity;
+    samplering_barrier();
+    s2 = slot->seq;
+
+    if (s1 != expect || s2 != expect) {
+        /* 读的过程中被写者覆盖：跳过这个采样 */
+        r->lost++;
+        r->next++;
+        return -1;
+    }
+
+    out->index = r->next;
+    r->next++;
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLERINGABI_H */
@@ -3,23 +3,49 @@
 
 #include <QDateTime>
 #include <QString>
+#include <QMetaType>
+#include <QList>
 
-// 传感器数据结构
+// 内置通道，在 ChannelRegistry 中固定占前两个位置
+enum BuiltinChannel {
+    CHANNEL_TEMPERATURE = 0,
+    CHANNEL_HUMIDITY = 1
+};
+
+// 一次采样：时间戳 + 若干通道的值，通道下标即 ChannelRegistry 中的位置
+// values 为滤波后的值，rawValues 为滤波前的原始读数（未滤波时两者相同）。
+// 定长数组，跨线程传递时不分配内存；没有读到的通道不在 channelMask 中。
 struct SensorData {
-    double temperature;     // 温度 (°C)
-    double humidity;       // 湿度 (%)
+    enum { MAX_CHANNELS = 8 };
+
     QDateTime timestamp;   // 时间戳
+    int intervalMs;        // 采集时的采样周期，0 表示未知（从数据库读出的记录）
+    quint32 channelMask;
+    double values[MAX_CHANNELS];
+    double rawValues[MAX_CHANNELS];
 
-    SensorData() : temperature(0.0), humidity(0.0) {
+    SensorData() : intervalMs(0), channelMask(0) {
         timestamp = QDateTime::currentDateTime();
     }
 
-    SensorData(double temp, double hum)
-        : temperature(temp), humidity(hum) {
-        timestamp = QDateTime::currentDateTime();
+    bool has(int channel) const { return channelMask & (1u << channel); }
+    bool isEmpty() const { return channelMask == 0; }
+    double value(int channel) const { return values[channel]; }
+    double rawValue(int channel) const { return rawValues[channel]; }
+
+    void setValue(int channel, double value) { setValue(channel, value, value); }
+    void setValue(int channel, double value, double raw) {
+        values[channel] = value;
+        rawValues[channel] = raw;
+        channelMask |= 1u << channel;
     }
 };
 
+Q_DECLARE_METATYPE(SensorData)
+
+// 批量传递的采样（SampleBus 的订阅槽参数）
+typedef QList<SensorData> SensorDataList;
+
 // 传感器状态枚举
 enum SensorStatus {
     SENSOR_NORMAL = 0,
@@ -36,15 +62,4 @@ struct SystemStatus {
                     humidityStatus(SENSOR_NORMAL) {}
 };
 
-// 报警阈值设置
-struct AlarmThresholds {
-    double maxTemperature;
-    double minTemperature;
-    double maxHumidity;
-    double minHumidity;
-
-    AlarmThresholds() : maxTemperature(35.0), minTemperature(10.0),
-                       maxHumidity(80.0), minHumidity(20.0) {}
-};
-
 #endif // SENSORDATA_H
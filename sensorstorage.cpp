@@ -0,0 +1,1759 @@
+#include "sensorstorage.h"
+#include "metrics.h"
+#include "channelregistry.h"
+#include "hottier.h"
+#include "derivedchannels.h"
+#include "memorybudget.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QMap>
+#include <QVariant>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QFileInfo>
+#include <QtAlgorithms>
+#include <QDebug>
+
+// samples.key 的低 4 位是通道编号
+static const int kChannelBits = 4;
+
+static inline qint64 sampleKey(qint64 timestampMs, int dbChannel)
+{
+    return (timestampMs << kChannelBits) | dbChannel;
+}
+
+static bool newerFirst(const SensorData &a, const SensorData &b)
+{
+    return a.timestamp > b.timestamp;
+}
+
+static inline qint64 dayStartMs(const QDate &day)
+{
+    return QDateTime(day, QTime(0, 0)).toMSecsSinceEpoch();
+}
+
+static const qint64 kHourMs = 3600 * 1000;
+
+static inline qint64 hourFloor(qint64 ms)
+{
+    return ms - ((ms % kHourMs) + kHourMs) % kHourMs;
+}
+
+static inline qint64 hourCeil(qint64 ms)
+{
+    qint64 floor = hourFloor(ms);
+    return floor == ms ? ms : floor + kHourMs;
+}
+
+// 派生通道小时统计的备忘，按小时计，约 2 个月
+static const int kDerivedHourMemo = 62 * 24;
+
+// GroupCommit/Buffered 时内存中最多积攒的采样，超过时不等周期到就提交
+static const int kMaxUnsaved = 20000;
+
+// 另一连接拿不到写锁时最多等这么久
+static const int kBusyTimeoutMs = 2000;
+// 导入的一个事务最多持有写锁这么久，远小于 kBusyTimeoutMs，同时运行的采集进程不会写失败
+static const int kImportHoldMs = kBusyTimeoutMs / 8;
+
+SensorStorage::SensorStorage(const QString &connectionName, QObject *parent)
+    : QObject(parent)
+    , m_connectionName(connectionName)
+    , m_durability(SyncEach)
+    , m_commitPeriodMs(1000)
+    , m_sampleIntervalMs(1000)
+    , m_commitTimer(0)
+    , m_unsavedGauge(0)
+    , m_importQuery(0)
+    , m_importEvery(0)
+    , m_importPending(0)
+    , m_importDuplicates(0)
+    , m_importSync(2)
+    , m_cache(0)
+    , m_hot(0)
+    , m_layout(RowLayout)
+    , m_chunkMs(3600 * 1000)
+    , m_flushEvery(60)
+    , m_channelsLoaded(false)
+    , m_persistDerived(0)
+    , m_derivedHours(kDerivedHourMemo)
+    , m_derivedAccount(0)
+    , m_derivedMemoMask(0)
+    , m_truncated(false)
+    , m_summaryGapMs(600 * 1000)
+    , m_rollupDue(0)
+    , m_chunkStart(-1)
+    , m_unflushed(0)
+    , m_cursorQuery(0)
+    , m_cursorFrom(0)
+    , m_cursorTo(0)
+    , m_cursorTs(-1)
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_dbChannel[c] = -1;
+    for (int id = 0; id < MAX_DB_CHANNELS; ++id)
+        m_channelIndex[id] = -1;
+    m_dbErrorDrops = Metrics::samplesDropped("db_error");
+    m_dbClosedDrops = Metrics::samplesDropped("db_closed");
+}
+
+void SensorStorage::setDurability(Durability durability, int periodMs)
+{
+    m_durability = durability;
+    m_commitPeriodMs = qMax(10, periodMs);
+}
+
+int SensorStorage::lossWindowMs() const
+{
+    if (m_durability != SyncEach)
+        return m_commitPeriodMs;
+    if (m_layout != ChunkedLayout)
+        return 0;
+    // 死区内的采样不计入 flushEvery，两次写入最多隔一个心跳
+    qint64 spacing = m_sampleIntervalMs;
+    if (m_persist.isEnabled())
+        spacing = qMax(spacing, m_persist.heartbeatMs());
+    return int(qMin(spacing * m_flushEvery, m_chunkMs));
+}
+
+void SensorStorage::setLayout(Layout layout, int chunkMinutes, int flushEvery)
+{
+    m_layout = layout;
+    m_chunkMs = qint64(qMax(1, chunkMinutes)) * 60 * 1000;
+    m_flushEvery = qMax(1, flushEvery);
+}
+
+SensorStorage::~SensorStorage()
+{
+    close();
+    delete m_cache;
+}
+
+void SensorStorage::setCacheBudget(int bytes)
+{
+    delete m_cache;
+    m_cache = bytes > 0 ? new HistoryCache(bytes) : 0;
+}
+
+void SensorStorage::applyMemoryLimit()
+{
+    if (m_cache)
+        m_cache->applyMemoryLimit();
+    if (m_derivedAccount) {
+        int hours = qMin(m_derivedAccount->budget(), m_derivedAccount->limit())
+                  / int(sizeof(SummaryBucket));
+        m_derivedHours.setMaxCost(hours);
+        m_derivedAccount->setUsage(m_derivedHours.count() * int(sizeof(SummaryBucket)));
+    }
+}
+
+void SensorStorage::invalidateCache()
+{
+    m_derivedHours.clear();
+    if (m_cache)
+        m_cache->clear();
+}
+
+bool SensorStorage::open(const QString &path, bool attachOnly)
+{
+    m_db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_db.setDatabaseName(path);
+    // 另一进程持有写锁时等待而不是立即失败
+    // 附加端不用 QSQLITE_OPEN_READONLY：WAL 模式下只读连接需要已存在的 -shm 文件
+    m_db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(kBusyTimeoutMs));
+
+    if (!m_db.open()) {
+        m_lastError = m_db.lastError().text();
+        qWarning() << "无法打开数据库:" << path << m_lastError;
+        emit opened(false);
+        return false;
+    }
+
+    if (attachOnly) {
+        // 写入端可能还没建表，查询时再加载
+        syncChannels(false);
+        emit opened(true);
+        return true;
+    }
+
+    // 创建表
+    QSqlQuery query(m_db);
+    query.exec("PRAGMA encoding = 'UTF-8';");  // 关键语句
+    // WAL 模式下读端（附加的界面进程）不会阻塞写入
+    query.exec("PRAGMA journal_mode = WAL;");
+    // 每次提交都等待写盘，各持久化级别的区别只在提交的频率
+    query.exec("PRAGMA synchronous = FULL;");
+    // raw 为滤波前的原始读数，与 value 相同（未启用滤波）时为 NULL，读取时回落到 value
+    if (!query.exec("CREATE TABLE IF NOT EXISTS samples ("
+                    "key INTEGER PRIMARY KEY, "
+                    "value REAL NOT NULL, "
+                    "raw REAL)")
+        || !query.exec("CREATE TABLE IF NOT EXISTS channels ("
+                       "id INTEGER PRIMARY KEY, "
+                       "key TEXT UNIQUE NOT NULL, "
+                       "unit TEXT)")
+        || !syncChannels(true)) {
+        if (m_lastError.isEmpty())
+            m_lastError = query.lastError().text();
+        emit opened(false);
+        return false;
+    }
+
+    // 每小时每通道一行统计（见 summarize()）；low/high 为汇总时的报警阈值，未启用报警时为 NULL
+    if (!query.exec("CREATE TABLE IF NOT EXISTS sample_intervals ("
+                    "timestamp_ms INTEGER PRIMARY KEY, "
+                    "interval_ms INTEGER NOT NULL)")
+        || !query.exec("CREATE TABLE IF NOT EXISTS sample_rollups ("
+                       "hour_ms INTEGER NOT NULL, "
+                       "channel INTEGER NOT NULL, "
+                       "count INTEGER NOT NULL, "
+                       "min REAL, max REAL, "
+                       "duration_ms INTEGER NOT NULL, "
+                       "wsum REAL, wsq REAL, "
+                       "low REAL, high REAL, "
+                       "below_ms INTEGER, above_ms INTEGER, "
+                       "PRIMARY KEY (hour_ms, channel))")
+        // 没有写入数据库的派生通道的小时统计，按公式的 key 保存；列与 sample_rollups 相同。
+        // meta 中 'derived_from/<key>' 为写入端开始汇总这个通道的小时
+        || !query.exec("CREATE TABLE IF NOT EXISTS derived_rollups ("
+                       "hour_ms INTEGER NOT NULL, "
+                       "key TEXT NOT NULL, "
+                       "count INTEGER NOT NULL, "
+                       "min REAL, max REAL, "
+                       "duration_ms INTEGER NOT NULL, "
+                       "wsum REAL, wsq REAL, "
+                       "low REAL, high REAL, "
+                       "below_ms INTEGER, above_ms INTEGER, "
+                       "PRIMARY KEY (hour_ms, key))")
+        || !query.exec("CREATE TABLE IF NOT EXISTS meta ("
+                       "key TEXT PRIMARY KEY, "
+                       "value INTEGER)")
+        // 打开时做过的数据迁移，每次一行
+        || !query.exec("CREATE TABLE IF NOT EXISTS migration_log ("
+                       "at_ms INTEGER NOT NULL, "
+                       "name TEXT NOT NULL, "
+                       "detail TEXT)")
+        || !migrateSensorData()) {
+        if (m_lastError.isEmpty())
+            m_lastError = query.lastError().text();
+        emit opened(false);
+        return false;
+    }
+
+    if (m_layout == ChunkedLayout
+        && !query.exec("CREATE TABLE IF NOT EXISTS sample_chunks ("
+                       "channel INTEGER NOT NULL, "
+                       "start_ms INTEGER NOT NULL, "
+                       "end_ms INTEGER NOT NULL, "
+                       "count INTEGER NOT NULL, "
+                       "data BLOB NOT NULL, "
+                       "PRIMARY KEY (channel, start_ms))")) {
+        m_lastError = query.lastError().text();
+        emit opened(false);
+        return false;
+    }
+
+    if (m_durability != SyncEach) {
+        m_commitTimer = new QTimer(this);
+        m_commitTimer->setSingleShot(true);
+        connect(m_commitTimer, SIGNAL(timeout()), this, SLOT(onCommitTimer()));
+        m_unsavedGauge = MetricsRegistry::instance()->gauge(
+            "smarthome_db_unsaved_samples", "Samples buffered in memory and not yet committed.");
+    }
+    MetricsRegistry::instance()->gauge(
+        "smarthome_db_loss_window_milliseconds",
+        "Longest span of accepted samples that can be lost on a crash or power cut.")
+        ->set(lossWindowMs());
+
+    updateSizeGauge();
+    emit opened(true);
+    return true;
+}
+
+void SensorStorage::close()
+{
+    if (!m_db.isValid())
+        return;
+
+    if (m_importQuery)
+        endImport();
+    closeCursor();
+    if (!m_unsaved.isEmpty() && m_db.isOpen())
+        commitUnsaved();
+    delete m_commitTimer;
+    m_commitTimer = 0;
+
+    if (m_unflushed > 0 && m_db.isOpen())
+        flushChunks();
+    m_chunkStart = -1;
+    m_unflushed = 0;
+
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool SensorStorage::isOpen() const
+{
+    return m_db.isOpen();
+}
+
+bool SensorStorage::save(const SensorData &data)
+{
+    QList<SensorData> samples;
+    samples.append(data);
+    return saveBatch(samples);
+}
+
+bool SensorStorage::saveBatch(const QList<SensorData> &samples)
+{
+    if (m_layout == ChunkedLayout) {
+        for (int i = 0; i < samples.size(); ++i) {
+            if (!saveChunked(samples.at(i)))
+                return false;
+        }
+        return true;
+    }
+
+    QElapsedTimer commitTimer;
+    commitTimer.start();
+
+    // 同一采样的各通道在一个事务中写入，读取端不会看到只写了一半的采样；
+    // 一批采样共用一个事务，提交（fsync）次数与批大小无关
+    m_db.transaction();
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO samples (key, value, raw) VALUES (:key, :value, :raw)");
+    bool ok = true;
+    for (int i = 0; i < samples.size() && ok; ++i)
+        ok = insertRow(query, samples.at(i));
+    if (!ok) {
+        m_lastError = query.lastError().text();
+        m_db.rollback();
+    } else if (!m_db.commit()) {
+        m_lastError = m_db.lastError().text();
+        ok = false;
+    }
+    Metrics::dbCommitLatency()->observe(int(commitTimer.nsecsElapsed() / 1000));
+
+    if (!ok) {
+        m_dbErrorDrops->add(samples.size());
+        return false;
+    }
+    updateSizeGauge();
+    return true;
+}
+
+bool SensorStorage::insertRow(QSqlQuery &query, const SensorData &data)
+{
+    qint64 ts = data.timestamp.toMSecsSinceEpoch();
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!data.has(c) || m_dbChannel[c] < 0)
+            continue;
+        query.bindValue(":key", sampleKey(ts, m_dbChannel[c]));
+        query.bindValue(":value", data.value(c));
+        query.bindValue(":raw", data.rawValue(c) == data.value(c)
+                                ? QVariant(QVariant::Double) : QVariant(data.rawValue(c)));
+        if (!query.exec())
+            return false;
+    }
+    return true;
+}
+
+bool SensorStorage::beginImport(int commitEvery)
+{
+    if (m_importQuery)
+        return true;
+    if (!m_channelsLoaded && !syncChannels(true))
+        return false;
+
+    // WAL 下 NORMAL 提交时不等写盘，只在检查点同步；断电最多丢掉最近提交的几批，
+    // 数据库不会损坏，重新导入时已有的行被跳过。OFF 在检查点时也不同步，不用
+    QSqlQuery pragma(m_db);
+    m_importSync = pragma.exec("PRAGMA synchronous;") && pragma.next() ? pragma.value(0).toInt() : 2;
+    if (m_importSync > 1)
+        pragma.exec("PRAGMA synchronous = NORMAL;");
+
+    m_importEvery = qMax(1, commitEvery);
+    m_importPending = 0;
+    m_importDuplicates = 0;
+    if (!m_db.transaction()) {
+        m_lastError = m_db.lastError().text();
+        return false;
+    }
+    m_importHeld.start();
+    m_importQuery = new QSqlQuery(m_db);
+    m_importQuery->prepare("INSERT OR IGNORE INTO samples (key, value) VALUES (?, ?)");
+    return true;
+}
+
+bool SensorStorage::importValue(qint64 timestampMs, int channel, double value)
+{
+    int id = m_dbChannel[channel];
+    if (id < 0)
+        return true;
+
+    m_importQuery->bindValue(0, sampleKey(timestampMs, id));
+    m_importQuery->bindValue(1, value);
+    if (!m_importQuery->exec()) {
+        m_lastError = m_importQuery->lastError().text();
+        return false;
+    }
+    if (m_importQuery->numRowsAffected() == 0)
+        ++m_importDuplicates;
+
+    // 分批提交：WAL 不会无限增长，写锁按 kImportHoldMs 让出，采集进程的写入在忙等内完成。
+    // 计时每 256 个读数看一次
+    ++m_importPending;
+    if (m_importPending >= m_importEvery
+            || ((m_importPending & 0xff) == 0 && m_importHeld.elapsed() >= kImportHoldMs)) {
+        if (!m_db.commit() || !m_db.transaction()) {
+            m_lastError = m_db.lastError().text();
+            return false;
+        }
+        m_importPending = 0;
+        m_importHeld.start();
+    }
+    return true;
+}
+
+bool SensorStorage::endImport()
+{
+    if (!m_importQuery)
+        return true;
+    delete m_importQuery;
+    m_importQuery = 0;
+
+    bool ok = m_db.commit();
+    if (!ok)
+        m_lastError = m_db.lastError().text();
+    QSqlQuery pragma(m_db);
+    pragma.exec(QString("PRAGMA synchronous = %1;").arg(m_importSync));
+    invalidateCache();
+    updateSizeGauge();
+    return ok;
+}
+
+void SensorStorage::store(const SensorData &data)
+{
+    if (!m_db.isOpen()) {
+        m_dbClosedDrops->inc();
+        return;
+    }
+    if (!save(data))
+        emit writeFailed(m_lastError);
+}
+
+void SensorStorage::storeBatch(const SensorDataList &samples)
+{
+    if (!m_db.isOpen()) {
+        m_dbClosedDrops->add(samples.size());
+        return;
+    }
+
+    // 要求保存的派生通道先算出来，和基础通道一样经过死区筛选
+    SensorDataList derived;
+    if (m_persistDerived) {
+        derived = samples;
+        DerivedChannels::evaluate(&derived, m_persistDerived);
+    }
+    const SensorDataList &input = m_persistDerived ? derived : samples;
+
+    // 死区内的采样不写入
+    QList<SensorData> accepted;
+    for (int i = 0; i < input.size(); ++i) {
+        if (m_persist.accept(input.at(i)))
+            accepted.append(input.at(i));
+    }
+    if (m_durability == SyncEach) {
+        if (!accepted.isEmpty() && !saveBatch(accepted))
+            emit writeFailed(m_lastError);
+    } else if (!accepted.isEmpty()) {
+        if (m_unsaved.isEmpty()) {
+            m_unsavedAge.start();
+            m_commitTimer->start(m_commitPeriodMs);
+        }
+        m_unsaved += accepted;
+        m_unsavedGauge->set(m_unsaved.size());
+        if (m_unsavedAge.elapsed() >= m_commitPeriodMs || m_unsaved.size() >= kMaxUnsaved)
+            commitUnsaved();
+    }
+
+    // 汇总在写入端按小时生成；落后很多（首次运行、停机之后）时每批补 6 小时，
+    // 不长时间占用存储线程
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now >= m_rollupDue) {
+        // 汇总从数据库读原始记录，内存中的采样先提交
+        if (!m_unsaved.isEmpty())
+            commitUnsaved();
+        bool caughtUp = true;
+        if (!updateRollups(6, &caughtUp))
+            qWarning() << "生成统计汇总失败:" << m_lastError;
+        m_rollupDue = caughtUp ? hourFloor(now) + kHourMs + m_summaryGapMs + 60 * 1000
+                               : now + 1000;
+    }
+}
+
+bool SensorStorage::commitUnsaved()
+{
+    if (m_commitTimer)
+        m_commitTimer->stop();
+    QList<SensorData> batch;
+    batch.swap(m_unsaved);
+    if (m_unsavedGauge)
+        m_unsavedGauge->set(0);
+
+    bool ok = batch.isEmpty() || saveBatch(batch);
+    if (ok && m_layout == ChunkedLayout && m_unflushed > 0)
+        ok = flushChunks();
+    if (!ok)
+        emit writeFailed(m_lastError);
+    return ok;
+}
+
+void SensorStorage::onCommitTimer()
+{
+    commitUnsaved();
+}
+
+void SensorStorage::flushPending()
+{
+    // 保持值排在内存中的采样之后写入，分块布局要求时间顺序
+    if (!m_unsaved.isEmpty())
+        commitUnsaved();
+    if (m_persist.hasPending())
+        store(m_persist.takePending());
+}
+
+void SensorStorage::storeIntervalChange(const QDateTime &at, int intervalMs)
+{
+    if (!m_db.isOpen())
+        return;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO sample_intervals (timestamp_ms, interval_ms) "
+                  "VALUES (:ts, :interval)");
+    query.bindValue(":ts", at.toMSecsSinceEpoch());
+    query.bindValue(":interval", intervalMs);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        emit writeFailed(m_lastError);
+    }
+}
+
+bool SensorStorage::queryRange(const QDate &start, const QDate &end, QList<SensorData> *out,
+                               quint32 derived, int maxRows)
+{
+    out->clear();
+    m_truncated = false;
+    // 缓存和热层中保存的是存储的记录，补出的采样只在结果中
+    if (!collectRange(start, end, out, 0, derived, maxRows) || !expandSteps(out))
+        return false;
+    if (maxRows > 0 && out->size() > maxRows) {
+        out->erase(out->begin() + maxRows, out->end());
+        m_truncated = true;
+    }
+    return true;
+}
+
+bool SensorStorage::expandSteps(QList<SensorData> *rows)
+{
+    // 多数时候没有需要补的间隔（没有启用死区）：最短的间隔可以看作采样周期，
+    // 没有比它长一半以上的间隔时不必读采样周期
+    const int n = rows->size();
+    qint64 shortest = m_summaryGapMs;
+    for (int i = 0; i + 1 < n; ++i) {
+        qint64 gap = rows->at(i + 1).timestamp.msecsTo(rows->at(i).timestamp);
+        if (gap > 0)
+            shortest = qMin(shortest, gap);
+    }
+    int firstGap = -1;
+    for (int i = 0; i + 1 < n && firstGap < 0; ++i) {
+        qint64 gap = rows->at(i + 1).timestamp.msecsTo(rows->at(i).timestamp);
+        if (gap > shortest * 3 / 2 && gap <= m_summaryGapMs)
+            firstGap = i;
+    }
+    if (firstGap < 0)
+        return true;
+
+    // 范围内生效的采样周期，键为开始时间
+    qint64 from = rows->last().timestamp.toMSecsSinceEpoch();
+    qint64 to = rows->first().timestamp.toMSecsSinceEpoch();
+    QMap<qint64, int> intervals;
+    intervals.insert(from, intervalAt(rows->last().timestamp));
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT timestamp_ms, interval_ms FROM sample_intervals "
+                  "WHERE timestamp_ms > :from AND timestamp_ms <= :to");
+    query.bindValue(":from", from);
+    query.bindValue(":to", to);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    while (query.next())
+        intervals.insert(query.value(0).toLongLong(), query.value(1).toInt());
+
+    QList<SensorData> expanded;
+    expanded.reserve(n);
+    for (int i = 0; i < firstGap; ++i)
+        expanded.append(rows->at(i));
+    for (int i = firstGap; i < n; ++i) {
+        expanded.append(rows->at(i));
+        if (i + 1 == n)
+            break;
+        const SensorData &older = rows->at(i + 1);
+        if (older.timestamp.msecsTo(rows->at(i).timestamp) > m_summaryGapMs)
+            continue;
+        QMap<qint64, int>::const_iterator it =
+            intervals.upperBound(older.timestamp.toMSecsSinceEpoch());
+        --it;
+        QList<SensorData> held;
+        PersistencePolicy::fillSteps(older, rows->at(i), it.value(), &held);
+        for (int k = held.size() - 1; k >= 0; --k)
+            expanded.append(held.at(k));
+    }
+    rows->swap(expanded);
+    return true;
+}
+
+bool SensorStorage::aggregateRange(const QDate &start, const QDate &end,
+                                   QVector<ChannelAggregate> *out, quint32 derived)
+{
+    out->fill(ChannelAggregate(), SensorData::MAX_CHANNELS);
+    m_truncated = false;
+    return collectRange(start, end, 0, out, derived, 0);
+}
+
+// rows 按时间倒序
+static void takeRows(const QList<SensorData> &rows, QList<SensorData> *out,
+                     QVector<ChannelAggregate> *aggregates)
+{
+    if (out)
+        *out += rows;
+    if (!aggregates)
+        return;
+    for (int i = 0; i < rows.size(); ++i) {
+        for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+            if (rows.at(i).has(c))
+                (*aggregates)[c].add(rows.at(i).value(c));
+        }
+    }
+}
+
+// 结果已经够 maxRows 条时截掉更早的部分，返回 true 表示不必再往前取
+static bool reachedLimit(QList<SensorData> *out, int maxRows)
+{
+    if (!out || maxRows <= 0 || out->size() < maxRows)
+        return false;
+    out->erase(out->begin() + maxRows, out->end());
+    return true;
+}
+
+bool SensorStorage::collectRange(const QDate &start, const QDate &end, QList<SensorData> *out,
+                                 QVector<ChannelAggregate> *aggregates, quint32 derived,
+                                 int maxRows)
+{
+    qint64 from = dayStartMs(start);
+    qint64 to = dayStartMs(end.addDays(1));
+
+    // 热层覆盖的最近部分不访问数据库
+    qint64 split = to;
+    if (m_hot && m_hot->coveredFrom() < to) {
+        split = qMax(from, m_hot->coveredFrom());
+        QList<SensorData> recent;
+        m_hot->query(split, to, &recent, derived);
+        QList<SensorData> rows;
+        rows.reserve(recent.size());
+        for (int i = recent.size() - 1; i >= 0; --i)
+            rows.append(recent.at(i));
+        takeRows(rows, out, aggregates);
+        m_truncated = reachedLimit(out, maxRows);
+    }
+    if (split <= from || m_truncated)
+        return true;
+
+    if (!m_cache) {
+        QList<SensorData> rows;
+        if (!queryUncached(from, split, &rows))
+            return false;
+        DerivedChannels::evaluate(&rows, derived);
+        takeRows(rows, out, aggregates);
+        m_truncated = reachedLimit(out, maxRows);
+        return true;
+    }
+
+    // 热层起点所在的那一天只有前一部分在数据库中，不经过缓存
+    QDate day = QDateTime::fromMSecsSinceEpoch(split - 1).date();
+    if (split != dayStartMs(day.addDays(1))) {
+        QList<SensorData> rows;
+        if (!queryUncached(qMax(from, dayStartMs(day)), split, &rows))
+            return false;
+        DerivedChannels::evaluate(&rows, derived);
+        takeRows(rows, out, aggregates);
+        day = day.addDays(-1);
+        m_truncated = reachedLimit(out, maxRows);
+    }
+
+    // 其余按天取，新的在前；重复和重叠的范围大部分天直接从缓存取，
+    // 汇总值随块一起缓存，不需要展开采样
+    qint64 persisted = persistedUntil();
+    for (; day >= start && !m_truncated; day = day.addDays(-1)) {
+        if (!loadDay(day, out, aggregates, derived, persisted))
+            return false;
+        m_truncated = reachedLimit(out, maxRows);
+    }
+    return true;
+}
+
+static void mergeBlockAggregates(const HistoryBlock *block, QVector<ChannelAggregate> *aggregates)
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        (*aggregates)[c].merge(block->aggregate(c));
+}
+
+bool SensorStorage::loadDay(const QDate &day, QList<SensorData> *out,
+                            QVector<ChannelAggregate> *aggregates, quint32 derived,
+                            qint64 persisted)
+{
+    HistoryBlock *block = m_cache->find(day);
+    if (block && block->closed && block->derive(derived)) {
+        // 第一次要求这些派生通道：算出后按新的大小重新放入
+        block = m_cache->take(day);
+        if (out)
+            block->appendTo(out, true);
+        if (aggregates)
+            mergeBlockAggregates(block, aggregates);
+        m_cache->insert(day, block);
+        return true;
+    }
+    if (block && block->closed) {
+        if (out)
+            block->appendTo(out, true);
+        if (aggregates)
+            mergeBlockAggregates(block, aggregates);
+        return true;
+    }
+
+    // 数据库中已经有当天结束之后的采样，当天的采样就都已写入（分块布局的写回、
+    // GroupCommit 的提交可能晚很久，不能按时钟判断）；水位在查询之前取，
+    // 查询期间才越过的块下次还会再补一次
+    bool closed = persisted >= dayStartMs(day.addDays(1));
+
+    if (block) {
+        // 未封闭的块只补上之后写入的记录
+        block = m_cache->take(day);
+        QList<SensorData> rows;
+        qint64 cursor = block->cursor;
+        if (!fetchSince(block->cursor, &rows, &cursor)) {
+            delete block;
+            return false;
+        }
+        qint64 last = block->lastTimestamp();
+        for (int i = 0; i < rows.size(); ++i) {
+            const SensorData &data = rows.at(i);
+            if (data.timestamp.date() == day && data.timestamp.toMSecsSinceEpoch() > last)
+                block->append(data);
+        }
+        block->cursor = cursor;
+    } else {
+        // 游标在查询之前取，之间写入的记录补的时候按时间戳去重
+        block = new HistoryBlock;
+        block->cursor = maxId();
+        QList<SensorData> rows;
+        if (!queryUncached(dayStartMs(day), dayStartMs(day.addDays(1)), &rows)) {
+            delete block;
+            return false;
+        }
+        for (int i = rows.size() - 1; i >= 0; --i)
+            block->append(rows.at(i));
+    }
+    block->derive(derived);
+    block->closed = closed;
+
+    // 超过预算的块插入时即被删除，先取出结果
+    if (out)
+        block->appendTo(out, true);
+    if (aggregates)
+        mergeBlockAggregates(block, aggregates);
+    m_cache->insert(day, block);
+    return true;
+}
+
+bool SensorStorage::queryUncached(qint64 from, qint64 to, QList<SensorData> *out)
+{
+    int first = out->size();
+    if (!queryRows(from, to, out))
+        return false;
+    if (m_layout != ChunkedLayout)
+        return true;
+
+    // 切换布局前的行和块在时间上一般不重叠，只有两者都有数据时才需要重新排序
+    bool hasRows = out->size() > first;
+    QList<SensorData> samples;
+    if (!readChunks(from, to, &samples))
+        return false;
+    for (int i = samples.size() - 1; i >= 0; --i)
+        out->append(samples.at(i));
+    if (hasRows && !samples.isEmpty())
+        qStableSort(out->begin() + first, out->end(), newerFirst);
+    return true;
+}
+
+bool SensorStorage::queryRows(qint64 from, qint64 to, QList<SensorData> *out)
+{
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT key, value, COALESCE(raw, value) FROM samples "
+                  "WHERE key >= :from AND key < :to ORDER BY key DESC");
+    query.bindValue(":from", sampleKey(from, 0));
+    query.bindValue(":to", sampleKey(to, 0));
+
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    qint64 lastKey;
+    readSampleRows(query, out, &lastKey);
+    return true;
+}
+
+bool SensorStorage::fetchSince(qint64 afterId, QList<SensorData> *out, qint64 *lastId)
+{
+    if (m_layout == ChunkedLayout) {
+        int first = out->size();
+        // 块被写回时整体替换，已读过的部分按时间戳跳过
+        if (!readChunks(afterId + 1, Q_INT64_C(0x7fffffffffffffff), out))
+            return false;
+        *lastId = afterId;
+        for (int i = first; i < out->size(); ++i)
+            *lastId = qMax(*lastId, out->at(i).timestamp.toMSecsSinceEpoch());
+        return true;
+    }
+
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT key, value, COALESCE(raw, value) FROM samples "
+                  "WHERE key > :key ORDER BY key");
+    query.bindValue(":key", afterId);
+
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    *lastId = afterId;
+    readSampleRows(query, out, lastId);
+    return true;
+}
+
+void SensorStorage::readSampleRows(QSqlQuery &query, QList<SensorData> *out, qint64 *lastKey)
+{
+    SensorData data;
+    qint64 current = -1;
+    while (query.next()) {
+        qint64 key = query.value(0).toLongLong();
+        qint64 ts = key >> kChannelBits;
+        if (ts != current) {
+            if (!data.isEmpty())
+                out->append(data);
+            data = SensorData();
+            data.timestamp = QDateTime::fromMSecsSinceEpoch(ts);
+            current = ts;
+        }
+        *lastKey = key;
+        int c = m_channelIndex[key & (MAX_DB_CHANNELS - 1)];
+        if (c >= 0)
+            data.setValue(c, query.value(1).toDouble(), query.value(2).toDouble());
+    }
+    if (!data.isEmpty())
+        out->append(data);
+}
+
+bool SensorStorage::openCursor(qint64 from, qint64 to)
+{
+    closeCursor();
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+    m_cursorFrom = from;
+    m_cursorTo = to;
+    if (m_layout == ChunkedLayout)
+        return true;
+
+    m_cursorQuery = new QSqlQuery(m_db);
+    m_cursorQuery->setForwardOnly(true);
+    m_cursorQuery->prepare("SELECT key, value, COALESCE(raw, value) FROM samples "
+                           "WHERE key >= :from AND key < :to ORDER BY key");
+    m_cursorQuery->bindValue(":from", sampleKey(from, 0));
+    m_cursorQuery->bindValue(":to", sampleKey(to, 0));
+    if (!m_cursorQuery->exec()) {
+        m_lastError = m_cursorQuery->lastError().text();
+        closeCursor();
+        return false;
+    }
+    return true;
+}
+
+bool SensorStorage::readCursor(QList<SensorData> *out, int maxSamples)
+{
+    int first = out->size();
+    if (m_layout == ChunkedLayout) {
+        // 切换布局前的行也在 queryUncached() 中一并读出
+        while (out->size() - first < maxSamples && m_cursorFrom < m_cursorTo) {
+            qint64 next = qMin(m_cursorTo, m_cursorFrom + m_chunkMs);
+            QList<SensorData> rows;
+            if (!queryUncached(m_cursorFrom, next, &rows))
+                return false;
+            for (int i = rows.size() - 1; i >= 0; --i)
+                out->append(rows.at(i));
+            m_cursorFrom = next;
+        }
+        return true;
+    }
+
+    if (!m_cursorQuery)
+        return true;
+    // 同一时间戳的行相邻，最后一个采样可能还有行没读到，留到下一次交出
+    while (m_cursorQuery->next()) {
+        qint64 key = m_cursorQuery->value(0).toLongLong();
+        qint64 ts = key >> kChannelBits;
+        if (ts != m_cursorTs) {
+            if (!m_cursorSample.isEmpty())
+                out->append(m_cursorSample);
+            m_cursorSample = SensorData();
+            m_cursorSample.timestamp = QDateTime::fromMSecsSinceEpoch(ts);
+            m_cursorTs = ts;
+        }
+        int c = m_channelIndex[key & (MAX_DB_CHANNELS - 1)];
+        if (c >= 0)
+            m_cursorSample.setValue(c, m_cursorQuery->value(1).toDouble(),
+                                    m_cursorQuery->value(2).toDouble());
+        if (out->size() - first >= maxSamples)
+            return true;
+    }
+    if (m_cursorQuery->lastError().isValid()) {
+        m_lastError = m_cursorQuery->lastError().text();
+        return false;
+    }
+    if (!m_cursorSample.isEmpty())
+        out->append(m_cursorSample);
+    closeCursor();
+    return true;
+}
+
+void SensorStorage::closeCursor()
+{
+    delete m_cursorQuery;
+    m_cursorQuery = 0;
+    m_cursorTs = -1;
+    m_cursorSample = SensorData();
+}
+
+qint64 SensorStorage::persistedUntil()
+{
+    qint64 until = -1;
+    QSqlQuery query(m_db);
+    if (query.exec("SELECT MAX(key) FROM samples") && query.next() && !query.isNull(0))
+        until = query.value(0).toLongLong() >> kChannelBits;
+    if (m_layout == ChunkedLayout
+        && query.exec("SELECT MAX(end_ms) FROM sample_chunks") && query.next()
+        && !query.isNull(0))
+        until = qMax(until, query.value(0).toLongLong());
+    return until;
+}
+
+qint64 SensorStorage::maxId()
+{
+    QSqlQuery query(m_db);
+    if (m_layout == ChunkedLayout) {
+        if (query.exec("SELECT MAX(end_ms) FROM sample_chunks") && query.next())
+            return query.value(0).toLongLong();
+        return 0;
+    }
+    if (query.exec("SELECT MAX(key) FROM samples") && query.next())
+        return query.value(0).toLongLong();
+    return 0;
+}
+
+// ============== 通道编号 ==============
+
+bool SensorStorage::syncChannels(bool assign)
+{
+    const ChannelRegistry *registry = ChannelRegistry::instance();
+    QSqlQuery query(m_db);
+
+    if (assign) {
+        // 内置通道的编号固定，旧数据迁移和外部工具都依赖这一点
+        query.prepare("INSERT OR IGNORE INTO channels (id, key, unit) VALUES (:id, :key, :unit)");
+        for (int c = 0; c < registry->count(); ++c) {
+            const ChannelInfo &info = registry->at(c);
+            // 派生通道只有要求保存时才分配编号
+            if (info.isDerived() && !info.persist)
+                continue;
+            bool builtin = c == CHANNEL_TEMPERATURE || c == CHANNEL_HUMIDITY;
+            query.bindValue(":id", builtin ? QVariant(c) : QVariant(QVariant::Int));
+            query.bindValue(":key", info.key);
+            query.bindValue(":unit", info.unit);
+            if (!query.exec()) {
+                m_lastError = query.lastError().text();
+                return false;
+            }
+        }
+    }
+
+    if (!query.exec("SELECT id, key FROM channels")) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_dbChannel[c] = -1;
+    for (int id = 0; id < MAX_DB_CHANNELS; ++id)
+        m_channelIndex[id] = -1;
+    while (query.next()) {
+        int id = query.value(0).toInt();
+        int c = registry->indexOf(query.value(1).toString());
+        if (id < 0 || id >= MAX_DB_CHANNELS) {
+            qWarning() << "通道编号超出范围，忽略:" << query.value(1).toString() << id;
+            continue;
+        }
+        m_channelIndex[id] = c;
+        if (c >= 0)
+            m_dbChannel[c] = id;
+    }
+    m_persistDerived = 0;
+    for (int c = 0; c < registry->count(); ++c) {
+        if (registry->at(c).persist && m_dbChannel[c] >= 0)
+            m_persistDerived |= 1u << c;
+    }
+    m_channelsLoaded = true;
+    return true;
+}
+
+// 旧版每个采样一行的 sensor_data 宽表：复制到 samples，原表保留不动，
+// 旧版程序和直接读这张表的外部工具照常可用。meta 中 'sensor_data_migrated' 为已复制的最大 id，
+// 之后旧版程序追加的行在下次打开时接着复制。一次一个事务，中途失败时下次打开重试
+bool SensorStorage::migrateSensorData()
+{
+    if (!m_db.tables().contains("sensor_data"))
+        return true;
+
+    int temperature = m_dbChannel[CHANNEL_TEMPERATURE];
+    int humidity = m_dbChannel[CHANNEL_HUMIDITY];
+
+    QSqlQuery rows(m_db);
+    rows.setForwardOnly(true);
+    qint64 lastId = 0;
+    if (rows.exec("SELECT value FROM meta WHERE key = 'sensor_data_migrated'") && rows.next())
+        lastId = rows.value(0).toLongLong();
+    rows.finish();
+
+    m_db.transaction();
+    QSqlQuery insert(m_db);
+    insert.prepare("INSERT OR IGNORE INTO samples (key, value, raw) VALUES (:key, :value, :raw)");
+
+    rows.prepare("SELECT * FROM sensor_data WHERE id > ? ORDER BY id");
+    rows.bindValue(0, lastId);
+    bool ok = rows.exec();
+    QSqlRecord record = rows.record();
+    int idCol = record.indexOf("id");
+    int tsCol = record.indexOf("timestamp");
+    int valueCol[2] = { record.indexOf("temperature"), record.indexOf("humidity") };
+    int rawCol[2] = { record.indexOf("temperature_raw"), record.indexOf("humidity_raw") };
+    int dbChannel[2] = { temperature, humidity };
+    int migrated = 0;
+
+    qint64 firstId = -1;
+    while (ok && rows.next()) {
+        lastId = rows.value(idCol).toLongLong();
+        if (firstId < 0)
+            firstId = lastId;
+        qint64 ts = rows.value(tsCol).toDateTime().toMSecsSinceEpoch();
+        for (int i = 0; i < 2 && ok; ++i) {
+            if (valueCol[i] < 0 || dbChannel[i] < 0 || rows.value(valueCol[i]).isNull())
+                continue;
+            QVariant raw = rawCol[i] >= 0 ? rows.value(rawCol[i]) : QVariant();
+            if (raw.isNull() || raw.toDouble() == rows.value(valueCol[i]).toDouble())
+                raw = QVariant(QVariant::Double);
+            insert.bindValue(":key", sampleKey(ts, dbChannel[i]));
+            insert.bindValue(":value", rows.value(valueCol[i]));
+            insert.bindValue(":raw", raw);
+            ok = insert.exec();
+        }
+        ++migrated;
+    }
+    if (ok && migrated > 0) {
+        insert.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES ('sensor_data_migrated', ?)");
+        insert.bindValue(0, lastId);
+        ok = insert.exec();
+    }
+    if (ok && migrated > 0) {
+        insert.prepare("INSERT INTO migration_log (at_ms, name, detail) VALUES (?, ?, ?)");
+        insert.bindValue(0, QDateTime::currentMSecsSinceEpoch());
+        insert.bindValue(1, QString("sensor_data -> samples"));
+        insert.bindValue(2, QString("id %1..%2, %3 rows; sensor_data kept")
+                            .arg(firstId).arg(lastId).arg(migrated));
+        ok = insert.exec();
+    }
+
+    if (!ok || !m_db.commit()) {
+        m_lastError = insert.lastError().isValid() ? insert.lastError().text()
+                                                   : rows.lastError().text();
+        m_db.rollback();
+        qWarning() << "迁移 sensor_data 失败:" << m_lastError;
+        return false;
+    }
+    if (migrated > 0)
+        qDebug() << "已迁移 sensor_data:" << migrated << "条，原表保留";
+    return true;
+}
+
+// ============== 分块布局 ==============
+
+bool SensorStorage::saveChunked(const SensorData &data)
+{
+    qint64 ts = data.timestamp.toMSecsSinceEpoch();
+    qint64 start = ts - ts % m_chunkMs;
+
+    if (start != m_chunkStart && !switchChunk(start))
+        return false;
+
+    // 每个通道独立成块，某个采样缺少的通道只是少一个点
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (data.has(c) && m_dbChannel[c] >= 0)
+            m_chunks[c].append(ts, data.value(c), data.rawValue(c));
+    }
+
+    if (++m_unflushed >= m_flushEvery)
+        return flushChunks();
+    return true;
+}
+
+// 写回当前块，然后切换到 chunkStart 开始的块。
+// 数据库中已有该块（重启后继续写当前小时，或系统时间回拨）时解码后继续追加。
+bool SensorStorage::switchChunk(qint64 chunkStart)
+{
+    if (m_unflushed > 0 && !flushChunks())
+        return false;
+
+    const ChannelRegistry *registry = ChannelRegistry::instance();
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        m_chunks[c].clear();
+        if (c < registry->count())
+            m_chunks[c].setDecimals(registry->at(c).storageDecimals);
+    }
+    m_chunkStart = chunkStart;
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT channel, data FROM sample_chunks WHERE start_ms = :start");
+    query.bindValue(":start", chunkStart);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        int id = query.value(0).toInt();
+        int channel = id >= 0 && id < MAX_DB_CHANNELS ? m_channelIndex[id] : -1;
+        if (channel < 0)
+            continue;
+        ChunkDecoder decoder(query.value(1).toByteArray());
+        qint64 ts;
+        double value, raw;
+        while (decoder.next(&ts, &value, &raw))
+            m_chunks[channel].append(ts, value, raw);
+    }
+    return true;
+}
+
+bool SensorStorage::flushChunks()
+{
+    QElapsedTimer commitTimer;
+    commitTimer.start();
+
+    m_db.transaction();
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO sample_chunks (channel, start_ms, end_ms, count, data) "
+                  "VALUES (:channel, :start, :end, :count, :data)");
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        const ChunkEncoder &chunk = m_chunks[c];
+        if (chunk.count() == 0)
+            continue;
+        query.bindValue(":channel", m_dbChannel[c]);
+        query.bindValue(":start", m_chunkStart);
+        query.bindValue(":end", chunk.lastTimestamp());
+        query.bindValue(":count", chunk.count());
+        query.bindValue(":data", chunk.data());
+        if (!query.exec()) {
+            m_lastError = query.lastError().text();
+            m_db.rollback();
+            m_dbErrorDrops->add(m_unflushed);
+            m_unflushed = 0;
+            return false;
+        }
+    }
+    bool ok = m_db.commit();
+    Metrics::dbCommitLatency()->observe(int(commitTimer.nsecsElapsed() / 1000));
+
+    if (!ok) {
+        m_lastError = m_db.lastError().text();
+        m_dbErrorDrops->add(m_unflushed);
+        m_unflushed = 0;
+        return false;
+    }
+    m_unflushed = 0;
+    updateSizeGauge();
+    return true;
+}
+
+bool SensorStorage::readChunks(qint64 from, qint64 to, QList<SensorData> *out)
+{
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT channel, start_ms, data FROM sample_chunks "
+                  "WHERE start_ms < :to AND end_ms >= :from "
+                  "ORDER BY start_ms, channel");
+    query.bindValue(":from", from);
+    query.bindValue(":to", to);
+
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    // 同一起始时间的各通道块一起解码，按时间戳合并成采样；
+    // 死区或缺失的读数使各通道的采样数不一定相同
+    QMap<qint64, SensorData> merged;
+    qint64 groupStart = -1;
+    bool more = query.next();
+    while (more) {
+        qint64 start = query.value(1).toLongLong();
+        if (start != groupStart) {
+            for (QMap<qint64, SensorData>::const_iterator it = merged.constBegin();
+                 it != merged.constEnd(); ++it)
+                out->append(it.value());
+            merged.clear();
+            groupStart = start;
+        }
+
+        int id = query.value(0).toInt();
+        int channel = id >= 0 && id < MAX_DB_CHANNELS ? m_channelIndex[id] : -1;
+        if (channel >= 0) {
+            ChunkDecoder decoder(query.value(2).toByteArray());
+            qint64 ts;
+            double value, raw;
+            while (decoder.next(&ts, &value, &raw)) {
+                if (ts < from || ts >= to)
+                    continue;
+                SensorData &data = merged[ts];
+                if (data.isEmpty())
+                    data.timestamp = QDateTime::fromMSecsSinceEpoch(ts);
+                data.setValue(channel, value, raw);
+            }
+        }
+        more = query.next();
+    }
+    for (QMap<qint64, SensorData>::const_iterator it = merged.constBegin();
+         it != merged.constEnd(); ++it)
+        out->append(it.value());
+    return true;
+}
+
+// ============== 汇总 ==============
+
+qint64 SensorStorage::rollupWatermark()
+{
+    QSqlQuery query(m_db);
+    if (query.exec("SELECT value FROM meta WHERE key = 'rollup_until'") && query.next())
+        return query.value(0).toLongLong();
+    return 0;
+}
+
+qint64 SensorStorage::firstSampleMs()
+{
+    qint64 first = -1;
+    QSqlQuery query(m_db);
+    if (query.exec("SELECT MIN(key) FROM samples") && query.next() && !query.isNull(0))
+        first = query.value(0).toLongLong() >> kChannelBits;
+    if (m_layout == ChunkedLayout
+        && query.exec("SELECT MIN(start_ms) FROM sample_chunks") && query.next()
+        && !query.isNull(0)) {
+        qint64 chunk = query.value(0).toLongLong();
+        first = first < 0 ? chunk : qMin(first, chunk);
+    }
+    return first;
+}
+
+bool SensorStorage::updateRollups(int maxHours, bool *caughtUp)
+{
+    *caughtUp = true;
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    // 只汇总数据库中的采样已经越过的小时：这一小时的采样都已写入（分块布局按 flushEvery
+    // 写回、GroupCommit 按周期提交，可能晚很久），保持时间也由后面的记录确定。
+    // 一小时结束后同时还要等最后一个值的保持时间
+    qint64 ready = hourFloor(QDateTime::currentMSecsSinceEpoch()
+                             - qMax(m_summaryGapMs, qint64(600 * 1000)) - 60 * 1000);
+    qint64 persisted = persistedUntil();
+    if (persisted < 0)
+        return true;
+    ready = qMin(ready, hourFloor(persisted));
+    qint64 until = rollupWatermark();
+    bool fresh = until == 0;
+    if (fresh) {
+        qint64 first = firstSampleMs();
+        until = first < 0 ? ready : hourFloor(first);
+    }
+    if (until >= ready)
+        return fresh ? buildRollups(ready, ready, ready) : true;
+
+    qint64 stop = qMin(ready, until + qint64(qMax(1, maxHours)) * kHourMs);
+    *caughtUp = stop >= ready;
+    return buildRollups(until, stop, stop);
+}
+
+bool SensorStorage::rebuildRollups(qint64 from, qint64 to)
+{
+    qint64 until = rollupWatermark();
+    from = hourFloor(from);
+    to = qMin(hourCeil(to), until);
+    if (from >= to)
+        return true;
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    // 一次处理一天，内存占用有上限
+    for (qint64 start = from; start < to; start += 24 * kHourMs) {
+        if (!buildRollups(start, qMin(to, start + 24 * kHourMs), -1))
+            return false;
+    }
+    return true;
+}
+
+// 一个通道一小时的统计绑定到 sample_rollups/derived_rollups 的插入语句，channel 为第二列
+static void bindRollup(QSqlQuery &query, qint64 hour, const QVariant &channel,
+                       const ChannelSummary &summary, const ChannelInfo *info)
+{
+    bool alarm = info && info->alarmEnabled;
+    QVariant none(QVariant::Double);
+    query.bindValue(0, hour);
+    query.bindValue(1, channel);
+    query.bindValue(2, summary.count);
+    query.bindValue(3, summary.min);
+    query.bindValue(4, summary.max);
+    query.bindValue(5, summary.durationMs);
+    query.bindValue(6, summary.weightedSum);
+    query.bindValue(7, summary.weightedSquares);
+    query.bindValue(8, alarm ? QVariant(info->alarmMin) : none);
+    query.bindValue(9, alarm ? QVariant(info->alarmMax) : none);
+    query.bindValue(10, summary.belowMs);
+    query.bindValue(11, summary.aboveMs);
+}
+
+bool SensorStorage::buildRollups(qint64 from, qint64 to, qint64 watermark)
+{
+    // 没有写入数据库的派生通道一起积分，统计时不必再读原始记录
+    quint32 derived = unsavedDerived();
+    QMap<qint64, SummaryBucket> hours;
+    if (from < to && !integrateRaw(from, to, &hours, derived))
+        return false;
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    m_db.transaction();
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM sample_rollups WHERE hour_ms >= ? AND hour_ms < ?");
+    query.bindValue(0, from);
+    query.bindValue(1, to);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM derived_rollups WHERE hour_ms >= ? AND hour_ms < ?");
+        query.bindValue(0, from);
+        query.bindValue(1, to);
+        ok = query.exec();
+    }
+
+    QSqlQuery derivedQuery(m_db);
+    query.prepare("INSERT OR REPLACE INTO sample_rollups "
+                  "(hour_ms, channel, count, min, max, duration_ms, wsum, wsq, "
+                  "low, high, below_ms, above_ms) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    derivedQuery.prepare("INSERT OR REPLACE INTO derived_rollups "
+                         "(hour_ms, key, count, min, max, duration_ms, wsum, wsq, "
+                         "low, high, below_ms, above_ms) "
+                         "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    for (QMap<qint64, SummaryBucket>::const_iterator it = hours.constBegin();
+         ok && it != hours.constEnd(); ++it) {
+        for (int c = 0; ok && c < SensorData::MAX_CHANNELS; ++c) {
+            const ChannelSummary &summary = it.value().channels[c];
+            if (!summary.hasData())
+                continue;
+            const ChannelInfo *info = c < channels->count() ? &channels->at(c) : 0;
+            if (m_dbChannel[c] >= 0) {
+                bindRollup(query, it.key(), m_dbChannel[c], summary, info);
+                ok = query.exec();
+            } else if (derived & (1u << c)) {
+                bindRollup(derivedQuery, it.key(), info->key, summary, info);
+                ok = derivedQuery.exec();
+            }
+        }
+    }
+
+    if (ok && watermark >= 0) {
+        query.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES ('rollup_until', ?)");
+        query.bindValue(0, watermark);
+        ok = query.exec();
+    }
+    if (ok && watermark >= 0) {
+        // 新启用的派生通道从这一段开始有汇总；停用的去掉起点，再启用时重新开始，
+        // 中间没有汇总的小时不会被当成没有数据
+        QStringList keys;
+        query.prepare("INSERT OR IGNORE INTO meta (key, value) VALUES (?, ?)");
+        for (int c = 0; ok && c < channels->count(); ++c) {
+            if (!(derived & (1u << c)))
+                continue;
+            keys << "derived_from/" + channels->at(c).key;
+            query.bindValue(0, keys.last());
+            query.bindValue(1, from);
+            ok = query.exec();
+        }
+        if (ok) {
+            QString placeholders;
+            for (int i = 0; i < keys.size(); ++i)
+                placeholders += i == 0 ? "?" : ", ?";
+            query.prepare(QString("DELETE FROM meta WHERE key LIKE 'derived_from/%' "
+                                  "AND key NOT IN (%1)").arg(placeholders));
+            for (int i = 0; i < keys.size(); ++i)
+                query.bindValue(i, keys.at(i));
+            ok = query.exec();
+        }
+    }
+
+    if (!ok) {
+        m_lastError = (derivedQuery.lastError().isValid() ? derivedQuery : query).lastError().text();
+        m_db.rollback();
+        return false;
+    }
+    if (!m_db.commit()) {
+        m_lastError = m_db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SensorStorage::integrateRaw(qint64 from, qint64 to, QMap<qint64, SummaryBucket> *hours,
+                                 quint32 derived)
+{
+    // 前后各多取 maxGap：from 之前的值可能保持到 from 之后，to 之后的记录决定最后一个值保持多久
+    QList<SensorData> rows;
+    if (!queryUncached(from - m_summaryGapMs, to + m_summaryGapMs, &rows))
+        return false;
+    DerivedChannels::evaluate(&rows, derived);
+    QList<SensorData> samples;
+    samples.reserve(rows.size());
+    for (int i = rows.size() - 1; i >= 0; --i)
+        samples.append(rows.at(i));
+
+    // 还在进行中的时段，最后一个值只保持到现在
+    to = qMin(to, QDateTime::currentMSecsSinceEpoch());
+    if (from < to)
+        integrateSteps(samples, from, to, kHourMs, m_summaryGapMs, hours);
+    return true;
+}
+
+// 一行 sample_rollups/derived_rollups 的统计放入 hours 中通道 c；
+// 阈值与汇总时不同、且这一小时跨过新阈值的，小时起点放入 recheck
+static void takeRollup(const QSqlQuery &query, int c, const ChannelInfo &info,
+                       QMap<qint64, SummaryBucket> *hours, QList<qint64> *recheck)
+{
+    qint64 hour = query.value(0).toLongLong();
+    SummaryBucket &bucket = (*hours)[hour];
+    bucket.startMs = hour;
+    ChannelSummary &summary = bucket.channels[c];
+    summary.count = query.value(2).toInt();
+    summary.min = query.value(3).toDouble();
+    summary.max = query.value(4).toDouble();
+    summary.durationMs = query.value(5).toLongLong();
+    summary.weightedSum = query.value(6).toDouble();
+    summary.weightedSquares = query.value(7).toDouble();
+    summary.belowMs = 0;
+    summary.aboveMs = 0;
+
+    if (!info.alarmEnabled)
+        return;
+    bool sameThresholds = !query.isNull(8) && !query.isNull(9)
+                       && query.value(8).toDouble() == info.alarmMin
+                       && query.value(9).toDouble() == info.alarmMax;
+    if (sameThresholds) {
+        summary.belowMs = query.value(10).toLongLong();
+        summary.aboveMs = query.value(11).toLongLong();
+        return;
+    }
+
+    // 阈值改过：整小时都在阈值一侧的直接得出，跨过阈值的小时重新积分
+    if (summary.min > info.alarmMax)
+        summary.aboveMs = summary.durationMs;
+    if (summary.max < info.alarmMin)
+        summary.belowMs = summary.durationMs;
+    bool crossesHigh = summary.max > info.alarmMax && summary.min <= info.alarmMax;
+    bool crossesLow = summary.min < info.alarmMin && summary.max >= info.alarmMin;
+    if ((crossesHigh || crossesLow) && !recheck->contains(hour))
+        recheck->append(hour);
+}
+
+bool SensorStorage::readRollups(qint64 from, qint64 to, QMap<qint64, SummaryBucket> *hours,
+                                QList<qint64> *recheck)
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT hour_ms, channel, count, min, max, duration_ms, wsum, wsq, "
+                  "low, high, below_ms, above_ms "
+                  "FROM sample_rollups WHERE hour_ms >= ? AND hour_ms < ?");
+    query.bindValue(0, from);
+    query.bindValue(1, to);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    while (query.next()) {
+        int id = query.value(1).toInt();
+        int c = id >= 0 && id < MAX_DB_CHANNELS ? m_channelIndex[id] : -1;
+        if (c >= 0)
+            takeRollup(query, c, channels->at(c), hours, recheck);
+    }
+    return true;
+}
+
+bool SensorStorage::readDerivedRollups(qint64 from, qint64 to, quint32 derived,
+                                       QMap<qint64, SummaryBucket> *hours, QList<qint64> *recheck,
+                                       quint32 *missing, qint64 *missingTo)
+{
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT key, value FROM meta WHERE key LIKE 'derived_from/%'")) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    qint64 since[SensorData::MAX_CHANNELS];
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        since[c] = -1;
+    while (query.next()) {
+        int c = channels->indexOf(query.value(0).toString().mid(int(sizeof("derived_from/")) - 1));
+        if (c >= 0 && (derived & (1u << c)))
+            since[c] = query.value(1).toLongLong();
+    }
+
+    // 写入端开始汇总之前的小时没有汇总
+    *missing = 0;
+    *missingTo = from;
+    bool any = false;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!(derived & (1u << c)))
+            continue;
+        if (since[c] < 0 || since[c] >= to) {
+            *missing |= 1u << c;
+            *missingTo = to;
+            continue;
+        }
+        any = true;
+        if (since[c] > from) {
+            *missing |= 1u << c;
+            *missingTo = qMax(*missingTo, since[c]);
+        }
+    }
+    if (!any)
+        return true;
+
+    query.prepare("SELECT hour_ms, key, count, min, max, duration_ms, wsum, wsq, "
+                  "low, high, below_ms, above_ms "
+                  "FROM derived_rollups WHERE hour_ms >= ? AND hour_ms < ?");
+    query.bindValue(0, from);
+    query.bindValue(1, to);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        int c = channels->indexOf(query.value(1).toString());
+        if (c < 0 || since[c] < 0 || query.value(0).toLongLong() < since[c])
+            continue;
+        takeRollup(query, c, channels->at(c), hours, recheck);
+    }
+    return true;
+}
+
+// memo 中 derived 的各通道放入 hours 中同一小时的桶
+static void takeDerived(const SummaryBucket &memo, quint32 derived,
+                        QMap<qint64, SummaryBucket> *hours)
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        if (!(derived & (1u << c)) || !memo.channels[c].hasData())
+            continue;
+        SummaryBucket &bucket = (*hours)[memo.startMs];
+        bucket.startMs = memo.startMs;
+        bucket.channels[c] = memo.channels[c];
+    }
+}
+
+bool SensorStorage::summarizeDerived(qint64 from, qint64 to, quint32 derived,
+                                     QMap<qint64, SummaryBucket> *hours)
+{
+    if (!m_derivedAccount) {
+        m_derivedAccount = MemoryBudget::instance()->account(
+            "summary_memo", MemoryAccount::Cache, kDerivedHourMemo * int(sizeof(SummaryBucket)));
+        applyMemoryLimit();
+    }
+    // 备忘中的小时只有当时要求的通道
+    if (derived != m_derivedMemoMask) {
+        m_derivedHours.clear();
+        m_derivedMemoMask = derived;
+    }
+
+    // 先取备忘中有的小时；缺的小时连成段，成对记录 [起点, 终点)
+    QList<qint64> runs;
+    for (qint64 hour = from; hour < to; hour += kHourMs) {
+        const SummaryBucket *memo = m_derivedHours.object(hour);
+        if (memo)
+            takeDerived(*memo, derived, hours);
+        else if (!runs.isEmpty() && runs.last() == hour)
+            runs.last() = hour + kHourMs;
+        else
+            runs << hour << hour + kHourMs;
+    }
+
+    // 按段积分，一次最多一天，内存占用有上限；没有数据的小时也记下，不再重复读
+    for (int i = 0; i < runs.size(); i += 2) {
+        for (qint64 start = runs.at(i); start < runs.at(i + 1); start += 24 * kHourMs) {
+            qint64 end = qMin(runs.at(i + 1), start + 24 * kHourMs);
+            QMap<qint64, SummaryBucket> integrated;
+            if (!integrateRaw(start, end, &integrated, derived))
+                return false;
+            for (qint64 hour = start; hour < end; hour += kHourMs) {
+                SummaryBucket *memo = new SummaryBucket;
+                memo->startMs = hour;
+                QMap<qint64, SummaryBucket>::const_iterator it = integrated.constFind(hour);
+                for (int c = 0; it != integrated.constEnd() && c < SensorData::MAX_CHANNELS; ++c) {
+                    if (derived & (1u << c))
+                        memo->channels[c] = it.value().channels[c];
+                }
+                takeDerived(*memo, derived, hours);
+                m_derivedHours.insert(hour, memo);
+            }
+        }
+    }
+    m_derivedAccount->setUsage(m_derivedHours.count() * int(sizeof(SummaryBucket)));
+    return true;
+}
+
+quint32 SensorStorage::unsavedDerived() const
+{
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 derived = 0;
+    for (int c = 0; c < channels->count(); ++c) {
+        if (channels->at(c).isDerived() && m_dbChannel[c] < 0)
+            derived |= 1u << c;
+    }
+    return derived;
+}
+
+bool SensorStorage::summarize(const QDate &start, const QDate &end, bool daily,
+                              QList<SummaryBucket> *buckets, SummaryBucket *total)
+{
+    buckets->clear();
+    *total = SummaryBucket();
+    if (!m_channelsLoaded && !syncChannels(false))
+        return false;
+
+    qint64 from = dayStartMs(start);
+    qint64 to = qMin(dayStartMs(end.addDays(1)), QDateTime::currentMSecsSinceEpoch());
+    if (from >= to)
+        return true;
+
+    quint32 derived = unsavedDerived();
+
+    // 整小时且已经汇总的部分读 sample_rollups/derived_rollups，其余从原始记录积分
+    QMap<qint64, SummaryBucket> hours;
+    qint64 rolledFrom = hourCeil(from);
+    qint64 rolledTo = qMin(hourFloor(to), rollupWatermark());
+    if (rolledFrom < rolledTo) {
+        QList<qint64> recheck;
+        if (!readRollups(rolledFrom, rolledTo, &hours, &recheck))
+            return false;
+        // 派生通道启用之前写入端没有汇总它，这一段用备忘
+        quint32 missing = 0;
+        qint64 missingTo = rolledFrom;
+        if (derived && !readDerivedRollups(rolledFrom, rolledTo, derived, &hours, &recheck,
+                                           &missing, &missingTo))
+            return false;
+        if (missing && !summarizeDerived(rolledFrom, missingTo, missing, &hours))
+            return false;
+        for (int i = 0; i < recheck.size(); ++i) {
+            hours.remove(recheck.at(i));
+            if (!integrateRaw(recheck.at(i), recheck.at(i) + kHourMs, &hours, derived))
+                return false;
+        }
+        if ((from < rolledFrom && !integrateRaw(from, rolledFrom, &hours, derived))
+            || (rolledTo < to && !integrateRaw(rolledTo, to, &hours, derived)))
+            return false;
+    } else if (!integrateRaw(from, to, &hours, derived)) {
+        return false;
+    }
+
+    // 小时合并到输出的桶，新的在前
+    QMap<qint64, SummaryBucket> merged;
+    QDate lastDay;
+    qint64 lastDayStart = 0;
+    for (QMap<qint64, SummaryBucket>::const_iterator it = hours.constBegin();
+         it != hours.constEnd(); ++it) {
+        qint64 key = it.key();
+        if (daily) {
+            QDate day = QDateTime::fromMSecsSinceEpoch(key).date();
+            if (day != lastDay) {
+                lastDay = day;
+                lastDayStart = dayStartMs(day);
+            }
+            key = lastDayStart;
+        }
+        SummaryBucket &bucket = merged[key];
+        bucket.startMs = key;
+        bucket.merge(it.value());
+        total->merge(it.value());
+    }
+    total->startMs = from;
+
+    buckets->reserve(merged.size());
+    for (QMap<qint64, SummaryBucket>::const_iterator it = merged.constEnd();
+         it != merged.constBegin();) {
+        --it;
+        buckets->append(it.value());
+    }
+    return true;
+}
+
+int SensorStorage::intervalAt(const QDateTime &at)
+{
+    QSqlQuery query(m_db);
+    query.prepare("SELECT interval_ms FROM sample_intervals WHERE timestamp_ms <= :ts "
+                  "ORDER BY timestamp_ms DESC LIMIT 1");
+    query.bindValue(":ts", at.toMSecsSinceEpoch());
+    if (query.exec() && query.next())
+        return query.value(0).toInt();
+    return 0;
+}
+
+void SensorStorage::updateSizeGauge()
+{
+    Metrics::dbSizeBytes()->set(int(QFileInfo(m_db.databaseName()).size()));
+}
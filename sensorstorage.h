@@ -0,0 +1,306 @@
+#ifndef SENSORSTORAGE_H
+#define SENSORSTORAGE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QList>
+#include <QDate>
+#include <QCache>
+#include <QElapsedTimer>
+#include "sensordata.h"
+#include "chunkcodec.h"
+#include "persistencepolicy.h"
+#include "samplebus.h"
+#include "historycache.h"
+#include "historysummary.h"
+
+class HotTier;
+class MemoryAccount;
+class MetricCounter;
+class MetricGauge;
+
+class QSqlQuery;
+class QTimer;
+
+// 传感器数据的 SQLite 存储
+// 每个实例使用独立的连接名，采集进程写入，界面进程可以用另一个实例只读附加。
+// QSqlDatabase 只能在打开它的线程里使用：写入实例放在存储线程中，
+// 通过 open()/store() 槽以排队方式调用；查询实例留在界面线程。
+//
+// 通道：channels 表把通道 key 映射为数据库中的编号（0~15），温度、湿度固定为 0、1，
+// 新通道第一次写入时分配编号。SensorData 中的下标是 ChannelRegistry 的下标，
+// 两者在打开时对应起来；配置中已删除的通道的历史数据查询时跳过。
+//
+// 两种存储布局：
+//   RowLayout     每个通道的每个采样一行 samples（默认）。
+//                 主键 key = 时间戳毫秒 * 16 + 通道编号，按时间顺序聚簇，
+//                 范围查询直接走主键，不需要额外的索引；raw 与 value 相同时为 NULL。
+//                 旧版的宽表 sensor_data 在打开时复制到 samples，原表保留（见 migration_log）。
+//   ChunkedLayout 每个通道按时间分块压缩，存为 sample_chunks 中的 BLOB（见 chunkcodec.h）。
+//                 写入端在内存中追加当前块，每 flushEvery 个采样和换块、关闭时写回数据库；
+//                 读取端只能看到已写回的采样。查询只解码与时间范围重叠的块，
+//                 切换布局前写入的 samples 行仍然可以查到。
+//
+// 写入端的三种持久化级别（setDurability()），断电或进程被杀时最多丢失的数据：
+//   SyncEach      每批采样（总线上 storage 的 batchSize，默认 1 个）一个事务，
+//                 PRAGMA synchronous = FULL，提交返回时已经写盘。只丢还在总线队列里、
+//                 没有交给存储线程的采样，通常不到一个采样周期（默认）。
+//   GroupCommit   采样先留在内存，最早的一个等了 periodMs 后一起提交（FULL），
+//                 没有新采样时由计时器提交。最多丢 periodMs 加一个采样周期。
+//   Buffered      和 GroupCommit 的做法相同，只是周期按几十秒配置（storage/checkpointSec），
+//                 提交和写盘的次数最少，适合在意闪存寿命的设备；WAL 仍由 SQLite 按页数自动
+//                 检查点合并。最多丢 periodMs 加一个采样周期。
+// 提交以事务为单位，断电后数据库总是停在某次提交之后，不会出现只写了一半的采样。
+// 分块布局下当前块在 SyncEach 时仍按 flushEvery 写回（最多再丢 flushEvery 个写入的采样，
+// 换块时也写回），另外两种级别在每次提交时一并写回。死区筛掉的保持值不算丢失，阶梯序列照样可以还原。
+// 停止采集（flushPending()）和 close() 时内存中的采样全部提交。
+class SensorStorage : public QObject
+{
+    Q_OBJECT
+public:
+    enum Layout {
+        RowLayout = 0,
+        ChunkedLayout = 1
+    };
+
+    enum Durability {
+        SyncEach = 0,
+        GroupCommit = 1,
+        Buffered = 2
+    };
+
+    explicit SensorStorage(const QString &connectionName, QObject *parent = 0);
+    ~SensorStorage();
+
+    // open() 之前设置；写入端和读取端必须使用相同的布局
+    void setLayout(Layout layout, int chunkMinutes = 60, int flushEvery = 60);
+    Layout layout() const { return m_layout; }
+
+    bool isOpen() const;
+    QString lastError() const { return m_lastError; }
+
+    // 写入一条采样
+    bool save(const SensorData &data);
+    // 写入一批采样，行布局下在一个事务中完成
+    bool saveBatch(const QList<SensorData> &samples);
+
+    // 批量导入（见 csvimport.h）：按行布局写入 samples，与存储布局无关；
+    // 已有的记录保留，每 commitEvery 行或写锁持有超过 250 ms 时提交一次，
+    // 导入期间 synchronous 最多为 NORMAL，提交时不等待写盘。
+    // channel 为 ChannelRegistry 中的位置
+    bool beginImport(int commitEvery);
+    bool importValue(qint64 timestampMs, int channel, double value);
+    bool endImport();
+    // 本次导入中因为已有记录而跳过的值
+    qint64 importDuplicates() const { return m_importDuplicates; }
+
+    // 写入端的持久化级别，open() 之前设置；periodMs 为 GroupCommit/Buffered 的提交周期
+    void setDurability(Durability durability, int periodMs);
+    Durability durability() const { return m_durability; }
+    // 采样周期，open() 之前设置，只用于估计 lossWindowMs()；周期会变时给最长的
+    void setSampleInterval(int ms) { m_sampleIntervalMs = qMax(1, ms); }
+    // 按级别和布局最多丢失的时间（毫秒，不含一个采样周期和总线队列）：行布局的 SyncEach 为 0，
+    // 分块布局的 SyncEach 为还没写回的 flushEvery 个采样（死区开启时按心跳间隔算），最长一块
+    int lossWindowMs() const;
+
+    // 写入端的死区/心跳策略，open() 之前设置；之后只在存储线程中使用
+    void setPersistencePolicy(const PersistencePolicy &policy) { m_persist = policy; }
+    const PersistencePolicy &persistencePolicy() const { return m_persist; }
+
+    // 按日期范围查询（含首尾），按时间倒序
+    // derived 为需要算出的派生通道（见 derivedchannels.h），算过的值随缓存的日块和热层保存；
+    // 死区筛掉的采样按阶梯补出（expandSteps()），和实时看到的一致。
+    // maxRows > 0 时取到这么多条最新的采样（包括补出的）就停止，lastQueryTruncated() 返回 true
+    bool queryRange(const QDate &start, const QDate &end, QList<SensorData> *out,
+                    quint32 derived = 0, int maxRows = 0);
+    bool lastQueryTruncated() const { return m_truncated; }
+
+    // 按时间倒序的记录中，相邻两条之间按当时的采样周期补出保持前一个值的采样
+    // （PersistencePolicy::fillSteps()）。间隔超过 setSummaryGap() 的是中断，不补，
+    // 和 summarize() 积分时的阶梯语义相同
+    bool expandSteps(QList<SensorData> *rows);
+
+    // 日期范围内各通道的汇总（下标为 ChannelRegistry 中的位置）
+    bool aggregateRange(const QDate &start, const QDate &end, QVector<ChannelAggregate> *out,
+                        quint32 derived = 0);
+
+    // 读取端的查询结果缓存（按天分块，见 historycache.h），0 表示不缓存
+    void setCacheBudget(int bytes);
+    HistoryCache *cache() const { return m_cache; }
+    // 其他途径改写了已经结束的日子（例如导入）之后调用
+    void invalidateCache();
+    // 内存压力变化时按各内存账户的上限淘汰缓存（见 memorybudget.h）
+    void applyMemoryLimit();
+
+    // 读取端的内存热层：它覆盖的时间段直接从热层取，更早的部分查数据库。
+    // 热层由调用者拥有，必须和本实例在同一线程
+    void setHotTier(HotTier *hot) { m_hot = hot; }
+
+    // 历史统计（见 historysummary.h）
+    // 写入端在每小时结束后把这一小时各通道的统计写入 sample_rollups，没有写入数据库的派生通道
+    // 写入 derived_rollups，统计时整小时直接读汇总；范围边缘、还没有汇总的最近时段、
+    // 以及阈值改过后跨过新阈值的小时从原始记录积分。派生通道启用之前的整小时没有汇总，
+    // 从原始记录积分后留在内存中备用。
+    // buckets 按时间倒序，按天时以本地日期分桶
+    bool summarize(const QDate &start, const QDate &end, bool daily,
+                   QList<SummaryBucket> *buckets, SummaryBucket *total);
+    // 阶梯序列中一个值最长的保持时间，读写两端必须一致
+    void setSummaryGap(qint64 ms) { m_summaryGapMs = qMax(qint64(1000), ms); }
+    // 写入端：补生成已经结束、采样都已写入数据库（persistedUntil() 已越过）的小时的汇总，
+    // 最多 maxHours 小时；caughtUp 返回是否已经补到最新
+    bool updateRollups(int maxHours, bool *caughtUp);
+    // 重新生成 [from, to) 内已经汇总过的小时（导入旧数据之后）
+    bool rebuildRollups(qint64 from, qint64 to);
+
+    // 读取 id 大于 afterId 的新记录，按时间升序；lastId 返回最后一条的 id
+    // id 只作为游标使用：行布局下是 samples 的 key，分块布局下是采样时间戳（毫秒）
+    bool fetchSince(qint64 afterId, QList<SensorData> *out, qint64 *lastId);
+
+    // 顺序游标：按时间升序读 [from, to) 的记录，只向前，内存中只保留一批。
+    // 行布局下是一个未读完的 SELECT，分块布局下一次解码一个块长度的时间段。
+    // readCursor() 追加约 maxSamples 个采样，out 没有增加表示已经读完
+    bool openCursor(qint64 from, qint64 to);
+    bool readCursor(QList<SensorData> *out, int maxSamples);
+    void closeCursor();
+
+    // 当前最大 id，空表返回 0
+    qint64 maxId();
+
+    // at 时刻生效的采样周期（毫秒），没有记录时返回 0
+    int intervalAt(const QDateTime &at);
+
+public slots:
+    // 打开数据库并建表；attachOnly 时不建表，只用于读取其他进程维护的数据库
+    bool open(const QString &path, bool attachOnly = false);
+    void close();
+
+    // 写入一条采样，失败时发出 writeFailed()
+    void store(const SensorData &data);
+
+    // 采样总线的订阅槽：按持久化策略筛选后批量写入
+    void storeBatch(const SensorDataList &samples);
+    // 补写策略中最后一个未写入的采样（停止采集、退出时）
+    void flushPending();
+
+    // 记录采样周期变化，按时间加权的统计需要知道每段时间的采样周期
+    void storeIntervalChange(const QDateTime &at, int intervalMs);
+
+signals:
+    void opened(bool ok);
+    void writeFailed(const QString &error);
+
+private slots:
+    void onCommitTimer();
+
+private:
+    enum { MAX_DB_CHANNELS = 16 };
+
+    // 写入端为注册表中的通道分配编号，读取端只加载已有的映射
+    bool syncChannels(bool assign);
+    bool migrateSensorData();
+    void updateSizeGauge();
+
+    // queryRange()/aggregateRange() 的共同实现：按时间倒序追加到 out、汇总合并到 aggregates
+    bool collectRange(const QDate &start, const QDate &end, QList<SensorData> *out,
+                      QVector<ChannelAggregate> *aggregates, quint32 derived, int maxRows);
+    // 查询 [from, to) 毫秒范围，按时间倒序追加到 out
+    bool queryUncached(qint64 from, qint64 to, QList<SensorData> *out);
+    bool queryRows(qint64 from, qint64 to, QList<SensorData> *out);
+    // 通过缓存取一天的结果，按时间倒序追加到 out、汇总合并到 aggregates（都可以为 0）；
+    // persisted 为查询之前的 persistedUntil()，越过当天结束的日子内容不再变化
+    bool loadDay(const QDate &day, QList<SensorData> *out, QVector<ChannelAggregate> *aggregates,
+                 quint32 derived, qint64 persisted);
+    // 已经写入数据库的最新采样时间戳，在它之前的采样都已写入（分块布局写回时所有通道一起写）；
+    // 没有记录时返回 -1
+    qint64 persistedUntil();
+    // 按 key 顺序读出的行组合成采样，同一时间戳的行相邻
+    void readSampleRows(QSqlQuery &query, QList<SensorData> *out, qint64 *lastKey);
+
+    bool insertRow(QSqlQuery &query, const SensorData &data);
+    // GroupCommit/Buffered：提交内存中的采样，失败时发出 writeFailed()
+    bool commitUnsaved();
+
+    // 汇总
+    qint64 rollupWatermark();   // 此前的整小时都已汇总，没有时返回 0
+    qint64 firstSampleMs();     // 没有记录时返回 -1
+    // 生成 [from, to) 内各小时的汇总；watermark >= 0 时在同一事务中更新水位
+    bool buildRollups(qint64 from, qint64 to, qint64 watermark);
+    // 从原始记录积分 [from, to)，按小时累加到 hours；derived 为需要算出的派生通道
+    bool integrateRaw(qint64 from, qint64 to, QMap<qint64, SummaryBucket> *hours,
+                      quint32 derived = 0);
+    // 启用了但没有写入数据库的派生通道
+    quint32 unsavedDerived() const;
+    // 没有汇总的派生通道：整小时的统计取自内存中的备忘，缺的小时从原始记录积分
+    bool summarizeDerived(qint64 from, qint64 to, quint32 derived,
+                          QMap<qint64, SummaryBucket> *hours);
+    // 读汇总；阈值与汇总时不同、且这一小时跨过新阈值的，小时起点放入 recheck
+    bool readRollups(qint64 from, qint64 to, QMap<qint64, SummaryBucket> *hours,
+                     QList<qint64> *recheck);
+    // 读 derived 的汇总；写入端还没有开始汇总的小时不读，这些通道放入 missing，
+    // [from, missingTo) 需要另外积分
+    bool readDerivedRollups(qint64 from, qint64 to, quint32 derived,
+                            QMap<qint64, SummaryBucket> *hours, QList<qint64> *recheck,
+                            quint32 *missing, qint64 *missingTo);
+
+    // 分块布局
+    bool saveChunked(const SensorData &data);
+    bool switchChunk(qint64 chunkStart);
+    bool flushChunks();
+    // 解码与 [from, to) 重叠的块，按时间升序追加 from <= 时间戳 < to 的采样
+    bool readChunks(qint64 from, qint64 to, QList<SensorData> *out);
+
+    QString m_connectionName;
+    QSqlDatabase m_db;
+    QString m_lastError;
+
+    PersistencePolicy m_persist;
+
+    Durability m_durability;
+    int m_commitPeriodMs;
+    int m_sampleIntervalMs;
+    QList<SensorData> m_unsaved;    // 写入端内存中还没有提交的采样
+    QElapsedTimer m_unsavedAge;     // 从 m_unsaved 中最早的采样算起
+    QTimer *m_commitTimer;          // 在 open() 中创建，和本实例在同一线程
+    MetricGauge *m_unsavedGauge;
+    MetricCounter *m_dbErrorDrops;
+    MetricCounter *m_dbClosedDrops;
+
+    QSqlQuery *m_importQuery;   // 非 0 表示正在导入，事务未提交
+    int m_importEvery;
+    int m_importPending;
+    qint64 m_importDuplicates;
+    int m_importSync;           // 导入前的 PRAGMA synchronous，结束时恢复
+    QElapsedTimer m_importHeld; // 当前导入事务开始后的时间
+    HistoryCache *m_cache;
+    HotTier *m_hot;
+
+    Layout m_layout;
+    qint64 m_chunkMs;
+    int m_flushEvery;
+    int m_dbChannel[SensorData::MAX_CHANNELS];  // 注册表下标 -> 数据库编号，-1 表示未分配
+    int m_channelIndex[MAX_DB_CHANNELS];        // 数据库编号 -> 注册表下标，-1 表示已不在配置中
+    bool m_channelsLoaded;
+    quint32 m_persistDerived;   // 写入端写库前算出的派生通道（persist=true 且已分配编号）
+
+    // 读取端：没有汇总的派生通道（启用之前的小时）已经积分过的整小时，键为小时起点
+    QCache<qint64, SummaryBucket> m_derivedHours;
+    MemoryAccount *m_derivedAccount;    // 第一次用到时登记
+    quint32 m_derivedMemoMask;          // 备忘中保存的通道
+    bool m_truncated;
+
+    qint64 m_summaryGapMs;
+    qint64 m_rollupDue;         // 写入端下一次检查汇总的时间
+
+    ChunkEncoder m_chunks[SensorData::MAX_CHANNELS];   // 写入端当前块
+    qint64 m_chunkStart;                    // 当前块起始时间，-1 表示还没有
+    int m_unflushed;
+
+    // 顺序游标
+    QSqlQuery *m_cursorQuery;   // 行布局，0 表示没有打开或已经读完
+    qint64 m_cursorFrom;        // 分块布局下尚未读的起点
+    qint64 m_cursorTo;
+    qint64 m_cursorTs;          // m_cursorSample 的时间戳
+    SensorData m_cursorSample;  // 正在组合、还没有交出的采样
+};
+
+#endif // SENSORSTORAGE_H
@@ -1,9 +1,15 @@
 #include "sensorthread.h"
+#include "metrics.h"
+#include "samplering.h"
+#include "samplebus.h"
+#include "sht11conversion.h"
+#include <QElapsedTimer>
 #include <QDebug>
 #ifdef __linux__
     #include <sys/ioctl.h>
     #include <fcntl.h>
     #include <unistd.h>
+    #include <poll.h>
     #include <errno.h>
     #include <string.h>
 #endif
@@ -11,12 +17,27 @@
 #define TEMP 0
 #define HUMI 1
 
+// 驱动未实现 poll 时 poll() 总是立即返回可读，read() 仍会 EAGAIN，按此间隔重试
+static const int kRetryDelayMs = 5;
+
 SensorThread::SensorThread(QObject *parent)
     : QThread(parent),
       m_collecting(false),
       m_running(true),
-      m_sht11_fd(-1)
+      m_sht11_fd(-1),
+      m_ring(0),
+      m_bus(0),
+      m_intervalMs(1000),
+      m_conversionTimeoutMs(500),
+      m_profile(sht11Profile("legacy", 0)),
+      m_compensateHumidity(false)
 {
+    m_tempReadFailures = Metrics::readFailures("temperature");
+    m_humReadFailures = Metrics::readFailures("humidity");
+    m_readDrops = Metrics::samplesDropped("sensor_read");
+    m_readRetries = MetricsRegistry::instance()->counter(
+        "smarthome_sensor_read_retries_total", "Reads retried because the conversion was not ready.");
+    Metrics::sampleIntervalMs()->set(m_intervalMs);
 }
 
 SensorThread::~SensorThread()
@@ -51,6 +72,48 @@ void SensorThread::requestStop()  // 实现请求停止方法
     wait();  // 等待线程结束
 }
 
+void SensorThread::setSampleInterval(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_intervalMs = qMax(10, ms);
+    Metrics::sampleIntervalMs()->set(m_intervalMs);
+}
+
+int SensorThread::sampleInterval() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_intervalMs;
+}
+
+void SensorThread::setConversionTimeout(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_conversionTimeoutMs = qMax(10, ms);
+}
+
+void SensorThread::setConversionProfile(const Sht11Profile *profile, bool compensate)
+{
+    m_profile = profile;
+    m_compensateHumidity = compensate;
+}
+
+void SensorThread::setFilterConfig(int channel, const ChannelFilterConfig &config)
+{
+    if (channel >= 0 && channel < SensorData::MAX_CHANNELS)
+        m_filters[channel].configure(config);
+}
+
+void SensorThread::setAdaptiveRate(const AdaptiveRateConfig &config)
+{
+    m_adaptive.configure(config);
+}
+
+void SensorThread::setRealtime(const RealtimeConfig &config)
+{
+    m_realtime = config;
+    m_jitter.configure(config.jitterLimitUs, config.jitterReportSec);
+}
+
 void SensorThread::run()
 {
 #ifdef __linux__
@@ -61,7 +124,15 @@ void SensorThread::run()
     }
 #endif
 
-    qDebug() << "SensorThread started";
+    // 在第一次采样之前生成换算表；锁定内存时换算表也在其中
+    m_profile->temperature(0);
+    Realtime::apply(m_realtime);
+    qDebug() << "SensorThread started, conversion profile" << m_profile->name;
+
+    // 按固定节拍采样：下一次采样时间 = 上一次计划时间 + 周期，
+    // 睡到绝对时刻，醒来的误差不累积到后面的节拍
+    qint64 nextTick = Realtime::monotonicNs();
+    emit sampleIntervalChanged(QDateTime::currentDateTime(), sampleInterval());
 
     while (true) {
         // 检查是否应该退出
@@ -74,12 +145,55 @@ void SensorThread::run()
         bool collecting = isCollecting();
 
         if (collecting) {
-            float temp = readTemperature();
-            float hum = readHumidity();
-            emit dataReceived(temp, hum);
+            // 实际开始读取的时刻与计划时刻之差
+            m_jitter.record(Realtime::monotonicNs() - nextTick);
+
+            SensorData data;
+            if (acquire(&data)) {
+                Metrics::samplesTotal()->inc();
+
+                for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+                    if (data.has(c))
+                        data.values[c] = m_filters[c].process(float(data.rawValues[c]));
+                }
+                data.intervalMs = sampleInterval();
+
+                // 共享内存的布局固定为温湿度两个通道
+                if (m_ring) {
+                    quint32 flags = 0;
+                    if (data.has(CHANNEL_TEMPERATURE))
+                        flags |= SAMPLERING_FLAG_TEMPERATURE_VALID;
+                    if (data.has(CHANNEL_HUMIDITY))
+                        flags |= SAMPLERING_FLAG_HUMIDITY_VALID;
+                    m_ring->publish(data.timestamp.toMSecsSinceEpoch(),
+                                    float(data.value(CHANNEL_TEMPERATURE)),
+                                    float(data.value(CHANNEL_HUMIDITY)), flags);
+                }
+                // 滤波后的值和原始读数都在 data 中
+                if (m_bus)
+                    m_bus->publish(data);
+
+                if (m_adaptive.isEnabled()) {
+                    int next = m_adaptive.update(data, data.intervalMs);
+                    if (next != data.intervalMs) {
+                        setSampleInterval(next);
+                        emit sampleIntervalChanged(data.timestamp, next);
+                    }
+                }
+            } else {
+                m_readDrops->inc();
+            }
         }
 
-        msleep(1000);
+        nextTick += qint64(sampleInterval()) * 1000000;
+        qint64 now = Realtime::monotonicNs();
+        if (nextTick < now) {
+            // 读取耗时超过一个周期：从当前时刻重新对齐，不补采
+            if (collecting)
+                m_jitter.recordOverrun();
+            nextTick = now;
+        }
+        Realtime::sleepUntilNs(nextTick);
     }
 
 #ifdef __linux__
@@ -91,39 +205,106 @@ void SensorThread::run()
     qDebug() << "SensorThread finished";
 }
 
-// 保持 readTemperature() 和 readHumidity() 不变
-float SensorThread::readTemperature()
+bool SensorThread::acquire(SensorData *data)
 {
-    unsigned int value_t = 0;
 #ifdef __linux__
-    ioctl(m_sht11_fd, TEMP);
-    if (read(m_sht11_fd, &value_t, sizeof(value_t)) < 0) {
+    // SHT11 同一时间只能做一次转换：温度读出后立即启动湿度转换，
+    // 在湿度转换期间完成温度的数值换算
+    unsigned int rawT = 0, rawH = 0;
+    QElapsedTimer clock;
+
+    clock.start();
+    if (!startConversion(TEMP) || !finishConversion(&rawT, clock)) {
         qWarning() << "读取温度失败";
-        return 0.0f;
+        m_tempReadFailures->inc();
+        return false;
+    }
+
+    clock.start();
+    if (!startConversion(HUMI)) {
+        qWarning() << "读取湿度失败";
+        m_humReadFailures->inc();
+        return false;
     }
+    float temperature = m_profile->temperature(rawT);
 
-    value_t &= 0x3fff; // 14位数据
-    float temp = value_t * 0.01f - 40.0f; // 转换为实际温度
-    return temp;
+    if (!finishConversion(&rawH, clock)) {
+        qWarning() << "读取湿度失败";
+        m_humReadFailures->inc();
+        return false;
+    }
+    float humidity = m_compensateHumidity ? m_profile->compensatedHumidity(rawH, temperature)
+                                          : m_profile->humidity(rawH);
+    data->setValue(CHANNEL_TEMPERATURE, temperature);
+    data->setValue(CHANNEL_HUMIDITY, humidity);
+    return true;
 #else
-    return 20.0f + (qrand() % 100) / 10.0f;
+    data->setValue(CHANNEL_TEMPERATURE, 20.0f + (qrand() % 100) / 10.0f);
+    data->setValue(CHANNEL_HUMIDITY, 40.0f + (qrand() % 400) / 10.0f);
+    return true;
 #endif
 }
 
-float SensorThread::readHumidity()
+bool SensorThread::startConversion(int channel)
 {
 #ifdef __linux__
-    unsigned int value_h = 0;
-    ioctl(m_sht11_fd, HUMI);
-    if (read(m_sht11_fd, &value_h, sizeof(value_h)) < 0) {
-        qWarning() << "读取湿度失败";
-        return 0.0f;
+    if (ioctl(m_sht11_fd, channel) < 0) {
+        qWarning() << "启动转换失败:" << strerror(errno);
+        return false;
     }
+#else
+    Q_UNUSED(channel);
+#endif
+    return true;
+}
 
-    value_h &= 0xfff; // 12位数据
-    float hum = -0.40f + 0.0405f * value_h - 0.0000028f * value_h * value_h; // 简化计算公式
-    return qBound(0.1f, hum, 100.0f); // 限制在0.1-100%范围内
+// 等待转换就绪并读出原始值；未就绪时在截止时间内重试
+bool SensorThread::finishConversion(unsigned int *raw, const QElapsedTimer &clock)
+{
+#ifdef __linux__
+    int timeoutMs;
+    {
+        QMutexLocker locker(&m_mutex);
+        timeoutMs = m_conversionTimeoutMs;
+    }
+
+    while (true) {
+        int remaining = timeoutMs - int(clock.elapsed());
+        if (remaining <= 0) {
+            qWarning() << "转换超时";
+            return false;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = m_sht11_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int rc = poll(&pfd, 1, remaining);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            qWarning() << "poll 失败:" << strerror(errno);
+            return false;
+        }
+        if (rc == 0) {
+            qWarning() << "转换超时";
+            return false;
+        }
+
+        ssize_t n = read(m_sht11_fd, raw, sizeof(*raw));
+        if (n == ssize_t(sizeof(*raw)))
+            return true;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            m_readRetries->inc();
+            msleep(qMin(kRetryDelayMs, remaining));
+            continue;
+        }
+        if (n < 0)
+            qWarning() << "读取失败:" << strerror(errno);
+        return false;
+    }
 #else
-    return 40.0f + (qrand() % 400) / 10.0f;
+    Q_UNUSED(raw);
+    Q_UNUSED(clock);
+    return true;
 #endif
 }
@@ -3,6 +3,16 @@
 
 #include <QThread>
 #include <QMutex>
+#include "sensordata.h"
+#include "samplefilter.h"
+#include "adaptiverate.h"
+#include "realtime.h"
+
+class QElapsedTimer;
+class MetricCounter;
+class SampleRing;
+class SampleBus;
+struct Sht11Profile;
 
 class SensorThread : public QThread
 {
@@ -15,8 +25,34 @@ public:
     void stopCollection();
     bool isCollecting() const;  // 保持 const 修饰
     void requestStop();
+
+    // 采集到的数据同时发布到共享内存，start() 之前设置
+    void setSampleRing(SampleRing *ring) { m_ring = ring; }
+
+    // 采集到的数据在本线程中直接发布到总线，start() 之前设置
+    void setSampleBus(SampleBus *bus) { m_bus = bus; }
+
+    // 采样周期（毫秒），按固定节拍调度，不受读取耗时影响
+    void setSampleInterval(int ms);
+    int sampleInterval() const;
+
+    // 单次转换等待就绪的最长时间（毫秒），超时的采样丢弃而不是记为 0
+    void setConversionTimeout(int ms);
+
+    // 原始读数换算配置（型号/供电电压），compensate 为湿度温度补偿，start() 之前设置
+    void setConversionProfile(const Sht11Profile *profile, bool compensate);
+
+    // 通道滤波配置（通道下标见 ChannelRegistry），start() 之前设置
+    void setFilterConfig(int channel, const ChannelFilterConfig &config);
+
+    // 自适应采样周期，start() 之前设置；启用时 setSampleInterval() 只是初始周期
+    void setAdaptiveRate(const AdaptiveRateConfig &config);
+
+    // 实时调度、CPU 绑定、内存锁定和抖动报告（见 realtime.h），start() 之前设置
+    void setRealtime(const RealtimeConfig &config);
 signals:
-    void dataReceived(float temperature, float humidity);
+    // 采样周期变化（包括启动时的初始周期），at 之后的采样使用新周期
+    void sampleIntervalChanged(const QDateTime &at, int intervalMs);
 
 protected:
     void run();
@@ -26,9 +62,28 @@ private:
     volatile bool m_collecting;  // 添加 volatile
     volatile bool m_running;     // 添加 volatile
     int m_sht11_fd;
+    SampleRing *m_ring;
+    SampleBus *m_bus;
+    int m_intervalMs;
+    int m_conversionTimeoutMs;
+    const Sht11Profile *m_profile;
+    bool m_compensateHumidity;
+    ChannelFilter m_filters[SensorData::MAX_CHANNELS];
+    AdaptiveRate m_adaptive;
+    RealtimeConfig m_realtime;
+    JitterMonitor m_jitter;
+
+    // 运行指标
+    MetricCounter *m_tempReadFailures;
+    MetricCounter *m_humReadFailures;
+    MetricCounter *m_readRetries;
+    MetricCounter *m_readDrops;
+
+    // 采集一组读数（原始值）写入 data，任一通道失败返回 false
+    bool acquire(SensorData *data);
 
-    float readTemperature();
-    float readHumidity();
+    bool startConversion(int channel);
+    bool finishConversion(unsigned int *raw, const QElapsedTimer &clock);
 };
 
 #endif // SENSORTHREAD_H
@@ -0,0 +1,41 @@
+#include "sht11conversion.h"
+#include <QtGlobal>
+
+template <class Model, class Supply>
+static const Sht11Profile *makeProfile(const char *name)
+{
+    typedef Sht11Converter<Model, Supply> C;
+    static const Sht11Profile profile = {
+        name,
+        &C::temperature,
+        &C::humidity,
+        &C::compensatedHumidity,
+        &C::convertBatch
+    };
+    return &profile;
+}
+
+template <class Model>
+static const Sht11Profile *profileForSupply(double vdd, const char *const names[5])
+{
+    // 数据手册只给出离散电压点，取最接近的一档
+    if (vdd <= 0.0)  return makeProfile<Model, Sht11LegacySupply>(names[0]);
+    if (vdd >= 4.5)  return makeProfile<Model, Sht11Supply5V>(names[1]);
+    if (vdd >= 3.75) return makeProfile<Model, Sht11Supply4V>(names[2]);
+    if (vdd >= 3.25) return makeProfile<Model, Sht11Supply3V5>(names[3]);
+    return makeProfile<Model, Sht11Supply3V>(names[4]);
+}
+
+const Sht11Profile *sht11Profile(const QString &model, double vdd)
+{
+    if (model == "v3") {
+        static const char *const names[5] = { "v3", "v3@5V", "v3@4V", "v3@3.5V", "v3@3V" };
+        return profileForSupply<Sht1xV3Model>(vdd, names);
+    }
+    if (model == "v4") {
+        static const char *const names[5] = { "v4", "v4@5V", "v4@4V", "v4@3.5V", "v4@3V" };
+        return profileForSupply<Sht1xV4Model>(vdd, names);
+    }
+    static const char *const names[5] = { "legacy", "legacy@5V", "legacy@4V", "legacy@3.5V", "legacy@3V" };
+    return profileForSupply<Sht11LegacyModel>(vdd, names);
+}
@@ -0,0 +1,186 @@
+#ifndef SHT11CONVERSION_H
+#define SHT11CONVERSION_H
+
+#include <QtGlobal>
+#include <QString>
+
+// SHT1x 原始读数到物理量的换算
+//
+// 型号（湿度系数）和标定（供电电压对应的温度偏置）作为模板参数组合，
+// 每个组合有自己的查找表：14 位温度 16384 项，12 位湿度线性项和温度补偿斜率各 4096 项。
+// 查找表在第一次使用时由直接计算函数逐项生成（工具链不支持 constexpr），
+// 因此查表结果与直接计算逐位相同（不要用 -ffast-math 编译，它允许两条路径重排运算）。
+//
+// 湿度温度补偿（数据手册）：RH = (T - 25) * (t1 + t2 * SO) + RH_linear
+
+// ============== 型号：湿度系数 ==============
+
+// 与旧版 readHumidity() 输出一致（c1 为 -0.40），无温度补偿
+struct Sht11LegacyModel {
+    static float c1() { return -0.40f; }
+    static float c2() { return 0.0405f; }
+    static float c3() { return -0.0000028f; }
+    static float t1() { return 0.0f; }
+    static float t2() { return 0.0f; }
+};
+
+// SHT1x 数据手册 V3，12 位湿度
+struct Sht1xV3Model {
+    static float c1() { return -4.0f; }
+    static float c2() { return 0.0405f; }
+    static float c3() { return -2.8e-6f; }
+    static float t1() { return 0.01f; }
+    static float t2() { return 0.00008f; }
+};
+
+// SHT1x 数据手册 V4 及以后，12 位湿度
+struct Sht1xV4Model {
+    static float c1() { return -2.0468f; }
+    static float c2() { return 0.0367f; }
+    static float c3() { return -1.5955e-6f; }
+    static float t1() { return 0.01f; }
+    static float t2() { return 0.00008f; }
+};
+
+// ============== 标定：温度偏置 d1（随供电电压），14 位 d2 = 0.01 ==============
+
+struct Sht11LegacySupply { static float d1() { return -40.0f; } };
+struct Sht11Supply5V     { static float d1() { return -40.1f; } };
+struct Sht11Supply4V     { static float d1() { return -39.8f; } };
+struct Sht11Supply3V5    { static float d1() { return -39.7f; } };
+struct Sht11Supply3V     { static float d1() { return -39.6f; } };
+
+template <class Model, class Supply>
+class Sht11Converter
+{
+public:
+    enum { TEMPERATURE_CODES = 1 << 14, HUMIDITY_CODES = 1 << 12 };
+
+    // ---- 直接计算 ----
+    static float temperatureDirect(unsigned int raw)
+    {
+        return (raw & 0x3fff) * 0.01f + Supply::d1();
+    }
+
+    static float humidityLinearDirect(unsigned int raw)
+    {
+        float so = float(raw & 0xfff);
+        return Model::c1() + Model::c2() * so + Model::c3() * so * so;
+    }
+
+    static float humiditySlopeDirect(unsigned int raw)
+    {
+        return Model::t1() + Model::t2() * float(raw & 0xfff);
+    }
+
+    static float humidityDirect(unsigned int raw)
+    {
+        return clampHumidity(humidityLinearDirect(raw));
+    }
+
+    static float compensatedHumidityDirect(unsigned int raw, float temperature)
+    {
+        return combine(humidityLinearDirect(raw), humiditySlopeDirect(raw), temperature);
+    }
+
+    // ---- 查表 ----
+    static float temperature(unsigned int raw)
+    {
+        return tables().temperature[raw & 0x3fff];
+    }
+
+    static float humidity(unsigned int raw)
+    {
+        return clampHumidity(tables().humidityLinear[raw & 0xfff]);
+    }
+
+    static float compensatedHumidity(unsigned int raw, float temperature)
+    {
+        const Tables &t = tables();
+        return combine(t.humidityLinear[raw & 0xfff], t.humiditySlope[raw & 0xfff], temperature);
+    }
+
+    // ---- 批量换算（高速采集、回放）----
+    // 四路展开，查表之后的补偿运算在支持 SIMD 的目标上可被编译器向量化
+    static void convertBatch(const quint16 *rawT, const quint16 *rawRh,
+                             float *outT, float *outRh, int n, bool compensate)
+    {
+        const Tables &t = tables();
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            float t0 = t.temperature[rawT[i] & 0x3fff];
+            float t1 = t.temperature[rawT[i + 1] & 0x3fff];
+            float t2 = t.temperature[rawT[i + 2] & 0x3fff];
+            float t3 = t.temperature[rawT[i + 3] & 0x3fff];
+            outT[i] = t0;
+            outT[i + 1] = t1;
+            outT[i + 2] = t2;
+            outT[i + 3] = t3;
+            if (compensate) {
+                outRh[i] = combine(t.humidityLinear[rawRh[i] & 0xfff], t.humiditySlope[rawRh[i] & 0xfff], t0);
+                outRh[i + 1] = combine(t.humidityLinear[rawRh[i + 1] & 0xfff], t.humiditySlope[rawRh[i + 1] & 0xfff], t1);
+                outRh[i + 2] = combine(t.humidityLinear[rawRh[i + 2] & 0xfff], t.humiditySlope[rawRh[i + 2] & 0xfff], t2);
+                outRh[i + 3] = combine(t.humidityLinear[rawRh[i + 3] & 0xfff], t.humiditySlope[rawRh[i + 3] & 0xfff], t3);
+            } else {
+                outRh[i] = clampHumidity(t.humidityLinear[rawRh[i] & 0xfff]);
+                outRh[i + 1] = clampHumidity(t.humidityLinear[rawRh[i + 1] & 0xfff]);
+                outRh[i + 2] = clampHumidity(t.humidityLinear[rawRh[i + 2] & 0xfff]);
+                outRh[i + 3] = clampHumidity(t.humidityLinear[rawRh[i + 3] & 0xfff]);
+            }
+        }
+        for (; i < n; ++i) {
+            outT[i] = t.temperature[rawT[i] & 0x3fff];
+            outRh[i] = compensate ? compensatedHumidity(rawRh[i], outT[i]) : humidity(rawRh[i]);
+        }
+    }
+
+private:
+    struct Tables {
+        float temperature[TEMPERATURE_CODES];
+        float humidityLinear[HUMIDITY_CODES];
+        float humiditySlope[HUMIDITY_CODES];
+
+        Tables()
+        {
+            for (unsigned int i = 0; i < TEMPERATURE_CODES; ++i)
+                temperature[i] = temperatureDirect(i);
+            for (unsigned int i = 0; i < HUMIDITY_CODES; ++i) {
+                humidityLinear[i] = humidityLinearDirect(i);
+                humiditySlope[i] = humiditySlopeDirect(i);
+            }
+        }
+    };
+
+    static const Tables &tables()
+    {
+        static Tables t;
+        return t;
+    }
+
+    static float clampHumidity(float rh)
+    {
+        return qBound(0.1f, rh, 100.0f); // 限制在0.1-100%范围内
+    }
+
+    // 查表路径和直接计算路径共用，保证结果逐位相同
+    static float combine(float linear, float slope, float temperature)
+    {
+        return clampHumidity((temperature - 25.0f) * slope + linear);
+    }
+};
+
+// 运行时按配置选择的换算函数
+struct Sht11Profile {
+    const char *name;
+    float (*temperature)(unsigned int raw);
+    float (*humidity)(unsigned int raw);
+    float (*compensatedHumidity)(unsigned int raw, float temperature);
+    void (*convertBatch)(const quint16 *rawT, const quint16 *rawRh,
+                         float *outT, float *outRh, int n, bool compensate);
+};
+
+// model: legacy | v3 | v4；vdd: 供电电压（伏），0 表示旧版偏置 -40.0
+// 未知组合返回 legacy 配置
+const Sht11Profile *sht11Profile(const QString &model, double vdd);
+
+#endif // SHT11CONVERSION_H
@@ -0,0 +1,72 @@
+#include "signalwatcher.h"
+#include <QSocketNotifier>
+#include <QDebug>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+int SignalWatcher::s_fds[2] = { -1, -1 };
+
+SignalWatcher::SignalWatcher(QObject *parent)
+    : QObject(parent)
+    , m_notifier(0)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, s_fds) != 0) {
+        qWarning() << "SignalWatcher: socketpair 失败:" << strerror(errno);
+        s_fds[0] = s_fds[1] = -1;
+        return;
+    }
+    // 写端非阻塞：处理函数不能卡住
+    ::fcntl(s_fds[0], F_SETFL, ::fcntl(s_fds[0], F_GETFL) | O_NONBLOCK);
+    m_notifier = new QSocketNotifier(s_fds[1], QSocketNotifier::Read, this);
+    connect(m_notifier, SIGNAL(activated(int)), this, SLOT(onReadable()));
+}
+
+SignalWatcher::~SignalWatcher()
+{
+    delete m_notifier;
+    if (s_fds[0] >= 0) {
+        ::close(s_fds[0]);
+        ::close(s_fds[1]);
+        s_fds[0] = s_fds[1] = -1;
+    }
+}
+
+bool SignalWatcher::watch(int signum)
+{
+    if (!m_notifier)
+        return false;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_RESETHAND;
+    if (::sigaction(signum, &action, 0) != 0) {
+        qWarning() << "SignalWatcher: 无法安装信号" << signum << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// 只能调用异步信号安全的函数
+void SignalWatcher::handler(int signum)
+{
+    int saved = errno;
+    unsigned char c = static_cast<unsigned char>(signum);
+    ssize_t written = ::write(s_fds[0], &c, 1);
+    (void)written;
+    errno = saved;
+}
+
+void SignalWatcher::onReadable()
+{
+    // 读端是阻塞的，每次通知只读一个字节
+    unsigned char c;
+    if (::read(s_fds[1], &c, 1) != 1)
+        return;
+    qDebug() << "收到信号" << int(c) << "，排空后退出";
+    emit received(int(c));
+}
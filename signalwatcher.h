@@ -0,0 +1,36 @@
+#ifndef SIGNALWATCHER_H
+#define SIGNALWATCHER_H
+
+#include <QObject>
+
+class QSocketNotifier;
+
+// 把 UNIX 信号（SIGTERM、SIGINT）转成 Qt 信号
+//
+// 信号处理函数里只向自管道写一个字节，事件循环读到后发出 received()，
+// main() 据此退出事件循环，之后按正常路径析构（MainWindow、MonitorCore 依次排空并关闭数据库）。
+// 第一次收到后恢复默认处理：排空卡住时再发一次同样的信号即可立即结束进程。
+// 整个进程只应创建一个实例。
+class SignalWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SignalWatcher(QObject *parent = 0);
+    ~SignalWatcher();
+
+    bool watch(int signum);
+
+signals:
+    void received(int signum);
+
+private slots:
+    void onReadable();
+
+private:
+    static void handler(int signum);
+
+    static int s_fds[2];
+    QSocketNotifier *m_notifier;
+};
+
+#endif // SIGNALWATCHER_H
@@ -1,4 +1,4 @@
-QT += core gui sql
+QT += core gui sql network
 TARGET = SmartHomeMonitor
 TEMPLATE = app
 
@@ -10,15 +10,69 @@ SOURCES += \
     mainwindow.cpp \
     sensorthread.cpp \
     chartwidget.cpp \
+    metrics.cpp \
+    metricsserver.cpp \
+    sensorstorage.cpp \
+    monitorcore.cpp \
+    alarmcontroller.cpp \
+    startupprofiler.cpp \
+    samplering.cpp \
+    sht11conversion.cpp \
+    chunkcodec.cpp \
+    persistencepolicy.cpp \
+    adaptiverate.cpp \
+    channelregistry.cpp \
+    samplebus.cpp \
+    historycache.cpp \
+    hottier.cpp \
+    csvimport.cpp \
+    historysummary.cpp \
+    realtime.cpp \
+    syntheticload.cpp \
+    derivedchannels.cpp \
+    memorybudget.cpp \
+    trendpredictor.cpp \
+    replay.cpp \
+    signalwatcher.cpp \
 
 HEADERS += \
     mainwindow.h \
     sensorthread.h \
     chartwidget.h \
-    sensordata.h
+    sensordata.h \
+    metrics.h \
+    metricsserver.h \
+    appsettings.h \
+    sensorstorage.h \
+    monitorcore.h \
+    alarmcontroller.h \
+    startupprofiler.h \
+    samplering.h \
+    sampleringabi.h \
+    sht11conversion.h \
+    samplefilter.h \
+    chunkcodec.h \
+    persistencepolicy.h \
+    adaptiverate.h \
+    channelregistry.h \
+    samplebus.h \
+    historycache.h \
+    hottier.h \
+    csvimport.h \
+    historysummary.h \
+    realtime.h \
+    syntheticload.h \
+    derivedchannels.h \
+    memorybudget.h \
+    trendpredictor.h \
+    replay.h \
+    signalwatcher.h
 
 INCLUDEPATH += .
 
+# shm_open（旧版 glibc）
+LIBS += -lrt
+
 # 嵌入式优化
 #QMAKE_CXXFLAGS += -O2 -march=armv4t -mtune=arm920t
 #DEFINES += QT_NO_DEBUG_OUTPUT
@@ -0,0 +1,41 @@
+#include "startupprofiler.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QStringList>
+#include <QDebug>
+
+namespace {
+    QElapsedTimer s_clock;
+    QMutex s_mutex;
+    QStringList s_marked;
+}
+
+namespace StartupProfiler {
+
+void begin()
+{
+    s_clock.start();
+}
+
+void mark(const char *phase)
+{
+    QMutexLocker locker(&s_mutex);
+    if (!s_clock.isValid() || s_marked.contains(phase))
+        return;
+    s_marked.append(phase);
+
+    int ms = int(s_clock.elapsed());
+    MetricsRegistry::instance()->gauge(
+        "smarthome_startup_phase_milliseconds", "Milliseconds from process start to each startup phase.",
+        QString("phase=\"%1\"").arg(phase))->set(ms);
+    qDebug() << "Startup:" << phase << ms << "ms";
+}
+
+bool isMarked(const char *phase)
+{
+    QMutexLocker locker(&s_mutex);
+    return s_marked.contains(phase);
+}
+
+} // namespace StartupProfiler
@@ -0,0 +1,15 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+// 启动阶段计时
+// main() 开头调用 begin()，之后每个阶段调用 mark()。
+// 每个阶段只记录第一次，结果写入日志和 smarthome_startup_phase_milliseconds 指标。
+// mark() 加锁并查找已记录的阶段，每个采样、每帧都会经过的地方由调用方记住已经标记过，
+// 之后不再调用。
+namespace StartupProfiler {
+    void begin();
+    void mark(const char *phase);
+    bool isMarked(const char *phase);
+}
+
+#endif // STARTUPPROFILER_H
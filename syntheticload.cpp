@@ -0,0 +1,107 @@
+#include "syntheticload.h"
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QFile>
+#include <QDebug>
+
+// 界面负载的节拍
+static const int kBurnPeriodMs = 50;
+
+SyntheticLoad::SyntheticLoad(QObject *parent)
+    : QObject(parent)
+    , m_timer(0)
+    , m_burnMs(0)
+    , m_dbLoad(0)
+{
+}
+
+SyntheticLoad::~SyntheticLoad()
+{
+    stop();
+}
+
+void SyntheticLoad::start(int cpuPercent, int dbRows, const QString &dbPath)
+{
+    m_burnMs = kBurnPeriodMs * qBound(0, cpuPercent, 95) / 100;
+    if (m_burnMs > 0) {
+        m_timer = new QTimer(this);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(burn()));
+        m_timer->start(kBurnPeriodMs);
+    }
+    if (dbRows > 0) {
+        m_dbLoad = new DbLoadThread(dbRows, dbPath);
+        m_dbLoad->start(QThread::LowPriority);
+    }
+    qWarning() << "合成负载已启动: 主线程" << cpuPercent << "%, 每次提交" << dbRows << "行";
+}
+
+void SyntheticLoad::stop()
+{
+    if (m_timer)
+        m_timer->stop();
+    if (m_dbLoad) {
+        m_dbLoad->requestStop();
+        m_dbLoad->wait();
+        delete m_dbLoad;
+        m_dbLoad = 0;
+    }
+}
+
+void SyntheticLoad::burn()
+{
+    QElapsedTimer timer;
+    timer.start();
+    volatile double x = 1.0;
+    while (timer.elapsed() < m_burnMs)
+        x = x * 1.0000001 + 0.5;
+}
+
+// ============== DbLoadThread ==============
+
+DbLoadThread::DbLoadThread(int rowsPerCommit, const QString &path, QObject *parent)
+    : QThread(parent)
+    , m_rows(rowsPerCommit)
+    , m_path(path)
+    , m_running(true)
+{
+}
+
+void DbLoadThread::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "loadtest");
+        db.setDatabaseName(m_path);
+        if (!db.open()) {
+            qWarning() << "合成负载: 无法打开" << m_path << db.lastError().text();
+            return;
+        }
+        QSqlQuery query(db);
+        query.exec("PRAGMA journal_mode = WAL;");
+        query.exec("CREATE TABLE IF NOT EXISTS load (key INTEGER PRIMARY KEY, value REAL)");
+
+        // 每次提交都 fsync，和存储线程的写入方式一样；表超过 100 万行后清空重来
+        qint64 key = 0;
+        while (m_running) {
+            db.transaction();
+            query.prepare("INSERT OR REPLACE INTO load (key, value) VALUES (?, ?)");
+            for (int i = 0; i < m_rows; ++i) {
+                query.bindValue(0, key % 1000000);
+                query.bindValue(1, double(key) * 0.01);
+                query.exec();
+                ++key;
+            }
+            db.commit();
+            if (key % 1000000 < m_rows)
+                query.exec("DELETE FROM load");
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("loadtest");
+    QFile::remove(m_path);
+    QFile::remove(m_path + "-wal");
+    QFile::remove(m_path + "-shm");
+}
@@ -0,0 +1,56 @@
+#ifndef SYNTHETICLOAD_H
+#define SYNTHETICLOAD_H
+
+#include <QObject>
+#include <QThread>
+#include <QString>
+
+class QTimer;
+class DbLoadThread;
+
+// 合成负载，用来在台架上核对采样抖动（见 realtime.h 的 JitterMonitor）
+//
+// 界面负载：在主线程里按占空比空转，模拟重绘和布局占住事件循环；
+// 数据库负载：单独的线程不停地向临时数据库大批量写入并提交，模拟存储线程的 fsync。
+// 只在 --load-test 下启动，[loadtest] 下配置：
+//   cpuPercent   主线程占用比例，默认 50
+//   dbRows       每次提交写入的行数，默认 2000，0 表示不加数据库负载
+//   dbPath       临时数据库，默认 /tmp/smarthome-loadtest.db，退出时删除
+class SyntheticLoad : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SyntheticLoad(QObject *parent = 0);
+    ~SyntheticLoad();
+
+    void start(int cpuPercent, int dbRows, const QString &dbPath);
+    void stop();
+
+private slots:
+    void burn();
+
+private:
+    QTimer *m_timer;
+    int m_burnMs;
+    DbLoadThread *m_dbLoad;
+};
+
+// 数据库负载线程
+class DbLoadThread : public QThread
+{
+    Q_OBJECT
+public:
+    DbLoadThread(int rowsPerCommit, const QString &path, QObject *parent = 0);
+
+    void requestStop() { m_running = false; }
+
+protected:
+    void run();
+
+private:
+    int m_rows;
+    QString m_path;
+    volatile bool m_running;
+};
+
+#endif // SYNTHETICLOAD_H
@@ -0,0 +1,83 @@
+/*
+ * 共享内存实时采样读取示例
+ *
+ * 用法: samplering_reader [-n 名称] [-b] [-c 数量] [-i 轮询间隔毫秒]
+ *   -n  共享内存名称，默认 /smarthome-samples
+ *   -b  先输出缓冲区中已有的采样
+ *   -c  读到指定数量后退出
+ *   -i  没有新采样时的轮询间隔，默认 100 ms
+ *
+ * 每行输出：序号 时间戳(ms) 温度 湿度
+ * 采集进程重启后自动重新打开，从新写者的第一个采样继续。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include "../sampleringabi.h"
+
+int main(int argc, char *argv[])
+{
+    const char *name = SAMPLERING_DEFAULT_NAME;
+    int backlog = 0;
+    long limit = -1;
+    int interval_ms = 100;
+    long count = 0;
+    struct samplering_reader reader;
+    struct samplering_sample sample;
+    int opt, rc;
+
+    while ((opt = getopt(argc, argv, "n:bc:i:")) != -1) {
+        switch (opt) {
+        case 'n': name = optarg; break;
+        case 'b': backlog = 1; break;
+        case 'c': limit = atol(optarg); break;
+        case 'i': interval_ms = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n name] [-b] [-c count] [-i interval_ms]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    rc = samplering_open(&reader, name);
+    if (rc == -2) {
+        fprintf(stderr, "%s: incompatible ring layout\n", name);
+        return 1;
+    }
+    if (rc < 0) {
+        perror(name);
+        return 1;
+    }
+    if (backlog)
+        samplering_rewind(&reader);
+
+    while (limit < 0 || count < limit) {
+        rc = samplering_read(&reader, &sample);
+        if (rc == 0) {
+            if (samplering_retired(&reader)) {
+                samplering_close(&reader);
+                fprintf(stderr, "%s: writer gone, waiting for a new one\n", name);
+                while (samplering_open(&reader, name) != 0 || samplering_retired(&reader)) {
+                    if (reader.header)
+                        samplering_close(&reader);
+                    usleep((useconds_t)interval_ms * 1000);
+                }
+                samplering_rewind(&reader);
+                continue;
+            }
+            usleep((useconds_t)interval_ms * 1000);
+            continue;
+        }
+        if (rc < 0) {
+            fprintf(stderr, "overrun, %u samples lost so far\n", (unsigned)reader.lost);
+            continue;
+        }
+        printf("%u %lld %.2f %.2f\n", (unsigned)sample.index,
+               (long long)sample.timestamp_ms, sample.temperature, sample.humidity);
+        fflush(stdout);
+        ++count;
+    }
+
+    samplering_close(&reader);
+    return 0;
+}
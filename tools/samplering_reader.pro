@@ -0,0 +1,12 @@
+# 共享内存实时采样读取示例（纯 C，不依赖 Qt）
+TEMPLATE = app
+TARGET = samplering_reader
+CONFIG -= qt
+CONFIG += console
+
+SOURCES += samplering_reader.c
+HEADERS += ../sampleringabi.h
+LIBS += -lrt
+
+target.path = /opt/smarthome
+INSTALLS += target
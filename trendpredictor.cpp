@@ -0,0 +1,227 @@
+#include "trendpredictor.h"
+#include "channelregistry.h"
+
+// 已经预警的通道在预计越线时间超过 horizon 的这个倍数之后才解除
+static const double kReleaseFactor = 1.25;
+
+// ============== TrendPredictor ==============
+
+void TrendPredictor::Window::clear()
+{
+    head = 0;
+    size = 0;
+    originMs = 0;
+    lastMs = 0;
+    sx = sy = sxx = sxy = syy = 0;
+    prediction = Prediction();
+}
+
+void TrendPredictor::Window::push(qint64 ms, double y)
+{
+    double x = (ms - originMs) / 1000.0;
+    ring[(head + size) % ring.size()] = Point(ms, y);
+    ++size;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+    syy += y * y;
+}
+
+void TrendPredictor::Window::popOldest()
+{
+    const Point &p = ring.at(head);
+    double x = (p.ms - originMs) / 1000.0;
+    sx -= x;
+    sy -= p.y;
+    sxx -= x * x;
+    sxy -= x * p.y;
+    syy -= p.y * p.y;
+    head = (head + 1) % ring.size();
+    --size;
+}
+
+// x 平移 d 秒：Σx' = Σx - n·d，Σxx' = Σxx - 2d·Σx + n·d²，Σxy' = Σxy - d·Σy
+void TrendPredictor::Window::rebase(qint64 newOriginMs)
+{
+    double d = (newOriginMs - originMs) / 1000.0;
+    sxx += -2 * d * sx + size * d * d;
+    sxy -= d * sy;
+    sx -= size * d;
+    originMs = newOriginMs;
+}
+
+TrendPredictor::TrendPredictor()
+{
+    reset();
+}
+
+void TrendPredictor::configure(const TrendPredictorConfig &config)
+{
+    m_config = config;
+    m_config.windowSec = qMax(1, m_config.windowSec);
+    m_config.horizonSec = qMax(1, m_config.horizonSec);
+    m_config.minSamples = qMax(3, m_config.minSamples);
+    m_config.maxSamples = qMax(m_config.minSamples, m_config.maxSamples);
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_channels[c].ring.clear();
+    reset();
+}
+
+void TrendPredictor::reset()
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_channels[c].clear();
+    m_preAlarm = 0;
+}
+
+void TrendPredictor::predict(Window *w, double x, double minValue, double maxValue)
+{
+    Prediction &p = w->prediction;
+    p = Prediction();
+    double n = w->size;
+    if (w->size < m_config.minSamples
+            || w->lastMs - w->oldest().ms < qint64(m_config.minSpanSec) * 1000)
+        return;
+
+    double sxx = n * w->sxx - w->sx * w->sx;
+    double syy = n * w->syy - w->sy * w->sy;
+    double sxy = n * w->sxy - w->sx * w->sy;
+    if (sxx <= 0 || syy <= 0)
+        return;
+    if (sxy * sxy / (sxx * syy) < m_config.minR2)
+        return;
+
+    p.valid = true;
+    p.slope = sxy / sxx;
+    p.level = (w->sy - p.slope * w->sx) / n + p.slope * x;
+    if (p.slope > 0) {
+        p.upper = true;
+        p.secondsToCross = p.level >= maxValue ? 0 : (maxValue - p.level) / p.slope;
+    } else if (p.slope < 0) {
+        p.secondsToCross = p.level <= minValue ? 0 : (minValue - p.level) / p.slope;
+    }
+}
+
+quint32 TrendPredictor::update(const SensorData &data)
+{
+    if (!m_config.enabled)
+        return 0;
+
+    qint64 ms = data.timestamp.toMSecsSinceEpoch();
+    qint64 windowMs = qint64(m_config.windowSec) * 1000;
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    quint32 raised = 0;
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        if (!info.alarmEnabled || !data.has(c))
+            continue;
+
+        Window &w = m_channels[c];
+        if (w.ring.isEmpty())
+            w.ring.resize(m_config.maxSamples);
+        if (w.size > 0 && ms <= w.lastMs)
+            continue;
+        // 中断超过一个窗口，旧的趋势不再有意义
+        if (w.size > 0 && ms - w.lastMs > windowMs)
+            w.clear();
+        if (w.size == 0)
+            w.originMs = ms;
+        else if (ms - w.originMs > 2 * windowMs)
+            w.rebase(w.oldest().ms);
+
+        if (w.size == w.ring.size())
+            w.popOldest();
+        double y = data.value(c);
+        w.push(ms, y);
+        w.lastMs = ms;
+        while (w.oldest().ms < ms - windowMs)
+            w.popOldest();
+
+        predict(&w, (ms - w.originMs) / 1000.0, info.alarmMin, info.alarmMax);
+
+        quint32 bit = 1u << c;
+        bool was = m_preAlarm & bit;
+        double tta = w.prediction.secondsToCross;
+        bool active = false;
+        if (y >= info.alarmMin && y <= info.alarmMax && w.prediction.valid && tta >= 0)
+            active = tta <= m_config.horizonSec * (was ? kReleaseFactor : 1.0);
+        if (active) {
+            m_preAlarm |= bit;
+            if (!was)
+                raised |= bit;
+        } else {
+            m_preAlarm &= ~bit;
+        }
+    }
+    return raised;
+}
+
+// ============== TrendEvaluation ==============
+
+double TrendEvaluation::ChannelReport::falsePositiveRate() const
+{
+    int decided = truePositives + falsePositives;
+    return decided > 0 ? double(falsePositives) / decided : 0;
+}
+
+TrendEvaluation::TrendEvaluation(const TrendPredictorConfig &config)
+    : m_samples(0)
+{
+    TrendPredictorConfig enabled = config;
+    enabled.enabled = true;
+    m_predictor.configure(enabled);
+    m_horizonMs = qint64(m_predictor.config().horizonSec) * 1000;
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c)
+        m_outOfRange[c] = false;
+}
+
+void TrendEvaluation::feed(const SensorData &data)
+{
+    ++m_samples;
+    qint64 ms = data.timestamp.toMSecsSinceEpoch();
+    quint32 raised = m_predictor.update(data);
+
+    const ChannelRegistry *channels = ChannelRegistry::instance();
+    for (int c = 0; c < channels->count(); ++c) {
+        const ChannelInfo &info = channels->at(c);
+        if (!info.alarmEnabled || !data.has(c))
+            continue;
+
+        ChannelReport &r = m_reports[c];
+        QList<qint64> &pending = m_pending[c];
+        while (!pending.isEmpty() && ms - pending.first() > m_horizonMs) {
+            ++r.falsePositives;
+            pending.removeFirst();
+        }
+
+        double v = data.value(c);
+        bool out = v > info.alarmMax || v < info.alarmMin;
+        if (out && !m_outOfRange[c]) {
+            ++r.crossings;
+            if (!pending.isEmpty()) {
+                qint64 lead = ms - pending.first();
+                ++r.predicted;
+                r.truePositives += pending.size();
+                r.leadSumMs += lead;
+                r.leadMaxMs = qMax(r.leadMaxMs, lead);
+                r.leadMinMs = r.leadMinMs < 0 ? lead : qMin(r.leadMinMs, lead);
+                pending.clear();
+            }
+        }
+        m_outOfRange[c] = out;
+
+        if (raised & (1u << c)) {
+            ++r.preAlarms;
+            pending.append(ms);
+        }
+    }
+}
+
+void TrendEvaluation::finish()
+{
+    for (int c = 0; c < SensorData::MAX_CHANNELS; ++c) {
+        m_reports[c].undecided += m_pending[c].size();
+        m_pending[c].clear();
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef TRENDPREDICTOR_H
+#define TRENDPREDICTOR_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include "sensordata.h"
+
+// 趋势预警：在越过报警阈值之前提前报出
+//
+// 每个启用了报警的通道维护最近 windowSec 秒（最多 maxSamples 个采样）的最小二乘直线，
+// 窗口用环形缓冲区保存，Σx、Σy、Σxx、Σxy、Σyy 随进出窗口增减，每个采样 O(1)，不重扫窗口。
+// x 为相对窗口基准时间的秒数，基准落后太多时按平移公式整体换算，不损失精度。
+// 用拟合直线在当前时刻的值外推到 alarmMin/alarmMax（ChannelRegistry），
+// 预计越线时间不超过 horizonSec 时进入预警；回到 horizon 的 1.25 倍以外、趋势反转、
+// 拟合太差或者已经真正越线（交给报警处理）时解除。
+// 采样少于 minSamples、窗口跨度小于 minSpanSec 或 R² 低于 minR2 时不做预测，
+// 平稳的噪声信号斜率接近 0，外推时间很长，不会预警。
+//
+// 配置在 [predict] 下：enabled、windowSec、horizonSec、minSamples、minSpanSec、minR2、maxSamples
+struct TrendPredictorConfig {
+    bool enabled;
+    int windowSec;
+    int horizonSec;
+    int minSamples;
+    int minSpanSec;
+    double minR2;
+    int maxSamples;
+
+    TrendPredictorConfig()
+        : enabled(true), windowSec(600), horizonSec(900), minSamples(10)
+        , minSpanSec(120), minR2(0.5), maxSamples(1024) {}
+};
+
+class TrendPredictor
+{
+public:
+    struct Prediction {
+        bool valid;             // 数据足够且拟合可信
+        double level;           // 拟合直线在最新采样时刻的值
+        double slope;           // 单位/秒
+        double secondsToCross;  // 预计越线的秒数，-1 表示按当前趋势不会越线
+        bool upper;             // 越过的是 alarmMax
+
+        Prediction() : valid(false), level(0), slope(0), secondsToCross(-1), upper(false) {}
+    };
+
+    TrendPredictor();
+
+    void configure(const TrendPredictorConfig &config);
+    const TrendPredictorConfig &config() const { return m_config; }
+    bool isEnabled() const { return m_config.enabled; }
+    void reset();
+
+    // 输入一个采样（派生通道需要已经算出），返回这次新进入预警的通道
+    quint32 update(const SensorData &data);
+
+    const Prediction &prediction(int channel) const { return m_channels[channel].prediction; }
+    quint32 preAlarmMask() const { return m_preAlarm; }
+
+private:
+    struct Point {
+        qint64 ms;
+        double y;
+
+        Point() : ms(0), y(0) {}
+        Point(qint64 ms, double y) : ms(ms), y(y) {}
+    };
+
+    struct Window {
+        QVector<Point> ring;
+        int head;           // 最早的采样
+        int size;
+        qint64 originMs;    // x = (时间戳 - originMs) / 1000
+        qint64 lastMs;
+        double sx, sy, sxx, sxy, syy;
+        Prediction prediction;
+
+        void clear();
+        void push(qint64 ms, double y);
+        void popOldest();
+        void rebase(qint64 newOriginMs);
+        const Point &oldest() const { return ring.at(head); }
+    };
+
+    void predict(Window *w, double x, double minValue, double maxValue);
+
+    TrendPredictorConfig m_config;
+    Window m_channels[SensorData::MAX_CHANNELS];
+    quint32 m_preAlarm;
+};
+
+// 用回放的历史评估预警：每次预警在 horizon 内等到真正越线算命中，提前量为越线时间减去
+// 这一轮最早的预警时间；超过 horizon 没有越线算误报；越线之前没有预警算漏报。
+// 采样按时间升序输入，数据结束时还没到期的预警单独计数
+class TrendEvaluation
+{
+public:
+    struct ChannelReport {
+        int preAlarms;
+        int truePositives;
+        int falsePositives;
+        int undecided;          // 数据结束时还没到期
+        int crossings;          // 真正越线（进入报警）的次数
+        int predicted;          // 其中有预警的
+        qint64 leadSumMs;
+        qint64 leadMinMs;
+        qint64 leadMaxMs;
+
+        ChannelReport()
+            : preAlarms(0), truePositives(0), falsePositives(0), undecided(0)
+            , crossings(0), predicted(0), leadSumMs(0), leadMinMs(-1), leadMaxMs(0) {}
+
+        // 误报在所有已判定的预警中的比例
+        double falsePositiveRate() const;
+    };
+
+    explicit TrendEvaluation(const TrendPredictorConfig &config);
+
+    void feed(const SensorData &data);
+    void finish();
+
+    qint64 samples() const { return m_samples; }
+    const ChannelReport &report(int channel) const { return m_reports[channel]; }
+
+private:
+    TrendPredictor m_predictor;
+    qint64 m_horizonMs;
+    qint64 m_samples;
+    ChannelReport m_reports[SensorData::MAX_CHANNELS];
+    QList<qint64> m_pending[SensorData::MAX_CHANNELS];  // 尚未判定的预警时间
+    bool m_outOfRange[SensorData::MAX_CHANNELS];
+};
+
+#endif // TRENDPREDICTOR_H